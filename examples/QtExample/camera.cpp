@@ -8,13 +8,10 @@ Camera::Camera(QWidget* parent):
 
 Camera::~Camera() {
 	killTimer(renderingTimer);
-	avFile.closeFile();
-	if(audioPlayingThreadIsRunning) {
-		audioPlayingThreadIsStopping = true;
-		if(audioPlayingThread.joinable()) {
-			audioPlayingThread.join();
-		}
+	if(audioPlayingId != 0) {
+		audioScheduler->remove(audioPlayingId);
 	}
+	avFile.closeFile();
 	if(audioThread) {
 		audioThread->exit(0);
 		audioThread->wait(1000);
@@ -31,7 +28,6 @@ bool Camera::start() {
 	avFile.setVideoConvertingParameters(AV_PIX_FMT_BGRA, SWS_FAST_BILINEAR, imageWidth, imageHeight);
 	imageWidth = avFile.getDestinationWidth();
 	imageHeight = avFile.getDestinationHeigth();
-	videoFrame.resize(av_image_get_buffer_size(AV_PIX_FMT_BGRA, imageWidth, imageHeight, 32));
 	videoPixmap = QPixmap(imageWidth, imageHeight);
 	avFile.setAudioConvertingParameters(AV_SAMPLE_FMT_S16, AV_CH_LAYOUT_STEREO);
 	if(!avFile.openFile(path.toStdString(),
@@ -55,45 +51,32 @@ void Camera::feedAudioOutput() {
 	}
 }
 
-void Camera::audioPlaying() {
-	uint8_t* buffer = nullptr;
-	int temp = 0;
-	auto deleter = [&](int*){
-		if(buffer) delete [] buffer;
-		audioPlayingThreadIsRunning = false;
-	};
-	std::unique_ptr<int, decltype(deleter)> threadFinishIndicator(&temp, deleter);
-
-	buffer = new uint8_t[audioBufsize];
-
-	int64_t interval = static_cast<int64_t>(1000000.0 / (sampleRate / numSamples)) - 100;
-	int64_t lastTime = av_gettime();
-	while(!audioPlayingThreadIsStopping) {
-		while(av_gettime() - lastTime < interval);
-		lastTime = av_gettime();
-		int result = static_cast<int>(avFile.getAudioData(&buffer[0], static_cast<uint32_t>(audioBufsize)));
-		if(result > 0) {
-			std::unique_lock<std::mutex> locker(audioSamplesMutex);
-			audioSamplesBuffer.append(reinterpret_cast<const char*>(&buffer[0]), result);
-			feedAudioOutput();
-			while(audioSamplesBuffer.size() > audioOutput->bufferSize()) {
-				feedAudioOutput();
-			}
-			locker.unlock();
-			int64_t newInterval = (interval - (av_gettime() - lastTime)) - 3000;
-			if(newInterval >= 3000) {
-				std::this_thread::sleep_for(std::chrono::microseconds(newInterval));
-			}
-		}else {
-			std::this_thread::sleep_for(std::chrono::microseconds(100));
-		}
+int64_t Camera::audioPlayingStep(int64_t deadline, int64_t now) {
+	std::unique_lock<std::mutex> locker(audioSamplesMutex);
+	if(audioSamplesBuffer.size() > audioOutput->bufferSize()) { //the output hasn't taken the last chunk yet
+		feedAudioOutput();
+		return now + 1000;
+	}
+	locker.unlock();
+	int result = static_cast<int>(avFile.getAudioData(&audioBuffer[0], static_cast<uint32_t>(audioBuffer.size())));
+	if(result <= 0) {
+		return now + 1000;
+	}
+	locker.lock();
+	audioSamplesBuffer.append(reinterpret_cast<const char*>(&audioBuffer[0]), result);
+	feedAudioOutput();
+	locker.unlock();
+	int64_t nextDeadline = deadline + audioPlayingPeriod;
+	if(nextDeadline < now) {
+		nextDeadline = now + audioPlayingPeriod;
 	}
+	return nextDeadline;
 }
 
 void Camera::timerEvent(QTimerEvent* event) {
 	if(event->timerId() == renderingTimer) {
 		if(!avFile.endOfFile()) {
-			if(!audioPlayingThreadIsRunning && avFile.hasAudioStream()) {
+			if(audioPlayingId == 0 && avFile.hasAudioStream()) {
 				numSamples = avFile.getNbSamples();
 				if(numSamples < 100) {
 					numSamples = 1536;
@@ -119,13 +102,17 @@ void Camera::timerEvent(QTimerEvent* event) {
 					connect(audioOutput, SIGNAL(notify()), this, SLOT(audioNotify()), Qt::DirectConnection);
 					audioOutput->setNotifyInterval(static_cast<int>((1000.0 / (sampleRate / numSamples)) / 2));
 					audioThread->start();
-					audioPlayingThreadIsRunning = true;
-					audioPlayingThreadIsStopping = false;
-					audioPlayingThread = std::thread(&Camera::audioPlaying, this);
+					audioBuffer.resize(static_cast<size_t>(audioBufsize));
+					audioPlayingPeriod = static_cast<int64_t>(1000000.0 / (sampleRate / numSamples));
+					audioScheduler = AVAudioScheduler::shared();
+					audioPlayingId = audioScheduler->add([this](int64_t deadline, int64_t now) {
+															return audioPlayingStep(deadline, now);
+														}, av_gettime_relative());
 				}
 			}
-			if(avFile.getVideoData(reinterpret_cast<uint8_t*>(videoFrame.data()), videoFrame.size())) {
-				QImage image(reinterpret_cast<uint8_t*>(videoFrame.data()), imageWidth, imageHeight, imageWidth * 4, QImage::Format_RGB32);
+			VideoFrameRef videoView = avFile.borrowVideoData();
+			if(videoView) {
+				QImage image(videoView->data[0], videoView->width, videoView->height, videoView->linesize[0], QImage::Format_RGB32);
 				if(!image.isNull()) {
 					videoPixmap = QPixmap::fromImage(image);
 					videoFrameUpdated = true;
@@ -147,7 +134,6 @@ void Camera::resizeEvent(QResizeEvent* event){
 		imageWidth = avFile.getDestinationWidth();
 		imageHeight = avFile.getDestinationHeigth();
 	}
-	videoFrame.resize(av_image_get_buffer_size(AV_PIX_FMT_BGRA, imageWidth, imageHeight, 32));
 	QWidget::resizeEvent(event);
 }
 
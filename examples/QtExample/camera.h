@@ -2,6 +2,7 @@
 #define CAMERA_H
 
 #include "../../src/avfilecontext.h"
+#include "../../src/avaudioscheduler.h"
 
 #include <QWidget>
 #include <QTimerEvent>
@@ -35,7 +36,6 @@ class Camera: public QWidget {
 		int imageWidth = 0;
 		int imageHeight = 0;
 
-		QByteArray videoFrame;
 		QPixmap videoPixmap;
 		bool videoFrameUpdated = false;
 
@@ -46,14 +46,15 @@ class Camera: public QWidget {
 		QAudioOutput* audioOutput = nullptr;
 		QIODevice* audioDevice = nullptr;
 		QAudioFormat format;
-		std::thread audioPlayingThread;
+		std::vector<uint8_t> audioBuffer;
+		int64_t audioPlayingPeriod = 0;
+		std::shared_ptr<AVAudioScheduler> audioScheduler;
+		uint64_t audioPlayingId = 0;
 		std::mutex audioSamplesMutex;
-		bool audioPlayingThreadIsRunning = false;
-		bool audioPlayingThreadIsStopping = false;
 		QThread* audioThread = nullptr;
 		AVfileContext avFile;
 
-		void audioPlaying();
+		int64_t audioPlayingStep(int64_t deadline, int64_t now);
 		void feedAudioOutput();
 
 		void videoPlaying();
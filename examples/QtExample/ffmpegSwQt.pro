@@ -63,6 +63,22 @@ SOURCES += \
     ../../src/audiodecoder.cpp \
     ../../src/avffmpegwrapper.cpp \
     ../../src/avfilecontext.cpp \
+    ../../src/avfiber.cpp \
+    ../../src/avrecorder.cpp \
+    ../../src/avsampleconverter.cpp \
+    ../../src/avpcmring.cpp \
+    ../../src/avmemorybudget.cpp \
+    ../../src/avtensorconverter.cpp \
+    ../../src/avthumbnailer.cpp \
+    ../../src/avprobecache.cpp \
+    ../../src/avaudioscheduler.cpp \
+    ../../src/avyuvconverter.cpp \
+    ../../src/avslicedscaler.cpp \
+    ../../src/avframepool.cpp \
+    ../../src/avdescriptortable.cpp \
+    ../../src/avioreactor.cpp \
+    ../../src/avsocketsource.cpp \
+    ../../src/avdecodingpool.cpp \
     ../../src/videodecoder.cpp \
     camera.cpp \
     ../../src/avbasedecoder.cpp
@@ -73,9 +89,28 @@ HEADERS += \
     ../../src/avffmpegwrapper.h \
     ../../src/avfilecontext.h \
     ../../src/avitemcontainer.h \
+    ../../src/avfiber.h \
+    ../../src/avrecorder.h \
+    ../../src/avsampleconverter.h \
+    ../../src/avpcmring.h \
+    ../../src/avmemorybudget.h \
+    ../../src/avcounter.h \
+    ../../src/avtensorconverter.h \
+    ../../src/avthumbnailer.h \
+    ../../src/avprobecache.h \
+    ../../src/avaudioscheduler.h \
+    ../../src/avyuvconverter.h \
+    ../../src/avslicedscaler.h \
+    ../../src/avframepool.h \
+    ../../src/avdescriptortable.h \
+    ../../src/avioreactor.h \
+    ../../src/avsocketsource.h \
+    ../../src/avdecodingpool.h \
+    ../../src/avspscring.h \
     ../../src/videodecoder.h \
     camera.h \
-    ../../src/avbasedecoder.h
+    ../../src/avbasedecoder.h \
+    ../../src/avframedecoder.h
 
 FORMS += \
         mainwindow.ui
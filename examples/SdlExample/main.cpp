@@ -16,18 +16,10 @@ static void audio_callback(void* userdata, uint8_t* stream, int len) {
 	}
 	SDL_LockAudio();
 	int* fileDescriptor = static_cast<int*>(userdata);
-	uint8_t counter = 0;
-
-	uint32_t result = aVffmpegWrapper.getAudioData(*fileDescriptor, &stream[0], static_cast<uint32_t>(len));
-	len -= result;
-	uint32_t dataWasGiven = result;
-	while((len > 0) && (counter < 5)) {
-		std::this_thread::sleep_for(std::chrono::microseconds(20));
-		result -= aVffmpegWrapper.getAudioData(*fileDescriptor, &stream[0], static_cast<uint32_t>(len));
-		len -= result;
-		dataWasGiven += result;
-		++ counter;
-	}
+
+	//everything decoded so far comes in one read, the rest is silence
+	uint32_t dataWasGiven = aVffmpegWrapper.getAudioData(*fileDescriptor, &stream[0], static_cast<uint32_t>(len));
+	len -= static_cast<int>(dataWasGiven);
 	if(len > 0) {
 		memset(&stream[dataWasGiven], 0, static_cast<size_t>(len));
 	}
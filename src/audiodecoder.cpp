@@ -8,42 +8,73 @@ AudioDecoder::~AudioDecoder() {
 }
 
 bool AudioDecoder::start() {
-	frameDataGivenAway = 0;
-	ftameDataPtrIndex = 0;
-	return AVBaseDecoder::start();
+	std::unique_lock<std::mutex> frameLocker(frameMutex);
+	pcm.clear();
+	frontBytesTaken = 0;
+	frameLocker.unlock();
+	return AVFrameDecoder::start();
 }
 
 void AudioDecoder::stop() {
-	AVBaseDecoder::stop();
+	AVFrameDecoder::stop();
 	if(convertContext != nullptr) {
 		swr_free(&convertContext);
 		convertContext = nullptr;
 	}
-	dataSize = 0;
+	std::lock_guard<std::mutex> frameLocker(frameMutex);
+	pcm.clear();
+	frontBytesTaken = 0;
 }
 
 uint32_t AudioDecoder::availableData() {
-	return dataSize;
+	return static_cast<uint32_t>(pcm.readable());
 }
 
 uint32_t AudioDecoder::getData(uint8_t* data, uint32_t requairedDataSize) {
-	if(dataSize == 0) return 0;
+	if(pcm.readable() == 0) return 0;
 
-	uint32_t givenSize = 0;
-	std::unique_lock<std::mutex> frameLocker(frameMutex, std::try_to_lock);
-	if(!frameLocker.owns_lock()) {
-		while(!frameLocker.try_lock());
+	std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //only a reconfiguration can hold it, decoding doesn't
+	lockCounted(frameLocker, consumerLockWaiting);
+	if(!frame.isEmpty()) { //the bytes of a chunk are in pcm a moment before its timestamps are pushed
+		updateLastPts(frame.front().getPtr());
 	}
-	if(stopping) return 0;
+	uint32_t givenSize = static_cast<uint32_t>(pcm.read(data, requairedDataSize));
+	framesTaken(givenSize);
+	frameLocker.unlock();
+	scheduleDecoding();
+	return givenSize;
+}
+
+uint32_t AudioDecoder::peekData(const uint8_t** data) {
+	std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //a reconfiguration moves the ring under it
+	lockCounted(frameLocker, consumerLockWaiting);
+	size_t contiguous = 0;
+	*data = pcm.readPointer(contiguous);
+	return static_cast<uint32_t>(contiguous);
+}
 
-	AVFrame* decodedFrame = frame[static_cast<unsigned>(frameReadIndex)].getPtr();
+void AudioDecoder::consumeData(uint32_t size) {
+	std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock);
+	lockCounted(frameLocker, consumerLockWaiting);
+	if(!frame.isEmpty()) {
+		updateLastPts(frame.front().getPtr());
+	}
+	size_t readable = pcm.readable();
+	uint32_t taken = size < readable ? size : static_cast<uint32_t>(readable);
+	pcm.consume(taken);
+	framesTaken(taken);
+	frameLocker.unlock();
+	scheduleDecoding();
+}
+
+void AudioDecoder::updateLastPts(AVFrame* decodedFrame) {
 	double pts = decodedFrame->pkt_dts;
 	if(pts == AV_NOPTS_VALUE) {
 		pts = decodedFrame->pts;
 	}
 	if(pts != AV_NOPTS_VALUE) {
 		pts *= av_q2d(stream->time_base);
-		if(lastPts == 0.0 && frameReadIndex == 0 && pts > 0.5) {
+		if(lastPts == 0.0 && frame.readIndex() == 0 && pts > 0.5) {
 			rtspDifferencePts = pts;
 		}else if(lastPts > pts) {
 			rtspDifferencePts = 0;
@@ -51,26 +82,19 @@ uint32_t AudioDecoder::getData(uint8_t* data, uint32_t requairedDataSize) {
 		lastPts = pts;
 		lastPtsCheckTime = av_gettime();
 	}
+}
 
-	while(frameReadIndex != frameWriteIndex) {
-		decodedFrame = frame[static_cast<unsigned>(frameReadIndex)].getPtr();
-		bool isEmpty = false;
-		uint32_t receivedData = getDataFromFrame(decodedFrame, isEmpty, &data[givenSize], requairedDataSize);
-		if(isEmpty) {
-			frame[static_cast<unsigned>(frameReadIndex ++)].unrefPtr();
-			if(static_cast<unsigned>(frameReadIndex) >= frame.size())
-				frameReadIndex = 0;
-		}
-		givenSize += receivedData;
-		if(receivedData == requairedDataSize) {
+void AudioDecoder::framesTaken(uint32_t size) { //the frames only carry the timestamps, their samples are in pcm
+	frontBytesTaken += size;
+	while(!frame.isEmpty()) {
+		uint32_t frontBytes = chunkSize(frame.front().getPtr());
+		if(frontBytesTaken < frontBytes) {
 			break;
 		}
-		requairedDataSize -= receivedData;
+		frontBytesTaken -= frontBytes;
+		frame.front().unrefPtr();
+		frame.pop();
 	}
-	dataSize -= static_cast<uint64_t>(givenSize);
-	frameLocker.unlock();
-	frameCond.notify_one();
-	return givenSize;
 }
 
 double AudioDecoder::getLastPts() {
@@ -86,6 +110,7 @@ int64_t AudioDecoder::getLastPtsCheckTime() {
 }
 
 bool AudioDecoder::setConvertingParameters(AVSampleFormat destSampleFormat, int64_t destChLayuot, int destSampleRate) {
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	std::unique_lock<std::mutex> frameLocker(frameMutex);
 	if(stopping) return false;
 	SwrContext* newContext = nullptr;
@@ -157,7 +182,7 @@ bool AudioDecoder::setConvertingParameters(AVSampleFormat destSampleFormat, int6
 }
 
 int AudioDecoder::getSrcSampleRate() {
-	std::unique_lock<std::mutex> frameLocker(frameMutex);
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	if(!codecContext) {
 		return -1;
 	}
@@ -165,7 +190,7 @@ int AudioDecoder::getSrcSampleRate() {
 }
 
 int AudioDecoder::getSrcChannels() {
-	std::unique_lock<std::mutex> frameLocker(frameMutex);
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	if(!codecContext) {
 		return -1;
 	}
@@ -185,35 +210,68 @@ int AudioDecoder::getDestSampleRate() {
 }
 
 int AudioDecoder::getNbSamples() {
-	std::unique_lock<std::mutex> frameLocker(frameMutex);
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	return nbSmples;
 }
 
-uint32_t AudioDecoder::getDataFromFrame(AVFrame* decodedFrame, bool& isEmpty, uint8_t* data, uint32_t requairedDataSize) {
-	uint32_t linesize = static_cast<uint32_t>(av_get_bytes_per_sample(static_cast<AVSampleFormat>(decodedFrame->format)) * decodedFrame->nb_samples);
-	uint32_t fullSize = static_cast<uint32_t>(decodedFrame->channels) * linesize;
-	uint32_t copyedSize = 0;
-	if(!av_sample_fmt_is_planar(static_cast<AVSampleFormat>(decodedFrame->format))) {
-		uint32_t copySize = std::min(requairedDataSize, fullSize - frameDataGivenAway);
-		memcpy(&data[0], &decodedFrame->extended_data[0][frameDataGivenAway], copySize);
-		copyedSize += copySize;
-	}else {
-		uint32_t indexInLastDataPtr = frameDataGivenAway < linesize ? frameDataGivenAway : frameDataGivenAway - (linesize * ftameDataPtrIndex);
-		for(; ftameDataPtrIndex < static_cast<uint32_t>(decodedFrame->channels) && decodedFrame->extended_data[ftameDataPtrIndex] && requairedDataSize > 0; ++ ftameDataPtrIndex) {
-			uint32_t copySize = std::min(requairedDataSize, linesize - indexInLastDataPtr);
-			memcpy(&data[copyedSize], &decodedFrame->extended_data[ftameDataPtrIndex][indexInLastDataPtr], copySize);
-			copyedSize += copySize;
-			requairedDataSize -= copySize;
-			indexInLastDataPtr = 0;
+uint32_t AudioDecoder::chunkSize(const AVFrame* chunk) {
+	int size = av_samples_get_buffer_size(nullptr, chunk->channels, chunk->nb_samples, static_cast<AVSampleFormat>(chunk->format), 1);
+	return size > 0 ? static_cast<uint32_t>(size) : 0;
+}
+
+int AudioDecoder::convertToPcm(SwrContext* context, const uint8_t** source, int sourceSamples) {
+	int channels = getDestChannels();
+	int sampleSize = av_get_bytes_per_sample(destSample_format);
+	int maxSamples = swr_get_out_samples(context, sourceSamples);
+	if(channels <= 0 || sampleSize <= 0 || maxSamples < 0) {
+		return -1;
+	}
+	size_t frameSize = static_cast<size_t>(channels * sampleSize);
+	chunkBytes = static_cast<size_t>(maxSamples) * frameSize;
+	bool planar = av_sample_fmt_is_planar(destSample_format);
+	size_t space = 0;
+	uint8_t* destination = pcm.writePointer(space);
+	if(planar) {
+		space = pcm.writable();
+	}
+	//what doesn't fit stays buffered in the converter and comes out with the next frame
+	int samples = static_cast<int>(std::min(static_cast<size_t>(maxSamples), space / frameSize));
+	if(!planar) {
+		int converted = swr_convert(context, &destination, samples, source, sourceSamples);
+		if(converted > 0) {
+			pcm.commit(static_cast<size_t>(converted) * frameSize);
 		}
+		return converted;
+	}
+	size_t planeSize = static_cast<size_t>(samples * sampleSize);
+	planarBuffer.resize(planeSize * static_cast<size_t>(channels));
+	planarData.resize(static_cast<size_t>(channels));
+	for(int channel = 0; channel < channels; ++ channel) {
+		planarData[static_cast<size_t>(channel)] = planarBuffer.data() + planeSize * static_cast<size_t>(channel);
+	}
+	int converted = swr_convert(context, planarData.data(), samples, source, sourceSamples);
+	for(int channel = 0; channel < channels && converted > 0; ++ channel) {
+		pcm.write(planarData[static_cast<size_t>(channel)], static_cast<size_t>(converted * sampleSize));
+	}
+	return converted;
+}
+
+int AudioDecoder::convertDirectly(const AVFrame* source) {
+	AVSampleConverter::Route route;
+	if(!AVSampleConverter::findRoute(srcSample_format, srcCh_layuot, srcSample_rate, destSample_format, destCh_layuot, destSample_rate, route)
+	 || swr_get_delay(convertContext, destSample_rate) > 0) { //the samples swr holds back go out first
+		return -1;
 	}
-	frameDataGivenAway += copyedSize;
-	if(frameDataGivenAway >= fullSize) {
-		frameDataGivenAway = 0;
-		ftameDataPtrIndex = 0;
-		isEmpty = true;
+	size_t size = AVSampleConverter::outputSize(route, source->nb_samples);
+	chunkBytes = size;
+	size_t space = 0;
+	uint8_t* destination = pcm.writePointer(space);
+	if(size == 0 || space < size) {
+		return -1; //swr keeps what doesn't fit
 	}
-	return copyedSize;
+	AVSampleConverter::convert(route, source->extended_data, destination, source->nb_samples);
+	pcm.commit(size);
+	return source->nb_samples;
 }
 
 bool AudioDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
@@ -228,6 +286,7 @@ bool AudioDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 	}
 	if(convertContext == nullptr) {
 		if(codecContext->sample_rate > 0 && codecContext->sample_fmt != AVSampleFormat::AV_SAMPLE_FMT_NONE) {
+			std::lock_guard<std::mutex> frameLocker(frameMutex); //the destination format and the ring change under the consumer
 			if(destSample_rate <= 0) {
 				destSample_rate = codecContext->sample_rate;
 			}
@@ -263,12 +322,18 @@ bool AudioDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 		}
 	}
 	dest->channel_layout = static_cast<uint64_t>(destCh_layuot);
+	dest->channels = getDestChannels();
 	dest->sample_rate = destSample_rate;
 	dest->format = destSample_format;
-	dest->pkt_dts = source->pkt_dts;
-	dest->pts = source->pts;
-	if(swr_convert_frame(convertContext, dest, source) == 0) {
-		nbSmples = dest->nb_samples;
+	dest->pkt_dts = source ? source->pkt_dts : AV_NOPTS_VALUE; //no source flushes the converter
+	dest->pts = source ? source->pts : AV_NOPTS_VALUE;
+	int converted = source ? convertDirectly(source) : -1;
+	if(converted < 0) {
+		converted = convertToPcm(convertContext, source ? const_cast<const uint8_t**>(source->extended_data) : nullptr, source ? source->nb_samples : 0);
+	}
+	if(converted > 0) {
+		dest->nb_samples = converted;
+		nbSmples = converted;
 		return true;
 	}else {
 		return false;
@@ -276,104 +341,137 @@ bool AudioDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 }
 
 void AudioDecoder::reconvertAll(AVSampleFormat oldSample_format, int oldSample_rate, int64_t oldCh_layuot) {
-	if(frameReadIndex != frameWriteIndex) {
-		bool good = false;
-		if(oldSample_format != AVSampleFormat::AV_SAMPLE_FMT_NONE) {
-			SwrContext* tempContext = swr_alloc_set_opts(
-													nullptr,
-													destCh_layuot,		 // out_ch_layout
-													destSample_format,    // out_sample_fmt
-													destSample_rate,      // out_sample_rate
-													oldCh_layuot,		// in_ch_layout
-													oldSample_format,		// in_sample_fmt
-													oldSample_rate,			// in_sample_rate
-													0,                    // log_offset
-													nullptr);             // log_ctx
-			if(tempContext != nullptr) {
-				int res = swr_init(tempContext);
-				good = true;
-				for(int isign = frameReadIndex; std::abs(isign - frameWriteIndex) > 0; ++ isign) { //rescale already decoded frames
-					AVFrame* dest = av_frame_alloc();
-					int temp = 0;
-					auto deleter = [&](int*) {
-						if(dest) av_frame_free(&dest);
-					};
-					std::unique_ptr<int, decltype(deleter)> frameDeleter(&temp, deleter);
-
-					unsigned int i = static_cast<unsigned>(isign);
-					dest->channel_layout = static_cast<uint64_t>(destCh_layuot);
-					dest->sample_rate = destSample_rate;
-					dest->format = destSample_format;
-					dest->pkt_dts = frame[i].getPtr()->pkt_dts;
-					dest->pts = frame[i].getPtr()->pts;
-					res = swr_convert_frame(convertContext, dest, frame[i].getPtr());
-					int linesize = av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame[i].getPtr()->format)) * frame[i].getPtr()->nb_samples;
-					dataSize -= static_cast<unsigned>(linesize * frame[i].getPtr()->channels) - frameDataGivenAway;
-					frameDataGivenAway = 0;
-					ftameDataPtrIndex = 0;
-					frame[i].resetPtr();
-					if(res == 0) {
-						frame[i].setReferencedPtr(dest);
-						frame[i].doSomething();
-					}else {
-						frame[i].setReferencedPtr(dest);
-					}
-					dest = nullptr;
-					if(static_cast<unsigned>(isign) >= frame.size() - 1) {
-						isign = -1;
+	bool good = frame.isEmpty();
+	if(!good && oldSample_format != AVSampleFormat::AV_SAMPLE_FMT_NONE) {
+		SwrContext* tempContext = swr_alloc_set_opts(
+												nullptr,
+												destCh_layuot,		 // out_ch_layout
+												destSample_format,    // out_sample_fmt
+												destSample_rate,      // out_sample_rate
+												oldCh_layuot,		// in_ch_layout
+												oldSample_format,		// in_sample_fmt
+												oldSample_rate,			// in_sample_rate
+												0,                    // log_offset
+												nullptr);             // log_ctx
+		if(tempContext != nullptr && swr_init(tempContext) >= 0) { //take the queued samples out and convert them back in
+			good = true;
+			std::vector<uint8_t> queued(pcm.readable());
+			pcm.read(queued.data(), queued.size());
+			pcm.clear();
+			size_t offset = 0;
+			if(frontBytesTaken > 0) { //a frame already partly given away is skipped
+				offset = chunkSize(frame.front().getPtr()) - frontBytesTaken;
+				frame.front().getPtr()->nb_samples = 0;
+			}
+			frontBytesTaken = 0;
+			resizeFrameRing();
+			for(int isign = static_cast<int>(frame.readIndex()); std::abs(isign - static_cast<int>(frame.writeIndex())) > 0; ++ isign) {
+				AVFrame* chunk = frame[static_cast<unsigned>(isign)].getPtr();
+				int channels = chunk->channels;
+				uint32_t size = chunkSize(chunk);
+				if(size > 0 && offset + size <= queued.size()) {
+					std::vector<const uint8_t*> sourceData(static_cast<size_t>(channels));
+					size_t planeSize = av_sample_fmt_is_planar(oldSample_format) ? size / static_cast<size_t>(channels) : 0;
+					for(int channel = 0; channel < channels; ++ channel) {
+						sourceData[static_cast<size_t>(channel)] = queued.data() + offset + planeSize * static_cast<size_t>(channel);
 					}
+					int converted = convertToPcm(tempContext, sourceData.data(), chunk->nb_samples);
+					chunk->nb_samples = converted > 0 ? converted : 0;
+					offset += size;
+				}else {
+					chunk->nb_samples = 0;
 				}
-				swr_close(tempContext);
-				swr_free(&tempContext);
-			}
-		}
-		if(!good) {
-			for(int isign = frameReadIndex; std::abs(isign - frameWriteIndex) > 0; ++ isign) { //reset already decoded frames
-				unsigned int i = static_cast<unsigned>(isign);
-				frame[i].unrefPtr();
+				chunk->channels = getDestChannels();
+				chunk->channel_layout = static_cast<uint64_t>(destCh_layuot);
+				chunk->sample_rate = destSample_rate;
+				chunk->format = destSample_format;
 				if(static_cast<unsigned>(isign) >= frame.size() - 1) {
 					isign = -1;
 				}
 			}
-			frameReadIndex = frameWriteIndex;
+		}
+		if(tempContext != nullptr) {
+			swr_close(tempContext);
+			swr_free(&tempContext);
 		}
 	}
-}
-
-void AudioDecoder::handleEndOfFile(std::unique_lock<std::mutex>& frameLocker) {
-	if(swr_get_delay(convertContext, 1000) > 0) {
-		if(stopping) return;
-
-		if(((frameWriteIndex < frameReadIndex) && (frameReadIndex - frameWriteIndex < 6))//free space in the buffer is less then 6 items
-		 ||((frameWriteIndex > frameReadIndex) && (frameWriteIndex - frameReadIndex > framesBufferSize - 6))) {//free space in the buffer is less then 6 items
-			frameCond.wait(frameLocker, [&](){
-				return (frameWriteIndex == frameReadIndex)
-						|| (((frameWriteIndex < frameReadIndex) && (frameReadIndex - frameWriteIndex > 6)) //the buffer has free item
-						 || ((frameWriteIndex > frameReadIndex) && (frameWriteIndex - frameReadIndex < framesBufferSize - 6))) //the buffer has free item
-						|| stopping;});
-			if(stopping) {
-				return;
+	if(!good) {
+		for(int isign = static_cast<int>(frame.readIndex()); std::abs(isign - static_cast<int>(frame.writeIndex())) > 0; ++ isign) { //reset already decoded frames
+			frame[static_cast<unsigned>(isign)].unrefPtr();
+			if(static_cast<unsigned>(isign) >= frame.size() - 1) {
+				isign = -1;
 			}
 		}
+		frame.dropAll();
+		pcm.clear();
+		frontBytesTaken = 0;
+		scheduleDecoding();
+	}
+	resizeFrameRing();
+}
 
-		if(convertFrame(frame[static_cast<unsigned>(frameWriteIndex)].getPtr(), nullptr)) {
-			frame[static_cast<unsigned>(frameWriteIndex)].doSomething();
-			frame[static_cast<unsigned>(frameWriteIndex ++)].markPtrHowReferenced();
-			if(static_cast<unsigned>(frameWriteIndex) >= frame.size()) {
-				frameWriteIndex = 0;
-			}
-		}
+AVBaseDecoder::DecodingStep AudioDecoder::handleEndOfFile(std::unique_lock<std::mutex>&) {
+	//a chunk per step until swr gave out everything it held back, a full ring parks the step instead of the worker
+	if(stopping || convertContext == nullptr || swr_get_delay(convertContext, destSample_rate) <= 0) {
+		return STEP_FINISHED;
+	}
+	if(!hasFrameSpace()) {
+		return STEP_NEED_SPACE;
+	}
+	AVFrame* dest = backFrame();
+	if(dest == nullptr || !convertFrame(dest, nullptr)) {
+		return STEP_FINISHED;
+	}
+	frame.back().markPtrHowReferenced();
+	frame.push();
+	return STEP_DONE;
+}
+
+void AudioDecoder::dropQueuedFrames() {
+	AVFrameDecoder::dropQueuedFrames();
+	pcm.clear();
+	frontBytesTaken = 0;
+	if(convertContext) {
+		swr_init(convertContext); //forgets the buffered samples
+	}
+}
+
+bool AudioDecoder::hasFrameSpace() {
+	if(frame.isFull()) {
+		return false;
+	}
+	//without frameMutex, also as the waiting predicate, so nothing a reconfiguration moves is read, the decoder checks again under codecMutex
+	size_t capacity = pcmCapacity.load(std::memory_order_acquire);
+	size_t needed = chunkBytes;
+	if(needed > capacity / 2) { //a frame that doesn't fit is written over several steps
+		needed = capacity / 2;
 	}
+	size_t queued = pcm.readable();
+	return queued <= capacity && capacity - queued >= needed; //before the first conversion the ring is sized by it
 }
 
-void AudioDecoder::initFrameBuffer() {
-	for(auto& frameContainer : frame) {
-		frameContainer.setDeleter([](AVFrame* frame) {av_frame_free(&frame);});
-		frameContainer.setUnreferencer([](AVFrame* frame) {av_frame_unref(frame);});
-		frameContainer.setDoSomething([&](AVFrame* frame) {
-			int linesize = av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format)) * frame->nb_samples;
-			dataSize += static_cast<unsigned>(linesize * frame->channels);
-		});
-		frameContainer.setUnreferencedPtr(av_frame_alloc());
+void AudioDecoder::resizeFrameRing() {
+	AVFrameDecoder::resizeFrameRing();
+	size_t bytes = frameBytes();
+	if(bytes > 0) { //a frame per slot, the resampler can give out a little more than it takes
+		pcm.resize(frame.size() * (bytes + bytes / 4));
+		pcmCapacity.store(pcm.capacity(), std::memory_order_release);
+	}
+}
+
+double AudioDecoder::framesRate() {
+	if(codecContext && codecContext->sample_rate > 0) {
+		int frameSize = codecContext->frame_size > 0 ? codecContext->frame_size : 1024;
+		return static_cast<double>(codecContext->sample_rate) / frameSize;
+	}
+	return AVBaseDecoder::framesRate();
+}
+
+size_t AudioDecoder::frameBytes() {
+	if(convertContext == nullptr) {
+		return 0;
 	}
+	int frameSize = codecContext && codecContext->frame_size > 0 ? codecContext->frame_size : 1024;
+	int size = av_samples_get_buffer_size(nullptr, getDestChannels(), frameSize, destSample_format, 0);
+	return size > 0 ? static_cast<size_t>(size) : 0;
 }
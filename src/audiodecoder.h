@@ -1,7 +1,9 @@
 #ifndef AUDIODECODER_H
 #define AUDIODECODER_H
 
-#include "avbasedecoder.h"
+#include "avframedecoder.h"
+#include "avpcmring.h"
+#include "avsampleconverter.h"
 
 extern "C" {
 	#include <libswresample/swresample.h>
@@ -9,14 +11,19 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <vector>
 
-class AudioDecoder: public AVBaseDecoder {
+class AudioDecoder: public AVFrameDecoder<AVPlainFrameType> { //the frames carry only timestamps, the samples are in the pcm ring
 	public:
 		virtual ~AudioDecoder() override;
 		bool start();
 		void stop();
 		uint32_t availableData();
 		uint32_t getData(uint8_t* data, uint32_t requairedDataSize);
+		//the queued samples without a copy, valid until consumeData. setConvertingParameters moves the ring
+		//and invalidates the pointer, it must not run between peekData and consumeData
+		uint32_t peekData(const uint8_t** data);
+		void consumeData(uint32_t size);
 		double getLastPts();
 		double getRtspDifferencePts();
 		int64_t getLastPtsCheckTime();
@@ -39,20 +46,30 @@ class AudioDecoder: public AVBaseDecoder {
 
 		int nbSmples = 0;
 
-		uint32_t dataSize = 0;
+		AVPcmRing pcm; //the converted samples, planar formats plane after plane for every frame
+		uint32_t frontBytesTaken = 0; //of the front frame, by the consumer
+		std::atomic<size_t> chunkBytes = {0}; //the most the converter can write for the next frame
+		std::atomic<size_t> pcmCapacity = {0}; //pcm.capacity() for hasFrameSpace, which can't take frameMutex
+		std::vector<uint8_t> planarBuffer;
+		std::vector<uint8_t*> planarData;
 
 		double lastPts = 0.0;
 		double rtspDifferencePts = 0.0;
 		int64_t lastPtsCheckTime = 0;
 
-		uint32_t frameDataGivenAway = 0;
-		uint32_t ftameDataPtrIndex = 0;
-
-		uint32_t getDataFromFrame(AVFrame* decodedFrame, bool& isEmpty, uint8_t* data, uint32_t requairedDataSize);
+		void updateLastPts(AVFrame* decodedFrame);
+		void framesTaken(uint32_t size);
+		static uint32_t chunkSize(const AVFrame* chunk);
+		int convertToPcm(SwrContext* context, const uint8_t** source, int sourceSamples);
+		int convertDirectly(const AVFrame* source); //-1 when the frame has to go through swr
+		virtual bool hasFrameSpace() override;
+		virtual void resizeFrameRing() override;
 		virtual bool convertFrame(AVFrame* dest, AVFrame* source) override;
 		void reconvertAll(AVSampleFormat oldSample_format, int oldSample_rate, int64_t oldCh_layuot);
-		virtual void handleEndOfFile(std::unique_lock<std::mutex>& frameLocker) override;
-		void initFrameBuffer() override;
+		virtual DecodingStep handleEndOfFile(std::unique_lock<std::mutex>& codecLocker) override;
+		virtual double framesRate() override;
+		virtual size_t frameBytes() override;
+		virtual void dropQueuedFrames() override;
 };
 
 #endif // AUDIODECODER_H
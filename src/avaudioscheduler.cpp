@@ -0,0 +1,118 @@
+#include "avaudioscheduler.h"
+
+AVAudioScheduler::AVAudioScheduler() {
+	thread = std::thread(&AVAudioScheduler::scheduling, this);
+}
+
+AVAudioScheduler::~AVAudioScheduler() {
+	std::unique_lock<std::mutex> clientsLocker(clientsMutex);
+	stopping = true;
+	clientsLocker.unlock();
+	wakeupCond.notify_all();
+	if(thread.joinable()) {
+		thread.join();
+	}
+}
+
+std::shared_ptr<AVAudioScheduler> AVAudioScheduler::shared() {
+	static std::mutex sharedMutex;
+	static std::weak_ptr<AVAudioScheduler> sharedScheduler;
+	std::lock_guard<std::mutex> sharedLocker(sharedMutex);
+	std::shared_ptr<AVAudioScheduler> scheduler = sharedScheduler.lock();
+	if(!scheduler) {
+		scheduler = std::make_shared<AVAudioScheduler>();
+		sharedScheduler = scheduler;
+	}
+	return scheduler;
+}
+
+uint64_t AVAudioScheduler::add(Tick tick, int64_t firstDeadline) {
+	std::unique_ptr<Client> client(new Client);
+	client->tick = tick;
+	client->deadline = firstDeadline;
+	std::unique_lock<std::mutex> clientsLocker(clientsMutex);
+	uint64_t clientId = ++ lastClientId;
+	clients[clientId] = std::move(client);
+	wakeups.push(Wakeup{firstDeadline, clientId});
+	clientsLocker.unlock();
+	wakeupCond.notify_one();
+	return clientId;
+}
+
+void AVAudioScheduler::remove(uint64_t clientId) {
+	std::unique_lock<std::mutex> clientsLocker(clientsMutex);
+	if(std::this_thread::get_id() == thread.get_id() && runningClientId == clientId) { //from inside its own tick, waiting would never end
+		auto it = clients.find(clientId);
+		if(it != clients.end()) {
+			it->second->removed = true; //erased by the scheduler once the tick returns
+		}
+		return;
+	}
+	tickFinishedCond.wait(clientsLocker, [&](){return runningClientId != clientId;});
+	clients.erase(clientId); //its wakeup is dropped when it reaches the top of the queue
+}
+
+AVAudioScheduler::JitterStats AVAudioScheduler::getStats(uint64_t clientId) {
+	std::lock_guard<std::mutex> clientsLocker(clientsMutex);
+	auto it = clients.find(clientId);
+	if(it == clients.end()) {
+		return JitterStats();
+	}
+	return it->second->stats;
+}
+
+AVAudioScheduler::JitterStats AVAudioScheduler::getStats() {
+	std::lock_guard<std::mutex> clientsLocker(clientsMutex);
+	return stats;
+}
+
+void AVAudioScheduler::scheduling() {
+	std::unique_lock<std::mutex> clientsLocker(clientsMutex);
+	while(!stopping) {
+		if(wakeups.empty()) {
+			wakeupCond.wait(clientsLocker);
+			continue;
+		}
+		Wakeup wakeup = wakeups.top();
+		auto it = clients.find(wakeup.clientId);
+		if(it == clients.end() || it->second->deadline != wakeup.deadline) { //removed client
+			wakeups.pop();
+			continue;
+		}
+		int64_t now = av_gettime_relative();
+		if(now < wakeup.deadline) {
+			wakeupCond.wait_for(clientsLocker, std::chrono::microseconds(wakeup.deadline - now));
+			continue;
+		}
+		wakeups.pop();
+
+		Client* client = it->second.get();
+		runningClientId = wakeup.clientId;
+		clientsLocker.unlock();
+		int64_t nextDeadline = client->tick(wakeup.deadline, now);
+		clientsLocker.lock();
+		runningClientId = 0;
+
+		addLateness(client->stats, client->latenessSum, now - wakeup.deadline);
+		addLateness(stats, latenessSum, now - wakeup.deadline);
+		if(nextDeadline >= 0 && !client->removed) {
+			client->deadline = nextDeadline;
+			wakeups.push(Wakeup{nextDeadline, wakeup.clientId});
+		}else {
+			clients.erase(wakeup.clientId);
+		}
+		tickFinishedCond.notify_all();
+	}
+}
+
+void AVAudioScheduler::addLateness(JitterStats& stats, int64_t& latenessSum, int64_t lateness) {
+	++ stats.wakeups;
+	latenessSum += lateness;
+	stats.averageLateness = latenessSum / static_cast<int64_t>(stats.wakeups);
+	if(lateness > stats.maxLateness) {
+		stats.maxLateness = lateness;
+	}
+	if(lateness > 1000) {
+		++ stats.lateOverMillisecond;
+	}
+}
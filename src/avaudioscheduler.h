@@ -0,0 +1,75 @@
+#ifndef AVAUDIOSCHEDULER_H
+#define AVAUDIOSCHEDULER_H
+
+extern "C" {
+	#include <libavutil/time.h>
+}
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//One timer thread for the audio callbacks of all streams.
+//Each client is woken at its deadline from a deadline queue, the thread sleeps
+//on a condition variable in between instead of polling the clock.
+class AVAudioScheduler {
+	public:
+		//gets the deadline it was woken for and the current time (av_gettime_relative),
+		//returns the next deadline or a negative value to leave the scheduler
+		using Tick = std::function<int64_t(int64_t deadline, int64_t now)>;
+
+		struct JitterStats {
+			uint64_t wakeups = 0;
+			int64_t averageLateness = 0; //microseconds between the deadline and the call
+			int64_t maxLateness = 0;
+			uint64_t lateOverMillisecond = 0;
+		};
+
+		AVAudioScheduler();
+		AVAudioScheduler(const AVAudioScheduler&) = delete;
+		AVAudioScheduler& operator = (const AVAudioScheduler&) = delete;
+		~AVAudioScheduler();
+		static std::shared_ptr<AVAudioScheduler> shared(); //the thread lives while someone holds the scheduler
+		uint64_t add(Tick tick, int64_t firstDeadline);
+		//after return the tick isn't running and won't be called again, from inside the tick itself it is just not called again
+		void remove(uint64_t clientId);
+		JitterStats getStats(uint64_t clientId);
+		JitterStats getStats(); //all clients together
+
+	private:
+		struct Client {
+			Tick tick;
+			int64_t deadline = 0;
+			JitterStats stats;
+			int64_t latenessSum = 0;
+			bool removed = false; //by remove() from inside the tick
+		};
+		struct Wakeup {
+			int64_t deadline;
+			uint64_t clientId;
+			bool operator > (const Wakeup& other) const {return deadline > other.deadline;}
+		};
+
+		std::thread thread;
+		std::mutex clientsMutex;
+		std::condition_variable wakeupCond;
+		std::condition_variable tickFinishedCond;
+		std::unordered_map<uint64_t, std::unique_ptr<Client>> clients;
+		std::priority_queue<Wakeup, std::vector<Wakeup>, std::greater<Wakeup>> wakeups;
+		uint64_t lastClientId = 0;
+		uint64_t runningClientId = 0;
+		JitterStats stats;
+		int64_t latenessSum = 0;
+		bool stopping = false;
+
+		void scheduling();
+		static void addLateness(JitterStats& stats, int64_t& latenessSum, int64_t lateness);
+};
+
+#endif // AVAUDIOSCHEDULER_H
@@ -1,68 +1,32 @@
 ﻿#include "avbasedecoder.h"
 
-AVBaseDecoder::~AVBaseDecoder() {
-	stop();
-}
-
-void AVBaseDecoder::init() {
-	if(buffersInitialized) return;
-	initPackepBuffer();
-	initFrameBuffer();
-	buffersInitialized = true;
-}
-
-bool AVBaseDecoder::start() {
-	if(running || !codecContext || !stream){return false;}
-	packetWriteIndex = packetReadIndex = 0;
-	frameReadIndex = frameWriteIndex = 0;
-	running = true;
-	stopping = false;
-	endOfFile = false;
-	decodingThread = std::thread(&AVBaseDecoder::decoding, this);
-	return true;
-}
-
-void AVBaseDecoder::stop() {
-	std::unique_lock<std::mutex> packLocker(packetMutex);
-	std::unique_lock<std::mutex> frameLocker(frameMutex);
-	stopping = true;
-	frameLocker.unlock();
-	frameCond.notify_all();
-	packLocker.unlock();
-	packetCond.notify_all();
-	if(decodingThread.joinable()) {
-		decodingThread.join();
-	}
-	for(auto& packetContainer : packet) {
-		packetContainer.unrefPtr();
-	}
-	for(auto& frameContainer : frame) {
-		frameContainer.unrefPtr();
-	}
-	if(codecContext) {
-		avcodec_flush_buffers(codecContext);
-		avcodec_free_context(&codecContext);
-		codecContext = nullptr;
-	}
-	packetWriteIndex = packetReadIndex = 0;
-	frameReadIndex = frameWriteIndex = 0;
-	stream = nullptr;
-	stopping = false;
+void AVBaseDecoder::setDropBefore(int64_t pts) {
+	dropBeforePts = pts;
 }
 
 void AVBaseDecoder::fileFinished() {
-	std::unique_lock<std::mutex> packLocker(packetMutex);
 	if(stopping) return;
 	endOfFile = true;
-	packLocker.unlock();
-	packetCond.notify_one();
+	packet.wakeAll();
+	scheduleDecoding();
 }
 
 bool AVBaseDecoder::isRunning() {
 	return running;
 }
 
+bool AVBaseDecoder::canPushPacket() {
+	return !packet.isFull();
+}
+
+bool AVBaseDecoder::setDecodingPool(AVDecodingPool* pool) {
+	if(running) return false;
+	decodingPool = pool;
+	return true;
+}
+
 bool AVBaseDecoder::setStreamAndCodecContext(AVStream* newStream, AVCodecContext* newCodecContext) {
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	std::unique_lock<std::mutex> frameLocker(frameMutex);
 	if(codecContext) {
 		avcodec_flush_buffers(codecContext);
@@ -75,121 +39,169 @@ bool AVBaseDecoder::setStreamAndCodecContext(AVStream* newStream, AVCodecContext
 	return true;
 }
 
+void AVBaseDecoder::replaceStream(AVStream* newStream) {
+	std::lock_guard<std::mutex> codecLocker(codecMutex);
+	std::lock_guard<std::mutex> frameLocker(frameMutex);
+	stream = newStream;
+}
+
 bool AVBaseDecoder::pushPacket(AVPacket* newPacket) {
 	if(!running || stopping || endOfFile) return false;
 
-	std::unique_lock<std::mutex> packLocker(packetMutex);
-	if(stopping) return false;
-	if(((packetWriteIndex < packetReadIndex) && (packetReadIndex - packetWriteIndex < 6)) //free space in the buffer is less then 6 items
-	 ||((packetWriteIndex > packetReadIndex) && (packetWriteIndex - packetReadIndex > packetsBufferSize - 6))) { //free space in the buffer is less then 6 items
-		packetCond.wait(packLocker, [&](){
-			return (packetWriteIndex == packetReadIndex)
-					|| (((packetWriteIndex < packetReadIndex) && (packetReadIndex - packetWriteIndex > 6)) //the buffer has free item
-					 || ((packetWriteIndex > packetReadIndex) && (packetWriteIndex - packetReadIndex < packetsBufferSize - 6)))//the buffer has free item
-					|| stopping;});
-		if(stopping) {
+	if(!packet.waitForSpace([&](){return stopping.load();}) || stopping) {
+		return false;
+	}
+	if(packet.back().getPtr() == nullptr) {
+		packet.back().setUnreferencedPtr(av_packet_alloc());
+		if(packet.back().getPtr() == nullptr) {
 			return false;
 		}
 	}
-	av_packet_ref(packet[static_cast<unsigned>(packetWriteIndex)].getPtr(), newPacket);
-	packet[static_cast<unsigned>(packetWriteIndex ++)].markPtrHowReferenced();
-	if(static_cast<unsigned>(packetWriteIndex) >= packet.size()) {
-		packetWriteIndex = 0;
+	if(av_packet_ref(packet.back().getPtr(), newPacket) < 0) {
+		return false;
 	}
-	packLocker.unlock();
-	packetCond.notify_one();
+	packet.back().markPtrHowReferenced();
+	packet.push();
+	queuedPackets.add(1);
+	pushedPacketBytes.add(static_cast<uint64_t>(newPacket->size));
+	scheduleDecoding();
+	return true;
+}
+
+void AVBaseDecoder::setLowLatency(bool enabled) {
+	lowLatency = enabled;
+}
+
+void AVBaseDecoder::setBufferDepth(unsigned int packetsMs, unsigned int framesMs) {
+	packetsDepthMs = packetsMs;
+	framesDepthMs = framesMs;
+}
+
+bool AVBaseDecoder::setMemoryBudget(AVMemoryBudget* budget) {
+	if(running) return false;
+	std::lock_guard<std::mutex> frameLocker(frameMutex);
+	releaseBudget();
+	memoryBudget = budget;
 	return true;
 }
 
+AVBaseDecoder::Stats& AVBaseDecoder::Stats::operator += (const Stats& other) {
+	packetsQueued += other.packetsQueued;
+	packetsDecoded += other.packetsDecoded;
+	framesDecoded += other.framesDecoded;
+	framesDropped += other.framesDropped;
+	packetsInRing += other.packetsInRing;
+	framesInRing += other.framesInRing;
+	decodingTime += other.decodingTime;
+	convertingTime += other.convertingTime;
+	lockWaitingTime += other.lockWaitingTime;
+	packetsCapacity += other.packetsCapacity;
+	framesCapacity += other.framesCapacity;
+	packetsBytes += other.packetsBytes;
+	framesBytes += other.framesBytes;
+	return *this;
+}
+
+AVBaseDecoder::Stats AVBaseDecoder::getStats() {
+	Stats stats;
+	stats.packetsQueued = queuedPackets.get();
+	stats.packetsDecoded = decodedPackets.get();
+	stats.framesDecoded = decodedFrames.get();
+	stats.framesDropped = skippedFrames.get();
+	stats.packetsInRing = packet.count();
+	stats.decodingTime = decodingTime.get();
+	stats.convertingTime = convertingTime.get();
+	stats.lockWaitingTime = decoderLockWaiting.get() + consumerLockWaiting.get();
+	stats.packetsCapacity = packet.size() - 1;
+	uint64_t poppedBytes = poppedPacketBytes.get(); //before the pushed ones, so the difference can't go below zero
+	uint64_t pushedBytes = pushedPacketBytes.get();
+	stats.packetsBytes = pushedBytes > poppedBytes ? pushedBytes - poppedBytes : 0;
+	stats.framesBytes = framesRingBytes;
+	return stats;
+}
+
 bool AVBaseDecoder::isReady() {
 	return (codecContext && stream);
 }
 
-void AVBaseDecoder::decoding() {
-	AVFrame* frameforDecoding = av_frame_alloc();
-	int temp = 0;
-	auto deleter = [&](int*) {
-		running = false;
-		av_frame_free(&frameforDecoding);
-		if(!stopping) {
-			stopping = true;
-			packetCond.notify_one();
-		}
-	};
-	std::unique_ptr<int, decltype(deleter)> threadFinishIndicator(&temp, deleter);
-
-	while(!stopping) {
-		std::unique_lock<std::mutex> packLocker(packetMutex);
-		if(stopping) return;
-		if(packetReadIndex == packetWriteIndex) {
-			if(endOfFile) {
-				return;
-			}
-			packetCond.wait(packLocker, [&](){
-				return packetReadIndex != packetWriteIndex || stopping || endOfFile;
-			});
-			if(stopping || (endOfFile && (packetReadIndex == packetWriteIndex))) {
-				return;
-			}
-		}
-		AVPacket* srcPacket = packet[static_cast<unsigned>(packetReadIndex)].getPtr();
+void AVBaseDecoder::decodingFinished() {
+	running = false;
+	if(!stopping) {
+		stopping = true;
+		packet.wakeAll();
+	}
+}
 
-		std::unique_lock<std::mutex> frameLocker(frameMutex); // for protect codecContext
-		int result = avcodec_send_packet(codecContext, srcPacket);
-		packet[static_cast<unsigned>(packetReadIndex ++)].unrefPtr();
-		if(static_cast<unsigned>(packetReadIndex) >= packet.size()) {
-			packetReadIndex = 0;
-		}
-		packLocker.unlock();
-		packetCond.notify_one();
-		if(result != 0) {
-			continue;
-		}
-		result = avcodec_receive_frame(codecContext, frameforDecoding);
-		if(result == 0) {
-			if(stopping) return;
-
-			if(((frameWriteIndex < frameReadIndex) && (frameReadIndex - frameWriteIndex < 6))//free space in the buffer is less then 6 items
-			 ||((frameWriteIndex > frameReadIndex) && (frameWriteIndex - frameReadIndex > framesBufferSize - 6))) {//free space in the buffer is less then 6 items
-				frameCond.wait(frameLocker, [&](){
-					return (frameWriteIndex == frameReadIndex)
-							|| (((frameWriteIndex < frameReadIndex) && (frameReadIndex - frameWriteIndex > 6))//the buffer has free item
-							 || ((frameWriteIndex > frameReadIndex) && (frameWriteIndex - frameReadIndex < framesBufferSize - 6)))//the buffer has free item
-							|| stopping;});
-				if(stopping) {
-					return;
-				}
-			}
-			if(convertFrame(frame[static_cast<unsigned>(frameWriteIndex)].getPtr(), frameforDecoding)) {
-				if(frame[static_cast<unsigned>(frameWriteIndex)].hasDoSomething()) {
-					frame[static_cast<unsigned>(frameWriteIndex)].doSomething();
-				}
-				frame[static_cast<unsigned>(frameWriteIndex ++)].markPtrHowReferenced();
-				if(static_cast<unsigned>(frameWriteIndex) >= frame.size()) {
-					frameWriteIndex = 0;
-				}
-				frameLocker.unlock();
-			}
-			av_frame_unref(frameforDecoding);
-		}else if(result != AVERROR(EAGAIN)) {
-			handleEndOfFile(frameLocker);
-			break;
-		}
+void AVBaseDecoder::lockCounted(std::unique_lock<std::mutex>& locker, AVCounter& waitingTime) {
+	if(locker.try_lock()) {
+		return;
+	}
+	int64_t waitingStart = AVCounter::now();
+	locker.lock();
+	waitingTime.add(static_cast<uint64_t>(AVCounter::now() - waitingStart));
+}
+
+void AVBaseDecoder::runDecodingTask() {
+	DecodingStep step = STEP_DONE;
+	for(int i = 0; i < decodingStepsPerTask && step == STEP_DONE; ++ i) {
+		step = decodeStep();
+	}
+	if(step == STEP_FINISHED) {
+		decodingFinished(); //taskQueued stays set, nothing is submitted until the next start()
+		return;
+	}
+	taskQueued = false;
+	//a packet or a free slot could appear while the flag was set, nobody submitted us then
+	if(step == STEP_DONE
+	 ||(step == STEP_NEED_PACKET && (!packet.isEmpty() || endOfFile))
+	 ||(step == STEP_NEED_SPACE && hasFrameSpace())) {
+		scheduleDecoding();
 	}
 }
 
-void AVBaseDecoder::initPackepBuffer() {
-	for(auto& packetContainer : packet) {
-		packetContainer.setDeleter([](AVPacket* packet) {av_packet_free(&packet);});
-		packetContainer.setUnreferencer([](AVPacket* packet) {av_packet_unref(packet);});
-		packetContainer.setUnreferencedPtr(av_packet_alloc());
+void AVBaseDecoder::scheduleDecoding() {
+	if(decodingPool == nullptr || taskQueued.exchange(true)) return;
+	std::lock_guard<std::mutex> scheduleLocker(scheduleMutex);
+	if(!running || stopping) {
+		taskQueued = false;
+		return;
 	}
+	decodingPool->submit(this);
 }
 
-void AVBaseDecoder::initFrameBuffer() {
-	for(auto& frameContainer : frame) {
-		frameContainer.setDeleter([](AVFrame* frame) {av_frame_free(&frame);});
-		frameContainer.setUnreferencer([](AVFrame* frame) {av_frame_unref(frame);});
-		frameContainer.setUnreferencedPtr(av_frame_alloc());
+unsigned int AVBaseDecoder::slotsForDepth(unsigned int depthMs, unsigned int defaultSlots, unsigned int minSlots, unsigned int maxSlots) {
+	if(depthMs == 0) {
+		return defaultSlots;
 	}
+	double slots = framesRate() * depthMs / 1000.0 + 1.0; //one slot always stays free
+	return slots < minSlots ? minSlots
+							: slots > maxSlots ? maxSlots
+											   : static_cast<unsigned int>(slots);
+}
+
+void AVBaseDecoder::resizePacketRing() {
+	unsigned int slots = slotsForDepth(packetsDepthMs, defaultPacketsSlots, minPacketsSlots, maxPacketsSlots);
+	packet.resize(slots);
+}
+
+void AVBaseDecoder::releaseBudget() {
+	if(memoryBudget && budgetReservation > 0) {
+		memoryBudget->release(budgetReservation);
+	}
+	budgetReservation = 0;
+	framesRingBytes = 0;
+}
+
+double AVBaseDecoder::framesRate() {
+	if(stream && stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0) {
+		return av_q2d(stream->avg_frame_rate);
+	}
+	if(stream && stream->r_frame_rate.num > 0 && stream->r_frame_rate.den > 0) {
+		return av_q2d(stream->r_frame_rate);
+	}
+	return 25.0;
+}
+
+size_t AVBaseDecoder::frameBytes() {
+	return 0;
 }
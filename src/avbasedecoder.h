@@ -7,65 +7,134 @@ extern "C" {
 }
 
 #include <array>
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
 #include <memory>
 
+#include "avcounter.h"
 #include "avitemcontainer.h"
+#include "avspscring.h"
+#include "avdecodingpool.h"
+#include "avmemorybudget.h"
 
 class AVBaseDecoder {
 	public:
-		using AVPacketType = AVItemContainer<AVPacket,
-											std::function<void(AVPacket*)>,
-											std::function<void(AVPacket*)>,
-											std::function<void(AVPacket*)>>;
+		struct PacketDeleter {
+			void operator () (AVPacket* packet) const {
+				av_packet_free(&packet);
+			}
+		};
+		struct PacketUnreferencer {
+			void operator () (AVPacket* packet) const {
+				av_packet_unref(packet);
+			}
+		};
+		using AVPacketType = AVItemContainer<AVPacket, PacketDeleter, PacketUnreferencer>;
 
-		using AVFrameType = AVItemContainer<AVFrame,
-											std::function<void(AVFrame*)>,
-											std::function<void(AVFrame*)>,
-											std::function<void(AVFrame*)>>;
+		struct Stats {
+			uint64_t packetsQueued = 0;
+			uint64_t packetsDecoded = 0;
+			uint64_t framesDecoded = 0;
+			uint64_t framesDropped = 0; //decoded only to reach a seek target, stale in LOW_LATENCY mode
+			unsigned int packetsInRing = 0;
+			unsigned int framesInRing = 0;
+			uint64_t decodingTime = 0; //nanoseconds in avcodec_send_packet and avcodec_receive_frame
+			uint64_t convertingTime = 0; //nanoseconds converting the decoded frames
+			uint64_t lockWaitingTime = 0; //nanoseconds the decoder waited for codecMutex and the consumer for frameMutex
+			unsigned int packetsCapacity = 0;
+			unsigned int framesCapacity = 0;
+			uint64_t packetsBytes = 0; //payload of the queued packets
+			uint64_t framesBytes = 0; //converted frames the frames ring can hold at the current size
+			Stats& operator += (const Stats& other);
+		};
 
-		virtual ~AVBaseDecoder();
-		void init();
-		bool start();
-		void stop();
+		virtual ~AVBaseDecoder() = default;
+		void setDropBefore(int64_t pts); //frames before the pts (stream time base) are decoded but not published
 		void fileFinished();
 		bool isRunning();
+		bool setDecodingPool(AVDecodingPool* pool); //nullptr to decode in an own thread
 		bool setStreamAndCodecContext(AVStream* newStream, AVCodecContext* newCodecContext);
+		void replaceStream(AVStream* newStream); //the same stream from a new connection, the codec context stays
 		bool pushPacket(AVPacket* newPacket);
+		bool canPushPacket(); //pushPacket won't block
 		bool isReady();
+		void setLowLatency(bool enabled); //skips non-reference frames when the frames ring fills up
+		//ring depths in milliseconds of media, 0 keeps the default slot counts, applied by the next start()
+		void setBufferDepth(unsigned int packetsMs, unsigned int framesMs);
+		bool setMemoryBudget(AVMemoryBudget* budget); //caps the frames ring, the budget must outlive the decoder
+		virtual Stats getStats();
 
 	protected:
-		bool buffersInitialized = false;
-		bool running = false;
-		bool stopping = false;
-		bool endOfFile = false;
+		enum DecodingStep {
+			STEP_DONE,
+			STEP_NEED_PACKET,
+			STEP_NEED_SPACE,
+			STEP_FINISHED
+		};
 
-		static const int packetsBufferSize = 40;
-		std::array<AVPacketType, packetsBufferSize> packet;
-		int packetWriteIndex = 0;
-		int packetReadIndex = 0;
-		std::mutex packetMutex;
-		std::condition_variable packetCond;
+		std::atomic<bool> running = {false};
+		std::atomic<bool> stopping = {false};
+		std::atomic<bool> endOfFile = {false};
+		std::atomic<bool> lowLatency = {false};
+		std::atomic<int64_t> dropBeforePts = {AV_NOPTS_VALUE};
+
+		AVCounter queuedPackets; //by the reading thread
+		AVCounter decodedPackets; //by the decoding thread or task
+		AVCounter decodedFrames;
+		AVCounter skippedFrames;
+		AVCounter decodingTime;
+		AVCounter convertingTime;
+		AVCounter decoderLockWaiting;
+		AVCounter consumerLockWaiting; //by the consumer
+		AVCounter pushedPacketBytes; //by the reading thread
+		AVCounter poppedPacketBytes; //by the decoding thread or task, and by stop() and flush()
+
+		static const unsigned int defaultPacketsSlots = 40;
+		static const unsigned int minPacketsSlots = 4;
+		static const unsigned int maxPacketsSlots = 1024;
+		AVSpscRing<AVPacketType> packet{defaultPacketsSlots}; //the slots get their packet when first written
+		std::atomic<unsigned int> packetsDepthMs = {0};
 
 		std::thread decodingThread;
-		static const int framesBufferSize = 20;
-		std::array<AVFrameType, framesBufferSize> frame;
-		int frameWriteIndex = 0;
-		int frameReadIndex = 0;
-		std::mutex frameMutex;
-		std::condition_variable frameCond;
+		AVDecodingPool* decodingPool = nullptr;
+		static const int decodingStepsPerTask = 8;
+		std::atomic<bool> taskQueued = {false};
+		std::atomic<bool> taskRunning = {false};
+		std::mutex scheduleMutex;
+		AVFrame* frameforDecoding = nullptr;
+		bool frameDecoded = false;
+		bool codecDrained = false; //the end of the file was sent to the codec, it gives out the delayed frames
+		static const unsigned int defaultFramesSlots = 20;
+		static const unsigned int minFramesSlots = 3;
+		static const unsigned int maxFramesSlots = 256;
+		std::atomic<unsigned int> framesDepthMs = {0};
+		AVMemoryBudget* memoryBudget = nullptr;
+		size_t budgetReservation = 0; //with frameMutex
+		std::atomic<uint64_t> framesRingBytes = {0};
+		std::mutex codecMutex; //codecContext and the converter, the decoder holds it while decoding and converting
+		std::mutex frameMutex; //ring contents: the consumer against reconfiguration, the decoder publishes without it
 
 		AVCodecContext* codecContext = nullptr;
 		AVStream* stream = nullptr;
 
-		void decoding();
+		virtual DecodingStep decodeStep() = 0; //by the decoding thread or task
+		void decodingFinished();
+		void lockCounted(std::unique_lock<std::mutex>& locker, AVCounter& waitingTime); //the locker is deferred
+		void runDecodingTask();
+		void scheduleDecoding();
+		unsigned int slotsForDepth(unsigned int depthMs, unsigned int defaultSlots, unsigned int minSlots, unsigned int maxSlots);
+		void resizePacketRing();
+		virtual bool hasFrameSpace() = 0; //by the decoding thread or task only
+		void releaseBudget();
+		virtual double framesRate(); //frames (and about as many packets) per second of media
+		virtual size_t frameBytes(); //0 while the converted frame size is unknown
 		virtual bool convertFrame(AVFrame* dest, AVFrame* source) = 0;
-		virtual void handleEndOfFile(std::unique_lock<std::mutex>& frameLocker) = 0;
-		virtual void initPackepBuffer();
-		virtual void initFrameBuffer();
+		virtual DecodingStep handleEndOfFile(std::unique_lock<std::mutex>& codecLocker) = 0; //called again each step until STEP_FINISHED
+
+		friend class AVDecodingPool;
 };
 
 #endif // AVABSTACTDECODER_H
@@ -0,0 +1,27 @@
+#ifndef AVCOUNTER_H
+#define AVCOUNTER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//Statistics counter written by one thread at a time and read by any thread.
+//The writer adds with a relaxed load and store, so counting costs no locked instruction.
+//Readers get a value that can be a little behind, never a torn one.
+class AVCounter {
+	public:
+		void add(uint64_t value) {
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+		uint64_t get() const {
+			return counter.load(std::memory_order_relaxed);
+		}
+		static int64_t now() { //nanoseconds for the time counters
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+	private:
+		std::atomic<uint64_t> counter = {0};
+};
+
+#endif // AVCOUNTER_H
@@ -0,0 +1,103 @@
+#include "avdecodingpool.h"
+#include "avbasedecoder.h"
+
+#include <algorithm>
+
+AVDecodingPool::AVDecodingPool(unsigned int threadsCount) {
+	if(threadsCount == 0) {
+		threadsCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for(unsigned int i = 0; i < threadsCount; ++ i) {
+		workers.emplace_back(new Worker);
+	}
+	for(unsigned int i = 0; i < threadsCount; ++ i) {
+		workers[i]->thread = std::thread(&AVDecodingPool::working, this, i);
+	}
+}
+
+AVDecodingPool::~AVDecodingPool() {
+	std::unique_lock<std::mutex> idleLocker(idleMutex);
+	stopping = true;
+	idleLocker.unlock();
+	idleCond.notify_all();
+	for(auto& worker : workers) {
+		if(worker->thread.joinable()) {
+			worker->thread.join();
+		}
+	}
+}
+
+void AVDecodingPool::submit(AVBaseDecoder* decoder) {
+	Worker& worker = *workers[nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+	std::unique_lock<std::mutex> queueLocker(worker.queueMutex);
+	worker.queue.push_back(decoder);
+	queueLocker.unlock();
+	++ pendingTasks;
+	if(sleepingWorkers > 0) {
+		std::lock_guard<std::mutex> idleLocker(idleMutex);
+		idleCond.notify_one();
+	}
+}
+
+void AVDecodingPool::cancel(AVBaseDecoder* decoder) {
+	for(auto& worker : workers) {
+		std::lock_guard<std::mutex> queueLocker(worker->queueMutex);
+		auto it = std::find(worker->queue.begin(), worker->queue.end(), decoder);
+		if(it != worker->queue.end()) {
+			worker->queue.erase(it);
+			-- pendingTasks;
+		}
+	}
+	//a task leaves a queue only when a worker marks it running, so it can't be missed here
+	std::unique_lock<std::mutex> idleLocker(idleMutex);
+	++ cancelWaiters;
+	taskFinishedCond.wait(idleLocker, [&](){return !decoder->taskRunning;});
+	-- cancelWaiters;
+}
+
+unsigned int AVDecodingPool::threadsCount() {
+	return static_cast<unsigned int>(workers.size());
+}
+
+void AVDecodingPool::working(unsigned int workerIndex) {
+	while(true) {
+		AVBaseDecoder* task = takeTask(workerIndex);
+		if(task == nullptr) {
+			std::unique_lock<std::mutex> idleLocker(idleMutex);
+			if(stopping) return;
+			++ sleepingWorkers;
+			idleCond.wait(idleLocker, [&](){return pendingTasks > 0 || stopping;});
+			-- sleepingWorkers;
+			if(stopping) return;
+			continue;
+		}
+		task->runDecodingTask();
+		task->taskRunning = false;
+		if(cancelWaiters > 0) {
+			std::lock_guard<std::mutex> idleLocker(idleMutex);
+			taskFinishedCond.notify_all();
+		}
+	}
+}
+
+AVBaseDecoder* AVDecodingPool::takeTask(unsigned int workerIndex) {
+	for(unsigned int i = 0; i < workers.size(); ++ i) {
+		Worker& worker = *workers[(workerIndex + i) % workers.size()];
+		std::lock_guard<std::mutex> queueLocker(worker.queueMutex);
+		if(worker.queue.empty()) {
+			continue;
+		}
+		AVBaseDecoder* task = nullptr;
+		if(i == 0) { //own queue in order, steal from the tail of the others
+			task = worker.queue.front();
+			worker.queue.pop_front();
+		}else {
+			task = worker.queue.back();
+			worker.queue.pop_back();
+		}
+		task->taskRunning = true;
+		-- pendingTasks;
+		return task;
+	}
+	return nullptr;
+}
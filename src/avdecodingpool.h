@@ -0,0 +1,47 @@
+#ifndef AVDECODINGPOOL_H
+#define AVDECODINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AVBaseDecoder;
+
+//Fixed set of worker threads shared by many decoders.
+//A decoder is submitted when it has packets to decode and room for frames,
+//each worker runs its own queue first and steals from the others when it is empty.
+class AVDecodingPool {
+	public:
+		explicit AVDecodingPool(unsigned int threadsCount = 0); //0 means one thread per core
+		AVDecodingPool(const AVDecodingPool&) = delete;
+		AVDecodingPool& operator = (const AVDecodingPool&) = delete;
+		~AVDecodingPool();
+		void submit(AVBaseDecoder* decoder);
+		void cancel(AVBaseDecoder* decoder); //after return the decoder is neither queued nor running
+		unsigned int threadsCount();
+
+	private:
+		struct Worker {
+			std::thread thread;
+			std::mutex queueMutex;
+			std::deque<AVBaseDecoder*> queue;
+		};
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<unsigned int> pendingTasks = {0};
+		std::atomic<unsigned int> nextWorker = {0};
+		std::atomic<unsigned int> sleepingWorkers = {0};
+		std::atomic<unsigned int> cancelWaiters = {0};
+		std::mutex idleMutex;
+		std::condition_variable idleCond;
+		std::condition_variable taskFinishedCond;
+		bool stopping = false;
+
+		void working(unsigned int workerIndex);
+		AVBaseDecoder* takeTask(unsigned int workerIndex);
+};
+
+#endif // AVDECODINGPOOL_H
@@ -0,0 +1,138 @@
+#include "avdescriptortable.h"
+#include "avfilecontext.h"
+
+AVDescriptorTable::Handle::Handle(AVDescriptorTable* table, int index, AVfileContext* context) :
+	table(table),
+	index(index),
+	context(context) {
+}
+
+AVDescriptorTable::Handle::Handle(Handle&& other) :
+	table(other.table),
+	index(other.index),
+	context(other.context) {
+	other.table = nullptr;
+	other.context = nullptr;
+}
+
+AVDescriptorTable::Handle::~Handle() {
+	if(table) {
+		table->release(index);
+	}
+}
+
+AVDescriptorTable::AVDescriptorTable() :
+	slots(new Slot[capacity]) {
+}
+
+AVDescriptorTable::~AVDescriptorTable() {
+	clear();
+}
+
+int AVDescriptorTable::insert(AVfileContext* context) {
+	std::unique_lock<std::mutex> freeSlotsLocker(freeSlotsMutex);
+	int index = -1;
+	if(!freeSlots.empty()) {
+		index = freeSlots.front(); //the slot closed longest ago, its generation wraps last
+		freeSlots.pop_front();
+	}else if(unusedSlot < capacity) {
+		index = unusedSlot ++;
+	}else {
+		return -1;
+	}
+	freeSlotsLocker.unlock();
+
+	Slot& slot = slots[index];
+	slot.context = context;
+	uint64_t state = slot.state.load();
+	slot.state.store(state | aliveBit);
+	++ filesCount;
+	return static_cast<int>((state >> 32) << indexBits) | index;
+}
+
+bool AVDescriptorTable::remove(int descriptor) {
+	if(descriptor < 0) {
+		return false;
+	}
+	int index = descriptor & (capacity - 1);
+	uint64_t generation = static_cast<uint64_t>(descriptor) >> indexBits;
+	Slot& slot = slots[index];
+
+	++ removeWaiters;
+	uint64_t state = slot.state.load();
+	do {
+		if(!(state & aliveBit) || (state >> 32) != generation) {
+			-- removeWaiters;
+			return false;
+		}
+	}while(!slot.state.compare_exchange_weak(state, state & ~aliveBit));
+	std::unique_lock<std::mutex> releaseLocker(releaseMutex);
+	releaseCond.wait(releaseLocker, [&](){return (slot.state.load() & referencesMask) == 0;});
+	releaseLocker.unlock();
+	-- removeWaiters;
+
+	AVfileContext* context = slot.context;
+	slot.context = nullptr;
+	context->closeFile();
+	delete context;
+	slot.state.store(((generation + 1) & generationMask) << 32);
+	-- filesCount;
+
+	std::lock_guard<std::mutex> freeSlotsLocker(freeSlotsMutex);
+	freeSlots.push_back(index);
+	return true;
+}
+
+AVDescriptorTable::Handle AVDescriptorTable::acquire(int descriptor) {
+	if(descriptor < 0) {
+		return Handle();
+	}
+	int index = descriptor & (capacity - 1);
+	uint64_t generation = static_cast<uint64_t>(descriptor) >> indexBits;
+	Slot& slot = slots[index];
+	uint64_t state = slot.state.load();
+	do {
+		if(!(state & aliveBit) || (state >> 32) != generation) {
+			return Handle();
+		}
+	}while(!slot.state.compare_exchange_weak(state, state + 1));
+	return Handle(this, index, slot.context);
+}
+
+bool AVDescriptorTable::empty() {
+	return filesCount == 0;
+}
+
+void AVDescriptorTable::clear() {
+	std::unique_lock<std::mutex> freeSlotsLocker(freeSlotsMutex);
+	int usedSlots = unusedSlot;
+	freeSlotsLocker.unlock();
+	for(int index = 0; index < usedSlots; ++ index) {
+		uint64_t state = slots[index].state.load();
+		if(state & aliveBit) {
+			remove(static_cast<int>((state >> 32) << indexBits) | index);
+		}
+	}
+}
+
+std::vector<int> AVDescriptorTable::descriptors() {
+	std::unique_lock<std::mutex> freeSlotsLocker(freeSlotsMutex);
+	int usedSlots = unusedSlot;
+	freeSlotsLocker.unlock();
+	std::vector<int> result;
+	for(int index = 0; index < usedSlots; ++ index) {
+		uint64_t state = slots[index].state.load();
+		if(state & aliveBit) {
+			result.push_back(static_cast<int>((state >> 32) << indexBits) | index);
+		}
+	}
+	return result;
+}
+
+void AVDescriptorTable::release(int index) {
+	uint64_t state = slots[index].state.fetch_sub(1) - 1;
+	if(!(state & aliveBit) && (state & referencesMask) == 0 && removeWaiters > 0) {
+		std::lock_guard<std::mutex> releaseLocker(releaseMutex);
+		releaseCond.notify_all();
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef AVDESCRIPTORTABLE_H
+#define AVDESCRIPTORTABLE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class AVfileContext;
+
+//Slot array behind the AVffmpegWrapper file descriptors.
+//A descriptor holds the slot index and the slot generation, so a closed descriptor
+//never reaches a file opened later in the same slot. Calls pin the slot with a reference
+//count in the slot state word, close waits only for the calls pinning its own slot.
+//The generation has 19 bits next to the 12 index bits (4096 slots), the freed slots are reused
+//in the order they were closed, so a stale descriptor can only match again after 2^19 reopenings
+//of its slot, at least 2^19 times the number of free slots opens after it was closed.
+class AVDescriptorTable {
+	public:
+		class Handle {
+			public:
+				Handle() = default;
+				Handle(Handle&& other);
+				Handle(const Handle&) = delete;
+				Handle& operator = (const Handle&) = delete;
+				~Handle();
+				AVfileContext* operator -> () {return context;}
+				explicit operator bool () const {return context != nullptr;}
+
+			private:
+				AVDescriptorTable* table = nullptr;
+				int index = -1;
+				AVfileContext* context = nullptr;
+
+				Handle(AVDescriptorTable* table, int index, AVfileContext* context);
+				friend class AVDescriptorTable;
+		};
+
+		static const int indexBits = 12;
+		static const int capacity = 1 << indexBits;
+
+		AVDescriptorTable();
+		AVDescriptorTable(const AVDescriptorTable&) = delete;
+		AVDescriptorTable& operator = (const AVDescriptorTable&) = delete;
+		~AVDescriptorTable();
+		int insert(AVfileContext* context); //takes the ownership, -1 when all slots are used
+		bool remove(int descriptor); //closes and deletes the file after the running calls left it
+		Handle acquire(int descriptor);
+		bool empty();
+		void clear();
+		std::vector<int> descriptors(); //the open files, any of them can be closed right after
+
+	private:
+		static const uint64_t referencesMask = 0x7fffffff;
+		static const uint64_t aliveBit = 0x80000000;
+		static const uint32_t generationMask = (1u << (31 - indexBits)) - 1;
+
+		struct Slot {
+			std::atomic<uint64_t> state = {0}; //generation << 32 | aliveBit | references
+			AVfileContext* context = nullptr;
+		};
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<int> filesCount = {0};
+
+		std::mutex freeSlotsMutex;
+		std::deque<int> freeSlots; //first in, first out
+		int unusedSlot = 0;
+
+		std::mutex releaseMutex;
+		std::condition_variable releaseCond;
+		std::atomic<unsigned int> removeWaiters = {0};
+
+		void release(int index);
+};
+
+#endif // AVDESCRIPTORTABLE_H
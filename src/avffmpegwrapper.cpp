@@ -1,287 +1,467 @@
 #include "avffmpegwrapper.h"
 
 AVffmpegWrapper::AVffmpegWrapper() {
-	threadCounterDecrement = [&](int*) {
-		-- threadCounter;
-	};
 }
 
 AVffmpegWrapper::~AVffmpegWrapper() {
+	stopStatsDump();
 	std::lock_guard<std::mutex> locker(avFileMutex);
-	while(threadCounter != 0) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
-	}
 	avFiles.clear();
 }
 
-int AVffmpegWrapper::openFile(const std::string& path, AVfileContext::PlayingMode playingMode, int streamType) {
+bool AVffmpegWrapper::enableDecodingPool(unsigned int threadsCount) {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(decodingPool || !avFiles.empty()) {
+		return false;
+	}
+	decodingPool.reset(new AVDecodingPool(threadsCount));
+	return true;
+}
+
+bool AVffmpegWrapper::enableIOReactor(unsigned int threadsCount) {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(ioReactor || !avFiles.empty() || !AVIOReactor::isSupported()) {
+		return false;
+	}
+	ioReactor.reset(new AVIOReactor(threadsCount));
+	return true;
+}
+
+std::vector<AVIOReactor::ThreadStats> AVffmpegWrapper::getIOReactorStats() {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(!ioReactor) {
+		return std::vector<AVIOReactor::ThreadStats>();
+	}
+	return ioReactor->getStats();
+}
+
+bool AVffmpegWrapper::enableProbeCache(const std::string& cacheFile) {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(probeCache || !avFiles.empty()) {
+		return false;
+	}
+	probeCache.reset(new AVProbeCache(cacheFile));
+	return true;
+}
+
+AVProbeCache::Stats AVffmpegWrapper::getProbeCacheStats() {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(!probeCache) {
+		return AVProbeCache::Stats();
+	}
+	return probeCache->getStats();
+}
+
+bool AVffmpegWrapper::saveProbeCache() {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(!probeCache) {
+		return false;
+	}
+	return probeCache->save();
+}
+
+bool AVffmpegWrapper::enableMemoryBudget(size_t limitBytes) {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(memoryBudget || !avFiles.empty()) {
+		return false;
+	}
+	memoryBudget.reset(new AVMemoryBudget(limitBytes));
+	return true;
+}
+
+AVMemoryBudget::Stats AVffmpegWrapper::getMemoryBudgetStats() {
 	std::lock_guard<std::mutex> locker(avFileMutex);
-	while(threadCounter != 0) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	if(!memoryBudget) {
+		return AVMemoryBudget::Stats();
 	}
+	return memoryBudget->getStats();
+}
+
+std::vector<AVThumbnailer::Sheet> AVffmpegWrapper::extractSpriteSheets(const std::vector<std::string>& paths, const AVThumbnailer::SheetLayout& layout,
+																	 unsigned int threadsCount) {
+	AVThumbnailer thumbnailer(threadsCount);
+	std::unique_lock<std::mutex> locker(avFileMutex);
+	thumbnailer.setProbeCache(probeCache.get());
+	locker.unlock(); //the cache lives as long as the wrapper
+	return thumbnailer.extract(paths, layout);
+}
+
+int AVffmpegWrapper::openFile(const std::string& path, AVfileContext::PlayingMode playingMode, int streamType,
+							  AVfileContext::DecoderThreading videoThreading, AVfileContext::DecoderThreading audioThreading) {
+	std::lock_guard<std::mutex> locker(avFileMutex);
 	int fileDescriptor = -1;
 	std::unique_ptr<AVfileContext, std::function<void(AVfileContext*)>> fileContext(new AVfileContext, [](AVfileContext* fCtx) {
 																						fCtx->closeFile();
 																						delete fCtx;
 																					});
-	if(fileContext->openFile(path, playingMode, streamType)) {
-		fileDescriptor = findEmptyDescriptor();
-		avFiles.insert(std::make_pair(static_cast<unsigned int>(fileDescriptor), std::move(fileContext)));
+	fileContext->setDecodingPool(decodingPool.get());
+	fileContext->setIOReactor(ioReactor.get());
+	fileContext->setProbeCache(probeCache.get());
+	fileContext->setMemoryBudget(memoryBudget.get());
+	if(fileContext->openFile(path, playingMode, streamType, videoThreading, audioThreading)) {
+		fileDescriptor = avFiles.insert(fileContext.get());
+		if(fileDescriptor >= 0) {
+			fileContext.release();
+		}
 	}
 
 	return fileDescriptor;
 }
 
 void AVffmpegWrapper::closeFile(int fileDescriptor) {
-	std::lock_guard<std::mutex> locker(avFileMutex);
-	while(threadCounter != 0) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
-	}
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		avFiles.erase(fileDescriptor); //Deleter will invoke ptr->closeFile()
-	}
+	avFiles.remove(fileDescriptor); //waits for the calls still using the descriptor, then closes the file
 }
 
 int AVffmpegWrapper::getSourceVideoWidth(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	int result = -1;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		int width = avFiles[fileDescriptor]->getSourceVideoWidth();
+	if(fileContext) {
+		int width = fileContext->getSourceVideoWidth();
 		result = width;
 	}
 	return result;
 }
 
 int AVffmpegWrapper::getSourceVideoHeigth(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	int result = -1;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		int heigh = avFiles[fileDescriptor]->getSourceVideoHeigth();
+	if(fileContext) {
+		int heigh = fileContext->getSourceVideoHeigth();
 		result = heigh;
 	}
 	return result;
 }
 
 int AVffmpegWrapper::getDestinationWidth(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	int result = -1;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->getDestinationWidth();
+	if(fileContext) {
+		return fileContext->getDestinationWidth();
 	}
 	return result;
 }
 
 int AVffmpegWrapper::getDestinationHeigth(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	int result = -1;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->getDestinationHeigth();
+	if(fileContext) {
+		return fileContext->getDestinationHeigth();
 	}
 	return result;
 }
 
-bool AVffmpegWrapper::setVideoConvertingParameters(int fileDescriptor, AVPixelFormat dstFormat, int flags, int dstW, int dstH) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+bool AVffmpegWrapper::setVideoConvertingParameters(int fileDescriptor, AVPixelFormat dstFormat, int flags, int dstW, int dstH, int slices) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	bool result = false;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		if(avFiles[fileDescriptor]->setVideoConvertingParameters(dstFormat, flags, dstW, dstH)) {
+	if(fileContext) {
+		if(fileContext->setVideoConvertingParameters(dstFormat, flags, dstW, dstH, slices)) {
 			result = true;
 		}
 	}
 	return result;
 }
 
+bool AVffmpegWrapper::setVideoTensorOutput(int fileDescriptor, AVTensorConverter::Type type, const AVTensorConverter::Normalization& normalization, int flags,
+										   int dstW, int dstH, int slices) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->setVideoTensorOutput(type, normalization, flags, dstW, dstH, slices);
+	}else {
+		return false;
+	}
+}
+
 bool AVffmpegWrapper::setAudioConvertingParameters(int fileDescriptor, AVSampleFormat destSampleFormat, int64_t destChLayuot, int destSampleRate) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	bool result = false;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		if(avFiles[fileDescriptor]->setAudioConvertingParameters(destSampleFormat, destChLayuot, destSampleRate)) {
+	if(fileContext) {
+		if(fileContext->setAudioConvertingParameters(destSampleFormat, destChLayuot, destSampleRate)) {
 			result = true;
 		}
 	}
 	return result;
 }
 
+bool AVffmpegWrapper::setBufferDepth(int fileDescriptor, unsigned int packetsMs, unsigned int framesMs) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		fileContext->setBufferDepth(packetsMs, framesMs);
+		return true;
+	}else {
+		return false;
+	}
+}
+
 void AVffmpegWrapper::setPlayingMode(int fileDescriptor, AVfileContext::PlayingMode newPlayingMode) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		avFiles[fileDescriptor]->setPlayingMode(newPlayingMode);
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		fileContext->setPlayingMode(newPlayingMode);
 	}
 }
 
 void AVffmpegWrapper::setAudioCallback(int fileDescriptor, std::function<void(uint8_t*, uint32_t, int&)> audioCallback, int32_t audioSamplesNum) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		avFiles[fileDescriptor]->setAudioCallback(audioCallback, audioSamplesNum);
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		fileContext->setAudioCallback(audioCallback, audioSamplesNum);
 	}
 }
 
 bool AVffmpegWrapper::startReading(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
 	bool result = false;
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		if(avFiles[fileDescriptor]->startReading()) {
+	if(fileContext) {
+		if(fileContext->startReading()) {
 			result = true;
 		}
 	}
 	return result;
 }
 
+bool AVffmpegWrapper::seek(int fileDescriptor, double timestamp, AVfileContext::SeekMode mode) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->seek(timestamp, mode);
+	}else {
+		return false;
+	}
+}
+
+bool AVffmpegWrapper::startRecording(int fileDescriptor, const AVRecorder::Parameters& parameters) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->startRecording(parameters);
+	}else {
+		return false;
+	}
+}
+
+void AVffmpegWrapper::stopRecording(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		fileContext->stopRecording();
+	}
+}
+
+AVRecorder::Stats AVffmpegWrapper::getRecordingStats(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getRecordingStats();
+	}else {
+		return AVRecorder::Stats();
+	}
+}
+
 bool AVffmpegWrapper::isReading(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->isReading();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->isReading();
 	}
 	return false;
 }
 
 bool AVffmpegWrapper::isDecodingVideo(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->isDecodingVideo();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->isDecodingVideo();
 	}
 	return false;
 }
 
 bool AVffmpegWrapper::isDecodingAudio(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->isDecodingAudio();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->isDecodingAudio();
 	}
 	return false;
 }
 
 bool AVffmpegWrapper::hasVideoFrame(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->hasVideoFrame();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->hasVideoFrame();
 	}
 	return false;
 }
 
 uint64_t AVffmpegWrapper::availableAudioData(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->availableAudioData();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->availableAudioData();
 	}
 	return false;
 }
 
 bool AVffmpegWrapper::endOfFile(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->endOfFile();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->endOfFile();
 	}
 	return false;
 }
 
 bool AVffmpegWrapper::getVideoData(int fileDescriptor, uint8_t** data, int* dataSize) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->getVideoData(&data[0], &dataSize[0]);
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getVideoData(&data[0], &dataSize[0]);
 	}else {
 		return false;
 	}
 }
 
 bool AVffmpegWrapper::getVideoData(int fileDescriptor, uint8_t* data, int dataSize) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->getVideoData(&data[0], dataSize);
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getVideoData(&data[0], dataSize);
 	}else {
 		return false;
 	}
 }
 
-uint32_t AVffmpegWrapper::getAudioData(int fileDescriptor, uint8_t* targetBuffet, uint32_t dataSize) {
+VideoFrameRef AVffmpegWrapper::borrowVideoData(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->borrowVideoData();
+	}else {
+		return nullptr;
+	}
+}
+
+int AVffmpegWrapper::borrowVideoBatch(int fileDescriptor, VideoFrameRef* frames, int maxFrames, double* pts) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->borrowVideoBatch(frames, maxFrames, pts);
+	}else {
+		return 0;
+	}
+}
+
+int AVffmpegWrapper::getVideoBatch(int fileDescriptor, uint8_t* data, int dataSize, int maxFrames, double* pts) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getVideoBatch(data, dataSize, maxFrames, pts);
+	}else {
+		return 0;
+	}
+}
+
+uint64_t AVffmpegWrapper::getDroppedVideoFrames(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getDroppedVideoFrames();
+	}else {
+		return 0;
+	}
+}
+
+AVFramePool::Stats AVffmpegWrapper::getVideoFramePoolStats(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getVideoFramePoolStats();
+	}else {
+		return AVFramePool::Stats();
+	}
+}
+
+AVAudioScheduler::JitterStats AVffmpegWrapper::getAudioJitterStats(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getAudioJitterStats();
+	}else {
+		return AVAudioScheduler::JitterStats();
+	}
+}
+
+AVfileContext::Stats AVffmpegWrapper::getStats(int fileDescriptor) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getStats();
+	}else {
+		return AVfileContext::Stats();
+	}
+}
+
+AVfileContext::Stats AVffmpegWrapper::getTotalStats() {
+	AVfileContext::Stats total;
+	for(int fileDescriptor : avFiles.descriptors()) {
+		AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+		if(fileContext) {
+			total += fileContext->getStats();
+		}
+	}
+	return total;
+}
+
+bool AVffmpegWrapper::startStatsDump(unsigned int periodMs, std::function<void(int, const AVfileContext::Stats&)> dump) {
+	std::lock_guard<std::mutex> locker(avFileMutex);
+	if(statsDumpThread.joinable() || dump == nullptr || periodMs == 0) {
+		return false;
+	}
+	std::lock_guard<std::mutex> dumpLocker(statsDumpMutex);
+	statsDumpThread = std::thread(&AVffmpegWrapper::statsDumping, this, periodMs, statsDumpGeneration, dump);
+	return true;
+}
+
+void AVffmpegWrapper::stopStatsDump() {
 	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
+	if(!statsDumpThread.joinable()) {
+		return;
+	}
+	std::thread dumpThread(std::move(statsDumpThread));
+	std::unique_lock<std::mutex> dumpLocker(statsDumpMutex);
+	++ statsDumpGeneration;
+	statsDumpCond.notify_all();
+	dumpLocker.unlock();
 	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->getAudioData(&targetBuffet[0], dataSize);
+	dumpThread.join(); //not under avFileMutex, the dump callback may call the wrapper
+}
+
+void AVffmpegWrapper::statsDumping(unsigned int periodMs, unsigned int generation, std::function<void(int, const AVfileContext::Stats&)> dump) {
+	std::unique_lock<std::mutex> dumpLocker(statsDumpMutex);
+	while(!statsDumpCond.wait_for(dumpLocker, std::chrono::milliseconds(periodMs), [&](){return statsDumpGeneration != generation;})) {
+		dumpLocker.unlock();
+		AVfileContext::Stats total;
+		for(int fileDescriptor : avFiles.descriptors()) {
+			AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+			if(fileContext) {
+				AVfileContext::Stats stats = fileContext->getStats();
+				dump(fileDescriptor, stats);
+				total += stats;
+			}
+		}
+		dump(-1, total);
+		dumpLocker.lock();
+	}
+}
+
+uint32_t AVffmpegWrapper::getAudioData(int fileDescriptor, uint8_t* targetBuffet, uint32_t dataSize) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->getAudioData(&targetBuffet[0], dataSize);
 	}else {
 		return 0;
 	}
 }
 
+uint32_t AVffmpegWrapper::peekAudioData(int fileDescriptor, const uint8_t** data) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->peekAudioData(data);
+	}else {
+		return 0;
+	}
+}
+
+void AVffmpegWrapper::consumeAudioData(int fileDescriptor, uint32_t dataSize) {
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		fileContext->consumeAudioData(dataSize);
+	}
+}
+
 int AVffmpegWrapper::audioSampleRate(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		int sampleRate = avFiles[fileDescriptor]->audioSampleRate();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		int sampleRate = fileContext->audioSampleRate();
 		if(sampleRate < 0) {
 			return -1;
 		}
@@ -291,13 +471,9 @@ int AVffmpegWrapper::audioSampleRate(int fileDescriptor) {
 }
 
 int AVffmpegWrapper::audioChannels(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		int channels = avFiles[fileDescriptor]->audioChannels();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		int channels = fileContext->audioChannels();
 		if(channels < 0) {
 			return -1;
 		}
@@ -307,34 +483,17 @@ int AVffmpegWrapper::audioChannels(int fileDescriptor) {
 }
 
 bool AVffmpegWrapper::hasVideoStream(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->hasVideoStream();
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->hasVideoStream();
 	}
 	return -1;
 }
 
 bool AVffmpegWrapper::hasAudioStream(int fileDescriptor) {
-	std::unique_lock<std::mutex> locker(avFileMutex);
-	int temp = 0;
-	++ threadCounter;
-	std::unique_ptr<int, decltype(threadCounterDecrement)> decrementer(&temp, threadCounterDecrement);
-	locker.unlock();
-	if(avFiles.find(fileDescriptor) != avFiles.end()) {
-		return avFiles[fileDescriptor]->hasAudioStream();
-	}
-	return -1;
-}
-
-int AVffmpegWrapper::findEmptyDescriptor() {
-	for(int fileDescriptor = 0; fileDescriptor < std::numeric_limits<int>::max(); ++ fileDescriptor) {
-		if(avFiles.find(fileDescriptor) == avFiles.end()) {
-			return fileDescriptor;
-		}
+	AVDescriptorTable::Handle fileContext = avFiles.acquire(fileDescriptor);
+	if(fileContext) {
+		return fileContext->hasAudioStream();
 	}
 	return -1;
 }
@@ -2,25 +2,49 @@
 #define AVFFMPEGWRAPPER_H
 
 #include "avfilecontext.h"
+#include "avdescriptortable.h"
+#include "avthumbnailer.h"
 
 #include <unordered_map>
 #include <atomic>
+#include <condition_variable>
+#include <thread>
 
 class AVffmpegWrapper {
 	public:
 		AVffmpegWrapper();
 		~AVffmpegWrapper();
-		int openFile(const std::string& path, AVfileContext::PlayingMode playingMode, int streamType);
+		bool enableDecodingPool(unsigned int threadsCount = 0); //before the first openFile, 0 means one thread per core
+		bool enableIOReactor(unsigned int threadsCount = 1); //before the first openFile, demuxes tcp/http inputs opened in NORMAL mode
+		std::vector<AVIOReactor::ThreadStats> getIOReactorStats();
+		bool enableProbeCache(const std::string& cacheFile = ""); //before the first openFile, an empty name keeps it in memory only
+		AVProbeCache::Stats getProbeCacheStats();
+		bool saveProbeCache();
+		bool enableMemoryBudget(size_t limitBytes); //before the first openFile, caps the frame rings of all files together
+		AVMemoryBudget::Stats getMemoryBudgetStats();
+		std::vector<AVThumbnailer::Sheet> extractSpriteSheets(const std::vector<std::string>& paths, const AVThumbnailer::SheetLayout& layout,
+															  unsigned int threadsCount = 0); //independent of the opened files, uses the probe cache
+		int openFile(const std::string& path, AVfileContext::PlayingMode playingMode, int streamType,
+					 AVfileContext::DecoderThreading videoThreading = AVfileContext::DecoderThreading(4),
+					 AVfileContext::DecoderThreading audioThreading = AVfileContext::DecoderThreading(1));
 		void closeFile(int fileDescriptor);
 		int getSourceVideoWidth(int fileDescriptor);
 		int getSourceVideoHeigth(int fileDescriptor);
 		int getDestinationWidth(int fileDescriptor);
 		int getDestinationHeigth(int fileDescriptor);
-		bool setVideoConvertingParameters(int fileDescriptor, enum AVPixelFormat dstFormat, int flags, int dstW = -1, int dstH = -1);
+		bool setVideoConvertingParameters(int fileDescriptor, enum AVPixelFormat dstFormat, int flags, int dstW = -1, int dstH = -1, int slices = 1);
+		bool setVideoTensorOutput(int fileDescriptor, AVTensorConverter::Type type, const AVTensorConverter::Normalization& normalization, int flags,
+								  int dstW = -1, int dstH = -1, int slices = 1);
 		bool setAudioConvertingParameters(int fileDescriptor, AVSampleFormat destSampleFormat, int64_t destChLayuot = -1, int destSampleRate = -1);
+		bool setBufferDepth(int fileDescriptor, unsigned int packetsMs, unsigned int framesMs); //before startReading, 0 keeps the default slot counts
 		void setPlayingMode(int fileDescriptor, AVfileContext::PlayingMode newPlayingMode);
 		void setAudioCallback(int fileDescriptor, std::function<void(uint8_t*, uint32_t, int&)> audioCallback, int32_t audioSamplesNum);
 		bool startReading(int fileDescriptor);
+		bool seek(int fileDescriptor, double timestamp, AVfileContext::SeekMode mode = AVfileContext::SEEK_EXACT);
+		//also for files opened in RECORD mode, which read without decoding, see AVfileContext::startRecording
+		bool startRecording(int fileDescriptor, const AVRecorder::Parameters& parameters);
+		void stopRecording(int fileDescriptor);
+		AVRecorder::Stats getRecordingStats(int fileDescriptor);
 		bool isReading(int fileDescriptor);
 		bool isDecodingVideo(int fileDescriptor);
 		bool isDecodingAudio(int fileDescriptor);
@@ -29,18 +53,38 @@ class AVffmpegWrapper {
 		bool endOfFile(int fileDescriptor);
 		bool getVideoData(int fileDescriptor, uint8_t** data, int* dataSize);
 		bool getVideoData(int fileDescriptor, uint8_t* data, int dataSize);
+		VideoFrameRef borrowVideoData(int fileDescriptor);
+		int borrowVideoBatch(int fileDescriptor, VideoFrameRef* frames, int maxFrames, double* pts = nullptr);
+		int getVideoBatch(int fileDescriptor, uint8_t* data, int dataSize, int maxFrames, double* pts = nullptr);
+		uint64_t getDroppedVideoFrames(int fileDescriptor);
+		AVFramePool::Stats getVideoFramePoolStats(int fileDescriptor);
+		AVAudioScheduler::JitterStats getAudioJitterStats(int fileDescriptor);
+		AVfileContext::Stats getStats(int fileDescriptor);
+		AVfileContext::Stats getTotalStats(); //the sum over the open files
+		//every periodMs calls dump from its own thread for each open file, then with -1 for the total
+		bool startStatsDump(unsigned int periodMs, std::function<void(int fileDescriptor, const AVfileContext::Stats& stats)> dump);
+		void stopStatsDump();
 		uint32_t getAudioData(int fileDescriptor, uint8_t* targetBuffet, uint32_t dataSize);
+		uint32_t peekAudioData(int fileDescriptor, const uint8_t** data); //see AVfileContext::peekAudioData
+		void consumeAudioData(int fileDescriptor, uint32_t dataSize);
 		int audioSampleRate(int fileDescriptor);
 		int audioChannels(int fileDescriptor);
 		bool hasVideoStream(int fileDescriptor);
 		bool hasAudioStream(int fileDescriptor);
 	private:
-		std::unordered_map<int, std::unique_ptr<AVfileContext, std::function<void(AVfileContext*)>>> avFiles;
+		std::unique_ptr<AVDecodingPool> decodingPool;
+		std::unique_ptr<AVIOReactor> ioReactor;
+		std::unique_ptr<AVProbeCache> probeCache;
+		std::unique_ptr<AVMemoryBudget> memoryBudget;
+		AVDescriptorTable avFiles;
 		std::mutex avFileMutex;
-		std::atomic<unsigned int> threadCounter = {0};
-		std::function<void(int*)> threadCounterDecrement = nullptr;
 
-		int findEmptyDescriptor();
+		std::thread statsDumpThread;
+		std::mutex statsDumpMutex;
+		std::condition_variable statsDumpCond;
+		unsigned int statsDumpGeneration = 0; //stopStatsDump moves on to the next one, the thread started for another one ends
+
+		void statsDumping(unsigned int periodMs, unsigned int generation, std::function<void(int, const AVfileContext::Stats&)> dump);
 };
 
 #endif // AVFFMPEGWRAPPER_H
@@ -0,0 +1,176 @@
+#include "avfiber.h"
+
+#ifdef __linux__
+	#include <sys/mman.h>
+	#include <ucontext.h>
+	#include <unistd.h>
+	#define AVFIBER_UCONTEXT
+#endif
+
+//the sanitizers have to be told about every stack switch
+#if defined(__has_feature)
+	#if __has_feature(address_sanitizer)
+		#define AVFIBER_ASAN
+	#endif
+	#if __has_feature(thread_sanitizer)
+		#define AVFIBER_TSAN
+	#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) && !defined(AVFIBER_ASAN)
+	#define AVFIBER_ASAN
+#endif
+#if defined(__SANITIZE_THREAD__) && !defined(AVFIBER_TSAN)
+	#define AVFIBER_TSAN
+#endif
+#ifdef AVFIBER_ASAN
+	#include <sanitizer/common_interface_defs.h>
+#endif
+#ifdef AVFIBER_TSAN
+	#include <sanitizer/tsan_interface.h>
+#endif
+
+struct AVFiber::Context {
+#ifdef AVFIBER_UCONTEXT
+	ucontext_t fiber;
+	ucontext_t caller;
+#endif
+	void* mapping = nullptr; //the stack with a guard page below it
+	size_t mappingSize = 0;
+#ifdef AVFIBER_ASAN
+	void* fakeStack = nullptr;
+	const void* callerBottom = nullptr;
+	size_t callerSize = 0;
+#endif
+#ifdef AVFIBER_TSAN
+	void* tsanFiber = nullptr;
+	void* tsanCaller = nullptr;
+#endif
+};
+
+namespace {
+
+thread_local AVFiber* runningFiber = nullptr;
+
+}
+
+AVFiber::AVFiber(std::function<void()> body, size_t stackSize):
+	body(std::move(body)),
+	context(new Context)
+{
+#ifdef AVFIBER_UCONTEXT
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	stackSize = (stackSize + pageSize - 1) / pageSize * pageSize;
+	void* mapping = mmap(nullptr, stackSize + pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if(mapping == MAP_FAILED) {
+		return;
+	}
+	if(mprotect(mapping, pageSize, PROT_NONE) != 0 || getcontext(&context->fiber) != 0) { //an overflow hits the guard page instead of the heap
+		munmap(mapping, stackSize + pageSize);
+		return;
+	}
+	context->mapping = mapping;
+	context->mappingSize = stackSize + pageSize;
+	context->fiber.uc_stack.ss_sp = static_cast<char*>(mapping) + pageSize;
+	context->fiber.uc_stack.ss_size = stackSize;
+	context->fiber.uc_link = nullptr;
+	makecontext(&context->fiber, &AVFiber::entry, 0);
+#ifdef AVFIBER_TSAN
+	context->tsanFiber = __tsan_create_fiber(0);
+#endif
+#else
+	(void)stackSize;
+#endif
+}
+
+AVFiber::~AVFiber() {
+#ifdef AVFIBER_UCONTEXT
+#ifdef AVFIBER_TSAN
+	if(context->tsanFiber) {
+		__tsan_destroy_fiber(context->tsanFiber);
+	}
+#endif
+	if(context->mapping) {
+		munmap(context->mapping, context->mappingSize);
+	}
+#endif
+}
+
+bool AVFiber::isSupported() {
+#ifdef AVFIBER_UCONTEXT
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool AVFiber::isValid() {
+	return context->mapping != nullptr;
+}
+
+bool AVFiber::resume() {
+	if(finished || !isValid()) {
+		return false;
+	}
+#ifdef AVFIBER_UCONTEXT
+	AVFiber* previous = runningFiber;
+	runningFiber = this;
+#ifdef AVFIBER_TSAN
+	context->tsanCaller = __tsan_get_current_fiber();
+	__tsan_switch_to_fiber(context->tsanFiber, 0);
+#endif
+#ifdef AVFIBER_ASAN
+	void* callerFakeStack = nullptr;
+	__sanitizer_start_switch_fiber(&callerFakeStack, context->fiber.uc_stack.ss_sp, context->fiber.uc_stack.ss_size);
+#endif
+	swapcontext(&context->caller, &context->fiber);
+#ifdef AVFIBER_ASAN
+	__sanitizer_finish_switch_fiber(callerFakeStack, nullptr, nullptr);
+#endif
+	runningFiber = previous;
+#endif
+	return !finished;
+}
+
+void AVFiber::yield() {
+#ifdef AVFIBER_UCONTEXT
+#ifdef AVFIBER_TSAN
+	__tsan_switch_to_fiber(context->tsanCaller, 0);
+#endif
+#ifdef AVFIBER_ASAN
+	__sanitizer_start_switch_fiber(&context->fakeStack, context->callerBottom, context->callerSize);
+#endif
+	swapcontext(&context->fiber, &context->caller);
+#ifdef AVFIBER_ASAN
+	__sanitizer_finish_switch_fiber(context->fakeStack, &context->callerBottom, &context->callerSize);
+#endif
+#endif
+}
+
+bool AVFiber::isFinished() {
+	return finished;
+}
+
+AVFiber* AVFiber::current() {
+	return runningFiber;
+}
+
+void AVFiber::entry() {
+#ifdef AVFIBER_UCONTEXT
+	AVFiber* fiber = runningFiber;
+#ifdef AVFIBER_ASAN
+	__sanitizer_finish_switch_fiber(nullptr, &fiber->context->callerBottom, &fiber->context->callerSize);
+#endif
+	try {
+		fiber->body();
+	}catch(...) { //nothing may unwind past the bottom of the fiber's stack
+	}
+	fiber->finished = true;
+#ifdef AVFIBER_TSAN
+	__tsan_switch_to_fiber(fiber->context->tsanCaller, 0);
+#endif
+#ifdef AVFIBER_ASAN
+	__sanitizer_start_switch_fiber(nullptr, fiber->context->callerBottom, fiber->context->callerSize);
+#endif
+	setcontext(&fiber->context->caller);
+#endif
+}
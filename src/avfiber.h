@@ -0,0 +1,36 @@
+#ifndef AVFIBER_H
+#define AVFIBER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+//Stackful coroutine for code that has to wait in the middle of a library call, like avformat reading through an AVIOContext callback.
+//resume() runs the body on the fiber's own stack until the body calls yield() or returns, yield() goes back to that resume().
+//One thread at a time resumes a fiber, and it is resumed until it finishes so the body can unwind.
+//The stack is reserved, not committed, only the pages the body touches take memory.
+class AVFiber {
+	public:
+		explicit AVFiber(std::function<void()> body, size_t stackSize = defaultStackSize);
+		AVFiber(const AVFiber&) = delete;
+		AVFiber& operator = (const AVFiber&) = delete;
+		~AVFiber(); //a fiber that has not finished is dropped without unwinding its body
+		static bool isSupported();
+		bool isValid(); //false when the stack couldn't be allocated
+		bool resume(); //false once the body has returned
+		void yield(); //only from the body
+		bool isFinished();
+		static AVFiber* current(); //the fiber running on the calling thread, nullptr outside of any
+
+	private:
+		static const size_t defaultStackSize = 512 * 1024;
+		struct Context;
+
+		std::function<void()> body;
+		std::unique_ptr<Context> context;
+		bool finished = false;
+
+		static void entry();
+};
+
+#endif // AVFIBER_H
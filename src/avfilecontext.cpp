@@ -1,10 +1,14 @@
 #include "avfilecontext.h"
 
+std::atomic<unsigned int> AVfileContext::decodingCoreBudget = {0};
+std::atomic<int> AVfileContext::autoThreadedDecoders = {0};
+
 AVfileContext::~AVfileContext() {
 	closeFile();
 }
 
-bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, int streamType) {
+bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, int streamType,
+							 DecoderThreading videoThreading, DecoderThreading audioThreading) {
 	std::unique_lock<std::mutex> lock(safeReplayMutex);
 	bool allRight = false;
 	if(avFormatContext || readingThreadIsRunning) {
@@ -13,7 +17,20 @@ bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, i
 	filePath = path;
 	this->playingMode = playingMode;
 	this->streamType = streamType;
-	if(playingMode == REPEATE_AND_RECONNECT) {
+	this->videoThreading = videoThreading;
+	this->audioThreading = audioThreading;
+	releaseThreadBudget();
+	forgetParameters();
+	resetKeyframeIndex();
+	if(playingMode != RECORD) {
+		budgetedDecoders = ((streamType & VIDEO) && videoThreading.threadCount == AUTO_THREADS ? 1 : 0)
+						 + ((streamType & AUDIO) && audioThreading.threadCount == AUTO_THREADS ? 1 : 0);
+	}
+	autoThreadedDecoders += budgetedDecoders;
+	videoDecoder.setLowLatency(playingMode == LOW_LATENCY);
+	audioDecoder.setLowLatency(playingMode == LOW_LATENCY);
+	videoDecoder.setPaced(playingMode != FREE_RUN);
+	if(playingMode != NORMAL && playingMode != FREE_RUN) {
 		readingThreadIsRunning = true;
 		readingThreadIsStopping = false;
 		lock.unlock();
@@ -24,6 +41,7 @@ bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, i
 	AVDictionary *stream_opts = nullptr;
 	av_dict_set(&stream_opts, "rtsp_flags", "prefer_tcp", 0);
 	av_dict_set(&stream_opts, "stimeout", "10000000", 0); // in microseconds
+	setStreamOptions(&stream_opts);
 	if(stream_opts == nullptr) {
 		return false;
 	}
@@ -36,17 +54,24 @@ bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, i
 			videoStreamId = -1;
 			audioStreamId = -1;
 			if(avFormatContext) {avformat_close_input(&avFormatContext); avFormatContext = nullptr;}
+			closeSocketSource();
+			releaseThreadBudget();
 		}
 		if(stream_opts) {av_dict_free(&stream_opts);}
 	};
 	std::unique_ptr<int, decltype(deleter)> allCloser(&temp, deleter);
 
+	if(ioReactor && AVSocketSource::canOpen(filePath)) {
+		if(!openSocketSource()) {
+			return false;
+		}
+	}
 
 	if(avformat_open_input(&avFormatContext, filePath.c_str(), nullptr, &stream_opts) != 0) {
 		return false;
 	}
 
-	if(avformat_find_stream_info(avFormatContext, nullptr) < 0) {
+	if(!findStreamInfo(avFormatContext)) {
 		return false;
 	}
 
@@ -58,21 +83,12 @@ bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, i
 			videoStreamId = ret;
 			AVStream* vstrm = avFormatContext->streams[videoStreamId];
 
-			AVCodecContext* videoCodecContext = avcodec_alloc_context3(nullptr);
+			AVCodecContext* videoCodecContext = openCodecContext(vstrm, avcodec, videoThreading);
 			if(videoCodecContext == nullptr) {
 				return false;
 			}
-			if(avcodec_parameters_to_context(videoCodecContext, vstrm->codecpar) < 0) {
-				avcodec_free_context(&videoCodecContext);
-				return false;
-			}
-			videoCodecContext->thread_count = 4;
-			if(avcodec_open2(videoCodecContext, avcodec, nullptr) < 0) {
-				avcodec_free_context(&videoCodecContext);
-				return false;
-			}
-			videoDecoder.init();
 			videoDecoder.setStreamAndCodecContext(vstrm, videoCodecContext);
+			rememberParameters(&videoParameters, vstrm->codecpar);
 		}
 	}
 
@@ -83,46 +99,82 @@ bool AVfileContext::openFile(const std::string& path, PlayingMode playingMode, i
 		if(ret >= 0) {
 			audioStreamId = ret;
 			AVStream* vstrm = avFormatContext->streams[audioStreamId];
-			AVCodecContext* audioCodecContext = avcodec_alloc_context3(nullptr);
+			AVCodecContext* audioCodecContext = openCodecContext(vstrm, avcodec, audioThreading);
 			if(audioCodecContext == nullptr) {
 				return false;
 			}
-			if(avcodec_parameters_to_context(audioCodecContext, vstrm->codecpar) < 0) {
-				avcodec_free_context(&audioCodecContext);
-				return false;
-			}
-			if(avcodec_open2(audioCodecContext, avcodec, nullptr) < 0) {
-				avcodec_free_context(&audioCodecContext);
-				return false;
-			}
-			audioDecoder.init();
 			audioDecoder.setStreamAndCodecContext(vstrm, audioCodecContext);
+			rememberParameters(&audioParameters, vstrm->codecpar);
 			if(audioCallback != nullptr) {
-				audioPlayingThreadIsRunning = true;
-				audioPlayingThreadIsStopping = false;
-				audioPlayingThread = std::thread(&AVfileContext::audioPlaying, this);
+				startAudioPlaying();
 			}
 		}
 	}
+	recorder.setStreams(videoStreamId >= 0 ? avFormatContext->streams[videoStreamId] : nullptr,
+						audioStreamId >= 0 ? avFormatContext->streams[audioStreamId] : nullptr);
 	allRight = true;
 	return true;
 }
 
-void AVfileContext::closeFile() {
+bool AVfileContext::setDecodingPool(AVDecodingPool* pool) {
 	std::lock_guard<std::mutex> lock(safeReplayMutex);
-	if(audioPlayingThreadIsRunning) {
-		audioPlayingThreadIsStopping = true;
-		if(audioPlayingThread.joinable()) {
-			audioPlayingThread.join();
-		}
+	if(avFormatContext || readingThreadIsRunning) {
+		return false;
+	}
+	return videoDecoder.setDecodingPool(pool) && audioDecoder.setDecodingPool(pool);
+}
+
+bool AVfileContext::setIOReactor(AVIOReactor* reactor) {
+	std::lock_guard<std::mutex> lock(safeReplayMutex);
+	if(avFormatContext || readingThreadIsRunning) {
+		return false;
+	}
+	ioReactor = reactor;
+	return true;
+}
+
+bool AVfileContext::setProbeCache(AVProbeCache* cache) {
+	std::lock_guard<std::mutex> lock(safeReplayMutex);
+	if(avFormatContext || readingThreadIsRunning) {
+		return false;
+	}
+	probeCache = cache;
+	return true;
+}
+
+bool AVfileContext::setMemoryBudget(AVMemoryBudget* budget) {
+	std::lock_guard<std::mutex> lock(safeReplayMutex);
+	if(avFormatContext || readingThreadIsRunning) {
+		return false;
 	}
+	return videoDecoder.setMemoryBudget(budget) && audioDecoder.setMemoryBudget(budget);
+}
+
+void AVfileContext::setBufferDepth(unsigned int packetsMs, unsigned int framesMs) {
+	videoDecoder.setBufferDepth(packetsMs, framesMs);
+	audioDecoder.setBufferDepth(packetsMs, framesMs);
+}
+
+void AVfileContext::closeFile() {
+	std::lock_guard<std::mutex> lock(safeReplayMutex);
+	stopAudioPlaying();
 	videoDecoder.stop();
 	audioDecoder.stop();
 	stopReading();
+	recorder.stop(); //the last segment gets its trailer
+	recorder.setStreams(nullptr, nullptr);
 	if(avFormatContext) {
 		avformat_close_input(&avFormatContext);
 		avFormatContext = nullptr;
 	}
+	closeSocketSource();
+	releaseThreadBudget();
+	forgetParameters();
+	resetKeyframeIndex();
+}
+
+void AVfileContext::setDecodingCoreBudget(unsigned int cores) {
+	decodingCoreBudget = cores;
 }
 
 int AVfileContext::getSourceVideoWidth() {
@@ -141,49 +193,53 @@ int AVfileContext::getDestinationHeigth() {
 	return videoDecoder.getDestinationHeigth();
 }
 
-bool AVfileContext::setVideoConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW, int dstH) {
-	return videoDecoder.setConvertingParameters(dstFormat, flags, dstW, dstH);
+bool AVfileContext::setVideoConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW, int dstH, int slices) {
+	return videoDecoder.setConvertingParameters(dstFormat, flags, dstW, dstH, slices);
+}
+
+bool AVfileContext::setVideoTensorOutput(AVTensorConverter::Type type, const AVTensorConverter::Normalization& normalization, int flags,
+										 int dstW, int dstH, int slices) {
+	return videoDecoder.setTensorOutput(type, normalization, flags, dstW, dstH, slices);
 }
 
 bool AVfileContext::setAudioConvertingParameters(AVSampleFormat destSampleFormat, int64_t destChLayuot, int destSampleRate) {
+	bool wasPlaying = audioPlayingIsRunning;
+	if(wasPlaying) { //its peeked samples must not move under the callback
+		stopAudioPlaying();
+	}
 	bool result = audioDecoder.setConvertingParameters(destSampleFormat, destChLayuot, destSampleRate);
-	if(result) {
-		if(audioPlayingThreadIsRunning) {
-			audioPlayingThreadIsStopping = true;
-			if(audioPlayingThread.joinable()) {
-				audioPlayingThread.join();
-			}
-			std::lock_guard<std::mutex> lock(safeAudioCallbackMutex);
-			if(audioCallback != nullptr) {
-				audioPlayingThreadIsRunning = true;
-				audioPlayingThreadIsStopping = false;
-				audioPlayingThread = std::thread(&AVfileContext::audioPlaying, this);
-			}
+	if(wasPlaying) {
+		std::lock_guard<std::mutex> lock(safeAudioCallbackMutex);
+		if(audioCallback != nullptr) {
+			startAudioPlaying();
 		}
 	}
 	return result;
 }
 
 void AVfileContext::setPlayingMode(AVfileContext::PlayingMode newPlayingMode) {
+	if(playingMode == RECORD || newPlayingMode == RECORD) { //the decoders are opened or not by openFile
+		return;
+	}
 	playingMode = newPlayingMode;
+	videoDecoder.setLowLatency(playingMode == LOW_LATENCY);
+	audioDecoder.setLowLatency(playingMode == LOW_LATENCY);
+	videoDecoder.setPaced(playingMode != FREE_RUN);
 }
 
 void AVfileContext::setAudioCallback(std::function<void(uint8_t*, uint32_t, int&)> audioCallback, int32_t audioSamplesNum) {
 	std::lock_guard<std::mutex> lock(safeReplayMutex);
-	if(!audioPlayingThreadIsRunning) {
+	if(!audioPlayingIsRunning) {
 		if(audioCallback != nullptr) {
 			this->audioCallback = audioCallback;
 			this->audioSamplesNum = audioSamplesNum;
 			if(audioDecoder.isReady()) {
-				audioPlayingThreadIsRunning = true;
-				audioPlayingThreadIsStopping = false;
-				audioPlayingThread = std::thread(&AVfileContext::audioPlaying, this);
+				startAudioPlaying();
 			}
 		}
 	}else {
 		if(audioCallback == nullptr) {
-			audioPlayingThreadIsStopping = true;
-			audioPlayingThread.join();
+			stopAudioPlaying();
 		}else {
 			std::lock_guard<std::mutex> lock(safeAudioCallbackMutex);
 			this->audioCallback = audioCallback;
@@ -216,17 +272,136 @@ bool AVfileContext::startReading() {
 	}
 	readingThreadIsRunning = true;
 	readingThreadIsStopping = false;
+	if(socketSource && AVFiber::isSupported()) {
+		reactorPacket = av_packet_alloc();
+		blockedDecoder = nullptr;
+		demuxFiber.reset(new AVFiber([this]() {demuxByReactor();}));
+		readingByReactor = reactorPacket && demuxFiber->isValid() && ioReactor->addStream(this);
+		if(readingByReactor) {
+			return true;
+		}
+		demuxFiber.reset();
+		av_packet_free(&reactorPacket); //the reading thread works with the socket source as well
+	}
 	readingThread = std::thread(&AVfileContext::reading, this);
 	return true;
 }
 
+bool AVfileContext::seek(double timestamp, SeekMode mode) {
+	std::lock_guard<std::mutex> lock(safeReplayMutex);
+	if(!avFormatContext || socketSource) {
+		return false;
+	}
+	int streamId = videoStreamId >= 0 ? videoStreamId : audioStreamId;
+	if(streamId < 0) {
+		return false;
+	}
+	bool wasStarted = readingThreadIsRunning || readingThread.joinable(); //also when it has read to the end
+	stopAudioPlaying();
+	if(wasStarted) { //the reading thread can wait for space in a packet ring
+		if(videoStreamId >= 0) {
+			videoDecoder.haltDecoding();
+		}
+		if(audioStreamId >= 0) {
+			audioDecoder.haltDecoding();
+		}
+	}
+	stopReading();
+
+	AVStream* seekStream = avFormatContext->streams[streamId];
+	int64_t target = static_cast<int64_t>(timestamp / av_q2d(seekStream->time_base));
+	int64_t seekPts = target;
+	bool indexed = false;
+	if(streamId == videoStreamId && indexedUntil != AV_NOPTS_VALUE && target <= indexedUntil) {
+		auto keyframe = std::upper_bound(keyframeIndex.begin(), keyframeIndex.end(), target);
+		if(keyframe != keyframeIndex.begin()) {
+			seekPts = *(keyframe - 1);
+			indexed = true;
+		}
+	}
+	bool result = av_seek_frame(avFormatContext, streamId, seekPts, AVSEEK_FLAG_BACKWARD) >= 0;
+	if(result) {
+		indexContiguous = indexed;
+		recorder.cut();
+	}
+
+	if(videoStreamId >= 0) {
+		videoDecoder.setDropBefore(result && mode == SEEK_EXACT ? static_cast<int64_t>(timestamp / av_q2d(avFormatContext->streams[videoStreamId]->time_base))
+																: AV_NOPTS_VALUE);
+	}
+	if(audioStreamId >= 0) {
+		audioDecoder.setDropBefore(result && mode == SEEK_EXACT ? static_cast<int64_t>(timestamp / av_q2d(avFormatContext->streams[audioStreamId]->time_base))
+																: AV_NOPTS_VALUE);
+	}
+	if(wasStarted) {
+		if(videoStreamId >= 0) {
+			videoDecoder.flush();
+		}
+		if(audioStreamId >= 0) {
+			audioDecoder.flush();
+		}
+		readingThreadIsRunning = true;
+		readingThreadIsStopping = false;
+		readingThread = std::thread(&AVfileContext::reading, this);
+	}
+	if(audioCallback != nullptr && audioDecoder.isReady()) {
+		startAudioPlaying();
+	}
+	return result;
+}
+
+bool AVfileContext::startRecording(const AVRecorder::Parameters& parameters) {
+	return recorder.start(parameters);
+}
+
+void AVfileContext::stopRecording() {
+	recorder.stop();
+}
+
+AVRecorder::Stats AVfileContext::getRecordingStats() {
+	return recorder.getStats();
+}
+
 void AVfileContext::stopReading() {
 	if(readingThreadIsRunning) {
 		readingThreadIsStopping = true;
-		if(readingThread.joinable()) {
-			readingThread.join();
+		std::lock_guard<std::mutex> locker(reconnectMutex);
+		reconnectCond.notify_all();
+	}
+	if(readingByReactor) {
+		socketSource->abort(); //the fiber leaves av_read_frame on its next resume
+		ioReactor->removeStream(this);
+		readingByReactor = false;
+		readingThreadIsRunning = false;
+		demuxFiber.reset();
+		av_packet_free(&reactorPacket);
+		blockedDecoder = nullptr;
+	}
+	if(readingThread.joinable()) { //also when the thread has already finished by itself
+		readingThread.join();
+	}
+}
+
+void AVfileContext::indexPacket(const AVPacket* packet) {
+	int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+	if(pts == AV_NOPTS_VALUE) {
+		return;
+	}
+	if(packet->flags & AV_PKT_FLAG_KEY) {
+		auto position = std::lower_bound(keyframeIndex.begin(), keyframeIndex.end(), pts);
+		if(position == keyframeIndex.end() || *position != pts) {
+			keyframeIndex.insert(position, pts);
 		}
 	}
+	if(indexContiguous && (indexedUntil == AV_NOPTS_VALUE || pts > indexedUntil)) {
+		indexedUntil = pts;
+	}
+}
+
+void AVfileContext::resetKeyframeIndex() {
+	keyframeIndex.clear();
+	indexedUntil = AV_NOPTS_VALUE;
+	indexContiguous = true;
 }
 
 bool AVfileContext::isReading() {
@@ -264,14 +439,66 @@ bool AVfileContext::getVideoData(uint8_t* data, int dataSize) {
 	return videoDecoder.getData(&data[0], dataSize);
 }
 
+VideoFrameRef AVfileContext::borrowVideoData() {
+	return videoDecoder.borrowData();
+}
+
+int AVfileContext::borrowVideoBatch(VideoFrameRef* frames, int maxFrames, double* pts) {
+	return videoDecoder.borrowBatch(frames, maxFrames, pts);
+}
+
+int AVfileContext::getVideoBatch(uint8_t* data, int dataSize, int maxFrames, double* pts) {
+	return videoDecoder.getBatch(data, dataSize, maxFrames, pts);
+}
+
+AVfileContext::Stats& AVfileContext::Stats::operator += (const Stats& other) {
+	video += other.video;
+	audio += other.audio;
+	return *this;
+}
+
+AVfileContext::Stats AVfileContext::getStats() {
+	Stats stats;
+	stats.video = videoDecoder.getStats();
+	stats.audio = audioDecoder.getStats();
+	return stats;
+}
+
+uint64_t AVfileContext::getDroppedVideoFrames() {
+	return videoDecoder.getDroppedFrames();
+}
+
+AVFramePool::Stats AVfileContext::getVideoFramePoolStats() {
+	return videoDecoder.getFramePoolStats();
+}
+
+AVAudioScheduler::JitterStats AVfileContext::getAudioJitterStats() {
+	std::lock_guard<std::mutex> lock(safeReplayMutex);
+	if(!audioScheduler || audioPlayingId == 0) {
+		return AVAudioScheduler::JitterStats();
+	}
+	return audioScheduler->getStats(audioPlayingId);
+}
+
 uint32_t AVfileContext::getAudioData(uint8_t* data, uint32_t dataSize) {
 	uint32_t result = audioDecoder.getData(data, dataSize);
-	if(result > 0) {
+	if(result > 0 && playingMode != FREE_RUN) { //nothing to synchronize to when nothing is paced
 		videoDecoder.setAudioPts(audioDecoder.getLastPts(), audioDecoder.getLastPtsCheckTime(), audioDecoder.getRtspDifferencePts());
 	}
 	return result;
 }
 
+uint32_t AVfileContext::peekAudioData(const uint8_t** data) {
+	return audioDecoder.peekData(data);
+}
+
+void AVfileContext::consumeAudioData(uint32_t dataSize) {
+	audioDecoder.consumeData(dataSize);
+	if(playingMode != FREE_RUN) {
+		videoDecoder.setAudioPts(audioDecoder.getLastPts(), audioDecoder.getLastPtsCheckTime(), audioDecoder.getRtspDifferencePts());
+	}
+}
+
 int AVfileContext::audioSampleRate() {
 	return audioDecoder.getDestSampleRate();
 }
@@ -292,78 +519,72 @@ bool AVfileContext::hasAudioStream() {
 	return audioDecoder.isReady() && audioDecoder.availableData();
 }
 
-void AVfileContext::audioPlaying() {
-	uint8_t* buffer = nullptr;
-	int temp = 0;
-	auto deleter = [&](int*){
-		if(buffer) delete [] buffer;
-		audioPlayingThreadIsRunning = false;
-	};
-	std::unique_ptr<int, decltype(deleter)> threadFinishIndicator(&temp, deleter);
+void AVfileContext::startAudioPlaying() {
+	if(audioPlayingIsRunning) {
+		return;
+	}
+	if(!audioScheduler) {
+		audioScheduler = AVAudioScheduler::shared();
+	}
+	audioPlayingState = AudioPlayingState();
+	audioPlayingIsRunning = true;
+	audioPlayingId = audioScheduler->add([this](int64_t deadline, int64_t now) {
+											return audioPlayingStep(deadline, now);
+										}, av_gettime_relative());
+}
 
-	while(true) {
-		if(audioDecoder.availableData()) {
-			break;
-		}else if(audioPlayingThreadIsStopping || !audioDecoder.isRunning()) {
-			return;
+void AVfileContext::stopAudioPlaying() {
+	if(audioPlayingId != 0) {
+		audioScheduler->remove(audioPlayingId);
+		audioPlayingId = 0;
+	}
+	audioPlayingIsRunning = false;
+}
+
+int64_t AVfileContext::audioPlayingStep(int64_t deadline, int64_t now) {
+	AudioPlayingState& state = audioPlayingState;
+	if(audioDecoder.isRunning()) {
+		state.decoderSeen = true;
+	}else if(state.decoderSeen) {
+		audioPlayingIsRunning = false;
+		return -1;
+	}
+	if(state.chunkSize == 0) {
+		if(!audioDecoder.availableData()) {
+			return now + audioWaitingPeriod;
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
-	}
-	uint32_t bytesPerSample = static_cast<uint32_t>(av_get_bytes_per_sample(audioDecoder.getDestSampleFormat()));
-	uint32_t channels = static_cast<uint32_t>(audioDecoder.getDestChannels());
-	uint32_t bufsize = static_cast<uint32_t>(audioSamplesNum) * bytesPerSample * channels;
-	buffer = new uint8_t[bufsize];
-
-	double sampleRate = static_cast<double>(audioDecoder.getDestSampleRate());
-	int64_t callPeriod = static_cast<int64_t>(1000000.0 / (sampleRate / audioSamplesNum));
-
-	int64_t lastCallTime = av_gettime();
-	int64_t cutPeriod = 0;
-	while(!audioPlayingThreadIsStopping && audioDecoder.isRunning()) {
-		int64_t now = av_gettime();
-		while(now - lastCallTime < callPeriod) {
-			now = av_gettime();
-		}
-		uint32_t result = getAudioData(buffer, static_cast<unsigned>(bufsize));
-
-		if(result > 0) {
-			std::unique_lock<std::mutex> locker(safeAudioCallbackMutex);
-			int32_t oneStepWrited = 0;
-			int32_t alreadyWrited = 0;
-			audioCallback(buffer, result, oneStepWrited);
-			while(oneStepWrited < static_cast<int32_t>(result)) {
-				locker.unlock();
-				if(oneStepWrited > -1) {
-					result -= static_cast<uint32_t>(oneStepWrited);
-					alreadyWrited += oneStepWrited;
-				}
+		uint32_t bytesPerSample = static_cast<uint32_t>(av_get_bytes_per_sample(audioDecoder.getDestSampleFormat()));
+		uint32_t channels = static_cast<uint32_t>(audioDecoder.getDestChannels());
+		state.bytesPerFrame = bytesPerSample * channels;
+		state.chunkSize = static_cast<uint32_t>(audioSamplesNum) * state.bytesPerFrame;
+		state.sampleRate = static_cast<double>(audioDecoder.getDestSampleRate());
+		state.callPeriod = static_cast<int64_t>(1000000.0 / (state.sampleRate / audioSamplesNum));
+	}
 
-				oneStepWrited = 0;
-				now = av_gettime();
-				lastCallTime = now;
-				int64_t newCallPeriod = static_cast<int64_t>(1000000.0 / (sampleRate / (static_cast<double>(result) / (bytesPerSample * channels))));
-				cutPeriod = newCallPeriod - 3000;
-				if(cutPeriod >= 2000) {
-					std::this_thread::sleep_for(std::chrono::microseconds(cutPeriod));
-				}
+	int64_t nextDeadline = deadline + state.callPeriod; //keeps the period without drift
+	if(nextDeadline < now) {
+		nextDeadline = now + state.callPeriod;
+	}
+	const uint8_t* data = nullptr;
+	uint32_t dataSize = std::min(peekAudioData(&data), state.chunkSize);
+	if(dataSize == 0) {
+		return playingMode == FREE_RUN ? now + audioWaitingPeriod : nextDeadline;
+	}
 
-				while(now - lastCallTime < newCallPeriod) {
-					now = av_gettime();
-				}
-				locker.lock();
-				if(audioPlayingThreadIsStopping || !audioDecoder.isRunning()) {
-					return;
-				}
-				audioCallback(&buffer[alreadyWrited], result, oneStepWrited);
-			}
-			//now = av_gettime();
-		}
-		lastCallTime = now;
-		cutPeriod = callPeriod - 3000;
-		if(cutPeriod >= 2000) {
-			std::this_thread::sleep_for(std::chrono::microseconds(cutPeriod));
-		}
+	std::unique_lock<std::mutex> locker(safeAudioCallbackMutex);
+	int writed = 0;
+	if(audioCallback != nullptr) {
+		audioCallback(const_cast<uint8_t*>(data), dataSize, writed); //the callback may process the samples in place
+	}
+	locker.unlock();
+	if(writed > 0) { //what the callback left stays in the ring for the next call
+		consumeAudioData(std::min(static_cast<uint32_t>(writed), dataSize));
 	}
+	if(writed >= static_cast<int>(dataSize)) {
+		return playingMode == FREE_RUN ? now : nextDeadline; //FREE_RUN feeds the callback as fast as it takes the data
+	}
+	uint32_t pendingSize = dataSize - static_cast<uint32_t>(std::max(writed, 0)); //the output is full, come back when it has played what it took
+	return now + static_cast<int64_t>(1000000.0 * (pendingSize / state.bytesPerFrame) / state.sampleRate);
 }
 
 void AVfileContext::reading() {
@@ -374,6 +595,7 @@ void AVfileContext::reading() {
 		av_packet_free(&packet);
 		audioDecoder.fileFinished();
 		videoDecoder.fileFinished();
+		recorder.cut();
 	};
 	std::unique_ptr<int, decltype(deleter)> threadFinishIndicator(&temp, deleter);
 
@@ -386,7 +608,13 @@ void AVfileContext::reading() {
 	while(!readingThreadIsStopping) {
 		int result = av_read_frame(avFormatContext, packet);
 		if(result == 0) {
+			recorder.write(packet);
+			if(playingMode == RECORD) {
+				av_packet_unref(packet);
+				continue;
+			}
 			if(packet->stream_index == videoStreamId) {
+				indexPacket(packet);
 				if(!videoDecoder.pushPacket(packet)) {
 					av_packet_unref(packet);
 					if(fallHandle()) {
@@ -413,55 +641,54 @@ void AVfileContext::reading() {
 }
 
 bool AVfileContext::fallHandle() {
-	if(playingMode == NORMAL) {
+	if(playingMode == NORMAL || playingMode == FREE_RUN) {
 		return false;
 	}else {
-		if(videoStreamId != -1) {
-			while(videoDecoder.hasData()) {
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
-			}
-			while(!readingThreadIsStopping) {
-				std::unique_lock<std::mutex> lock(safeReplayMutex, std::try_to_lock);
-				if(lock.owns_lock()) {
-					videoDecoder.stop();
-					break;
-				}
-			}
-			if(readingThreadIsStopping) {
-				return false;
-			}
-		}
-		if(audioStreamId != -1) {
-			while(audioDecoder.availableData() > 0) {
-				std::this_thread::sleep_for(std::chrono::milliseconds(100));
-			}
-			while(!readingThreadIsStopping) {
-				std::unique_lock<std::mutex> lock(safeReplayMutex, std::try_to_lock);
-				if(lock.owns_lock()) {
-					if(audioPlayingThreadIsRunning) {
-						audioPlayingThreadIsStopping = true;
-						if(audioPlayingThread.joinable()) {
-							audioPlayingThread.join();
-						}
-					}
-					audioDecoder.stop();
-					break;
-				}
-			}
+		int delay = reconnectMinDelay;
+		while(!repeat()) { //the decoders keep running, queued frames are shown meanwhile
+			std::unique_lock<std::mutex> locker(reconnectMutex);
+			reconnectCond.wait_for(locker, std::chrono::milliseconds(delay), [&](){return readingThreadIsStopping.load();});
 			if(readingThreadIsStopping) {
 				return false;
 			}
-		}
-		while(!repeat()) {
-			if(readingThreadIsStopping) {
-				return false;
-			}
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			delay = delay * 2 > reconnectMaxDelay ? reconnectMaxDelay : delay * 2;
 		}
 		return true;
 	}
 }
 
+void AVfileContext::applyThreading(AVCodecContext* codecContext, const DecoderThreading& threading) {
+	int threadCount = threading.threadCount;
+	if(threadCount == AUTO_THREADS) { //taken when the codec opens, so reconnects follow the current load
+		unsigned int cores = decodingCoreBudget;
+		if(cores == 0) {
+			cores = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threadCount = std::max(1, static_cast<int>(cores) / std::max(1, autoThreadedDecoders.load()));
+	}
+	codecContext->thread_count = threadCount;
+	codecContext->thread_type = threading.threadType;
+}
+
+void AVfileContext::setStreamOptions(AVDictionary** streamOptions) {
+	if(playingMode == LOW_LATENCY) { //the options are read on every (re)connect
+		av_dict_set(streamOptions, "fflags", "nobuffer", 0);
+		av_dict_set(streamOptions, "probesize", "32768", 0);
+		av_dict_set(streamOptions, "analyzeduration", "500000", 0); // in microseconds
+	}
+}
+
+void AVfileContext::setCodecOptions(AVCodecContext* codecContext) {
+	if(playingMode == LOW_LATENCY) {
+		codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+	}
+}
+
+void AVfileContext::releaseThreadBudget() {
+	autoThreadedDecoders -= budgetedDecoders;
+	budgetedDecoders = 0;
+}
+
 bool AVfileContext::repeat() {
 	std::unique_lock<std::mutex> lock(safeReplayMutex, std::try_to_lock);
 	if(!lock.owns_lock()) {
@@ -470,107 +697,274 @@ bool AVfileContext::repeat() {
 	if(readingThreadIsStopping) {
 		return false;
 	}
-	if(avFormatContext != nullptr) {
-		avformat_close_input(&avFormatContext);
-	}
 
 	bool allRight = false;
+	AVFormatContext* newFormatContext = nullptr;
+	AVCodecContext* videoCodecContext = nullptr;
+	AVCodecContext* audioCodecContext = nullptr;
 
 	AVDictionary *stream_opts = nullptr;
 	av_dict_set(&stream_opts, "rtsp_flags", "prefer_tcp", 0);
 	av_dict_set(&stream_opts, "stimeout", "10000000", 0); // in microseconds
+	setStreamOptions(&stream_opts);
 	if(stream_opts == nullptr) {
 		return false;
 	}
 	int temp = 0;
 	auto deleter = [&](int*){
 		if(!allRight) {
-			if(avFormatContext) {avformat_close_input(&avFormatContext); avFormatContext = nullptr;}
+			if(videoCodecContext) {avcodec_free_context(&videoCodecContext);}
+			if(audioCodecContext) {avcodec_free_context(&audioCodecContext);}
+			if(newFormatContext) {avformat_close_input(&newFormatContext);}
 		}
 		if(stream_opts) {av_dict_free(&stream_opts);}
 	};
 	std::unique_ptr<int, decltype(deleter)> allCloser(&temp, deleter);
 
-	int resOpen = avformat_open_input(&avFormatContext, filePath.c_str(), nullptr, &stream_opts);
+	int resOpen = avformat_open_input(&newFormatContext, filePath.c_str(), nullptr, &stream_opts);
 	if(resOpen != 0) {
 		return false;
 	}
 
-	if(avformat_find_stream_info(avFormatContext, nullptr) < 0) {
+	if(!fillCachedParameters(newFormatContext) && !findStreamInfo(newFormatContext)) {
 		return false;
 	}
 
+	//everything that can fail is done before the running decoders are touched
+	bool decoding = playingMode != RECORD;
 	AVCodec* avcodec = nullptr;
+	AVStream* videoStream = nullptr;
 	int videoStreamId = -1;
+	bool videoWarm = false;
 	if(streamType & VIDEO) {
-		int ret = av_find_best_stream(avFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &avcodec, 0);
+		int ret = av_find_best_stream(newFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &avcodec, 0);
 		if(ret >= 0) {
 			videoStreamId = ret;
-			AVStream* vstrm = avFormatContext->streams[videoStreamId];
-
-			AVCodecContext* videoCodecContext = avcodec_alloc_context3(nullptr);
-			if(videoCodecContext == nullptr) {
-				return false;
-			}
-			if(avcodec_parameters_to_context(videoCodecContext, vstrm->codecpar) < 0) {
-				avcodec_free_context(&videoCodecContext);
-				return false;
-			}
-			videoCodecContext->thread_count = 4;
-			if(avcodec_open2(videoCodecContext, avcodec, nullptr) < 0) {
-				avcodec_free_context(&videoCodecContext);
-				return false;
-			}
-			videoDecoder.init();
-			if(!videoDecoder.setStreamAndCodecContext(vstrm, videoCodecContext)) {
-				avcodec_free_context(&videoCodecContext);
-				return false;
+			videoStream = newFormatContext->streams[videoStreamId];
+			videoWarm = videoDecoder.isRunning() && sameParameters(videoParameters, videoStream->codecpar);
+			if(!videoWarm && decoding) {
+				videoCodecContext = openCodecContext(videoStream, avcodec, videoThreading);
+				if(videoCodecContext == nullptr) {
+					return false;
+				}
 			}
 		}
 	}
 
 	avcodec = nullptr;
+	AVStream* audioStream = nullptr;
 	int audioStreamId = -1;
+	bool audioWarm = false;
 	if(streamType & AUDIO) {
-		int ret = av_find_best_stream(avFormatContext, AVMEDIA_TYPE_AUDIO, -1, -1, &avcodec, 0);
+		int ret = av_find_best_stream(newFormatContext, AVMEDIA_TYPE_AUDIO, -1, -1, &avcodec, 0);
 		if(ret >= 0) {
 			audioStreamId = ret;
-			AVStream* vstrm = avFormatContext->streams[audioStreamId];
-			AVCodecContext* audioCodecContext = avcodec_alloc_context3(nullptr);
-			if(audioCodecContext == nullptr) {
-				return false;
-			}
-			if(avcodec_parameters_to_context(audioCodecContext, vstrm->codecpar) < 0) {
-				avcodec_free_context(&audioCodecContext);
-				return false;
-			}
-			if(avcodec_open2(audioCodecContext, avcodec, nullptr) < 0) {
-				avcodec_free_context(&audioCodecContext);
-				return false;
-			}
-			audioDecoder.init();
-			if(!audioDecoder.setStreamAndCodecContext(vstrm, audioCodecContext)) {
-				avcodec_free_context(&audioCodecContext);
-				return false;
-			}
-			if(audioCallback != nullptr) {
-				audioPlayingThreadIsRunning = true;
-				audioPlayingThreadIsStopping = false;
-				audioPlayingThread = std::thread(&AVfileContext::audioPlaying, this);
+			audioStream = newFormatContext->streams[audioStreamId];
+			audioWarm = audioDecoder.isRunning() && sameParameters(audioParameters, audioStream->codecpar);
+			if(!audioWarm && decoding) {
+				audioCodecContext = openCodecContext(audioStream, avcodec, audioThreading);
+				if(audioCodecContext == nullptr) {
+					return false;
+				}
 			}
 		}
 	}
 
-	if(videoStreamId != -1) {
-		videoDecoder.start();
+	if(videoWarm) { //same stream, the codec and the converter go on with the new packets
+		videoDecoder.replaceStream(videoStream);
+	}else {
+		videoDecoder.stop();
+		resetKeyframeIndex();
+		if(videoCodecContext) {
+			videoDecoder.setStreamAndCodecContext(videoStream, videoCodecContext);
+			videoCodecContext = nullptr;
+			videoDecoder.start();
+			rememberParameters(&videoParameters, videoStream->codecpar);
+		}
 	}
 	this->videoStreamId = videoStreamId;
 
-	if(audioStreamId != -1) {
-		audioDecoder.start();
+	if(audioWarm) {
+		audioDecoder.replaceStream(audioStream);
+	}else {
+		stopAudioPlaying();
+		audioDecoder.stop();
+		if(audioCodecContext) {
+			audioDecoder.setStreamAndCodecContext(audioStream, audioCodecContext);
+			audioCodecContext = nullptr;
+			audioDecoder.start();
+			rememberParameters(&audioParameters, audioStream->codecpar);
+			if(audioCallback != nullptr) {
+				startAudioPlaying();
+			}
+		}
 	}
 	this->audioStreamId = audioStreamId;
+	recorder.setStreams(videoStream, audioStream);
 
+	if(avFormatContext != nullptr) { //closed only now, the decoders used its streams until here
+		avformat_close_input(&avFormatContext);
+	}
+	avFormatContext = newFormatContext;
 	allRight = true;
 	return true;
 }
+
+AVCodecContext* AVfileContext::openCodecContext(AVStream* stream, AVCodec* codec, const DecoderThreading& threading) {
+	AVCodecContext* codecContext = avcodec_alloc_context3(nullptr);
+	if(codecContext == nullptr) {
+		return nullptr;
+	}
+	if(avcodec_parameters_to_context(codecContext, stream->codecpar) < 0) {
+		avcodec_free_context(&codecContext);
+		return nullptr;
+	}
+	applyThreading(codecContext, threading);
+	setCodecOptions(codecContext);
+	if(avcodec_open2(codecContext, codec, nullptr) < 0) {
+		avcodec_free_context(&codecContext);
+		return nullptr;
+	}
+	return codecContext;
+}
+
+void AVfileContext::rememberParameters(AVCodecParameters** cache, const AVCodecParameters* parameters) {
+	if(*cache == nullptr) {
+		*cache = avcodec_parameters_alloc();
+	}
+	if(*cache != nullptr && avcodec_parameters_copy(*cache, parameters) < 0) {
+		avcodec_parameters_free(cache);
+	}
+}
+
+void AVfileContext::forgetParameters() {
+	avcodec_parameters_free(&videoParameters);
+	avcodec_parameters_free(&audioParameters);
+}
+
+bool AVfileContext::sameParameters(const AVCodecParameters* cached, const AVCodecParameters* parameters) {
+	if(cached == nullptr) {
+		return false;
+	}
+	if(cached->codec_type != parameters->codec_type || cached->codec_id != parameters->codec_id || cached->format != parameters->format) {
+		return false;
+	}
+	if(cached->codec_type == AVMEDIA_TYPE_VIDEO) {
+		if(cached->width != parameters->width || cached->height != parameters->height) {
+			return false;
+		}
+	}else if(cached->sample_rate != parameters->sample_rate || cached->channels != parameters->channels) {
+		return false;
+	}
+	if(cached->extradata_size != parameters->extradata_size) {
+		return false;
+	}
+	return cached->extradata_size == 0 || memcmp(cached->extradata, parameters->extradata, static_cast<size_t>(cached->extradata_size)) == 0;
+}
+
+bool AVfileContext::findStreamInfo(AVFormatContext* formatContext) {
+	if(probeCache && probeCache->apply(filePath, formatContext)) {
+		return true;
+	}
+	if(avformat_find_stream_info(formatContext, nullptr) < 0) {
+		return false;
+	}
+	if(probeCache) {
+		probeCache->store(filePath, formatContext);
+	}
+	return true;
+}
+
+bool AVfileContext::fillCachedParameters(AVFormatContext* formatContext) {
+	const AVMediaType types[] = {AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO};
+	AVCodecParameters* caches[] = {(streamType & VIDEO) ? videoParameters : nullptr, (streamType & AUDIO) ? audioParameters : nullptr};
+	AVCodecParameters* found[] = {nullptr, nullptr};
+	if(caches[0] == nullptr && caches[1] == nullptr) {
+		return false;
+	}
+	for(unsigned int i = 0; i < 2; ++ i) {
+		if(caches[i] == nullptr) continue;
+		int ret = av_find_best_stream(formatContext, types[i], -1, -1, nullptr, 0);
+		if(ret < 0 || formatContext->streams[ret]->codecpar->codec_id != caches[i]->codec_id) {
+			return false;
+		}
+		found[i] = formatContext->streams[ret]->codecpar;
+	}
+	for(unsigned int i = 0; i < 2; ++ i) {
+		if(found[i] == nullptr) continue;
+		if(!AVProbeCache::isComplete(found[i]) && avcodec_parameters_copy(found[i], caches[i]) < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AVfileContext::openSocketSource() {
+	socketSource.reset(new AVSocketSource);
+	AVSocketSource::OpenResult opened = socketSource->open(filePath, 10000000);
+	if(opened != AVSocketSource::OPENED) {
+		socketSource.reset();
+		return opened == AVSocketSource::UNHANDLED; //avformat_open_input connects by itself and follows redirects
+	}
+	ioContext = socketSource->createIOContext();
+	avFormatContext = avformat_alloc_context();
+	if(ioContext == nullptr || avFormatContext == nullptr) {
+		return false;
+	}
+	avFormatContext->pb = ioContext;
+	avFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+	return true;
+}
+
+void AVfileContext::closeSocketSource() {
+	AVSocketSource::freeIOContext(&ioContext);
+	socketSource.reset();
+}
+
+bool AVfileContext::hasPendingInput(int64_t now) {
+	if(demuxStopping()) {
+		return true;
+	}
+	if(blockedDecoder) {
+		return blockedDecoder->canPushPacket();
+	}
+	return !socketSource->isWaitingForData() || socketSource->waitExpired(now);
+}
+
+bool AVfileContext::demuxStopping() {
+	return readingThreadIsStopping || socketSource->isAborted();
+}
+
+void AVfileContext::demuxByReactor() {
+	while(!demuxStopping()) {
+		if(av_read_frame(avFormatContext, reactorPacket) != 0) { //yields inside while the socket is empty
+			return;
+		}
+		recorder.write(reactorPacket);
+		AVBaseDecoder* decoder = nullptr;
+		if(reactorPacket->stream_index == videoStreamId) {
+			decoder = &videoDecoder;
+		}else if(reactorPacket->stream_index == audioStreamId) {
+			decoder = &audioDecoder;
+		}
+		if(decoder) {
+			while(!decoder->canPushPacket() && !demuxStopping()) { //the reactor resumes when the decoder has space
+				blockedDecoder = decoder;
+				demuxFiber->yield();
+			}
+			blockedDecoder = nullptr;
+			if(demuxStopping() || !decoder->pushPacket(reactorPacket)) {
+				av_packet_unref(reactorPacket);
+				return;
+			}
+		}
+		av_packet_unref(reactorPacket);
+	}
+}
+
+void AVfileContext::readingFinished() {
+	readingThreadIsRunning = false;
+	audioDecoder.fileFinished();
+	videoDecoder.fileFinished();
+	recorder.cut();
+}
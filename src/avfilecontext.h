@@ -3,12 +3,21 @@
 
 #include "videodecoder.h"
 #include "audiodecoder.h"
+#include "avsocketsource.h"
+#include "avioreactor.h"
+#include "avfiber.h"
+#include "avaudioscheduler.h"
+#include "avprobecache.h"
+#include "avrecorder.h"
 
 class AVfileContext {
 	public:
 		enum PlayingMode {
 			NORMAL,
-			REPEATE_AND_RECONNECT
+			REPEATE_AND_RECONNECT,
+			LOW_LATENCY, //reconnects like REPEATE_AND_RECONNECT, keeps no backlog and shows the newest frame
+			FREE_RUN, //reads once like NORMAL, frames and audio are given out as soon as they are decoded, for offline processing
+			RECORD //reconnects like REPEATE_AND_RECONNECT, opens no decoder, the packets only go to the recorder
 		};
 
 		enum StreamType {
@@ -16,6 +25,28 @@ class AVfileContext {
 			AUDIO = 2,
 		};
 
+		//codec threading of one stream, FF_THREAD_SLICE has no frame of delay per thread but not all codecs support it
+		struct DecoderThreading {
+			DecoderThreading(int threadCount = 1, int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE):
+				threadCount(threadCount),
+				threadType(threadType)
+			{}
+			int threadCount; //AUTO_THREADS shares the core budget between all such streams
+			int threadType;
+		};
+		static const int AUTO_THREADS = 0;
+
+		struct Stats {
+			AVBaseDecoder::Stats video;
+			AVBaseDecoder::Stats audio;
+			Stats& operator += (const Stats& other);
+		};
+
+		enum SeekMode {
+			SEEK_KEYFRAME, //starts at the keyframe before the timestamp
+			SEEK_EXACT //decodes from that keyframe and shows the first frame at the timestamp
+		};
+
 		AVfileContext() = default;
 		AVfileContext(const AVfileContext& other) = delete;
 		AVfileContext(AVfileContext&& other) = delete;
@@ -23,17 +54,31 @@ class AVfileContext {
 		AVfileContext& operator = (AVfileContext&& other) = delete;
 
 		~AVfileContext();
-		bool openFile(const std::string& path, PlayingMode playingMode, int streamType);
+		bool openFile(const std::string& path, PlayingMode playingMode, int streamType,
+					  DecoderThreading videoThreading = DecoderThreading(4), DecoderThreading audioThreading = DecoderThreading(1));
+		static void setDecodingCoreBudget(unsigned int cores); //cores for AUTO_THREADS streams, 0 means all cores
+		bool setDecodingPool(AVDecodingPool* pool); //before openFile, the pool must outlive the file
+		bool setIOReactor(AVIOReactor* reactor); //before openFile, used for tcp/http inputs in NORMAL mode
+		bool setProbeCache(AVProbeCache* cache); //before openFile, the cache must outlive the file
+		bool setMemoryBudget(AVMemoryBudget* budget); //before openFile, the budget must outlive the file
+		void setBufferDepth(unsigned int packetsMs, unsigned int framesMs); //per stream, used from startReading or the next seek
 		void closeFile();
 		int getSourceVideoWidth();
 		int getSourceVideoHeigth();
 		int getDestinationWidth();
 		int getDestinationHeigth();
-		bool setVideoConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW = -1, int dstH = -1);
+		bool setVideoConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW = -1, int dstH = -1, int slices = 1);
+		bool setVideoTensorOutput(AVTensorConverter::Type type, const AVTensorConverter::Normalization& normalization, int flags,
+								  int dstW = -1, int dstH = -1, int slices = 1); //getVideoBatch then gives NCHW tensors
 		bool setAudioConvertingParameters(AVSampleFormat destSampleFormat, int64_t destChLayuot = -1, int destSampleRate = -1);
-		void setPlayingMode(PlayingMode newPlayingMode);
+		void setPlayingMode(PlayingMode newPlayingMode); //RECORD is chosen in openFile only
 		void setAudioCallback(std::function<void(uint8_t* buffer, uint32_t len, int& writed)> audioCallback, int32_t audioSamplesNum);
 		bool startReading();
+		bool seek(double timestamp, SeekMode mode = SEEK_EXACT); //seconds of the stream timestamps, not for the io reactor inputs
+		//remuxes the packets of the open streams into segment files, alongside the decoders or alone in RECORD mode
+		bool startRecording(const AVRecorder::Parameters& parameters);
+		void stopRecording();
+		AVRecorder::Stats getRecordingStats();
 		bool isReading();
 		bool isDecodingVideo();
 		bool isDecodingAudio();
@@ -42,7 +87,18 @@ class AVfileContext {
 		bool endOfFile();
 		bool getVideoData(uint8_t** data, int* dataSize);
 		bool getVideoData(uint8_t* data, int dataSize);
+		VideoFrameRef borrowVideoData();
+		int borrowVideoBatch(VideoFrameRef* frames, int maxFrames, double* pts = nullptr); //without pacing, see VideoDecoder::borrowBatch
+		int getVideoBatch(uint8_t* data, int dataSize, int maxFrames, double* pts = nullptr); //NHWC for packed formats like RGB24, NCHW for planar ones like GBRP
+		uint64_t getDroppedVideoFrames(); //stale frames skipped in LOW_LATENCY mode
+		Stats getStats();
+		AVFramePool::Stats getVideoFramePoolStats();
+		AVAudioScheduler::JitterStats getAudioJitterStats();
 		uint32_t getAudioData(uint8_t* data, uint32_t dataSize);
+		//contiguous queued samples without a copy, valid until consumeAudioData.
+		//setAudioConvertingParameters invalidates the pointer, don't call it between peekAudioData and consumeAudioData
+		uint32_t peekAudioData(const uint8_t** data);
+		void consumeAudioData(uint32_t dataSize);
 		int audioSampleRate();
 		int audioChannels();
 		int getNbSamples();
@@ -53,9 +109,32 @@ class AVfileContext {
 		std::string filePath;
 
 		std::thread readingThread;
-		bool readingThreadIsRunning = false;
-		bool readingThreadIsStopping = false;
+		std::atomic<bool> readingThreadIsRunning = {false};
+		std::atomic<bool> readingThreadIsStopping = {false};
+		DecoderThreading videoThreading;
+		DecoderThreading audioThreading;
+		int budgetedDecoders = 0; //AUTO_THREADS decoders of this file counted in autoThreadedDecoders
+		static std::atomic<unsigned int> decodingCoreBudget;
+		static std::atomic<int> autoThreadedDecoders;
 		std::mutex safeReplayMutex;
+		std::mutex reconnectMutex;
+		std::condition_variable reconnectCond;
+		static const int reconnectMinDelay = 10; //milliseconds, doubled after every failed attempt
+		static const int reconnectMaxDelay = 2000;
+		AVCodecParameters* videoParameters = nullptr; //of the open streams, to recognise them after a reconnect
+		AVCodecParameters* audioParameters = nullptr;
+		std::vector<int64_t> keyframeIndex; //pts of the video keyframes read so far, sorted
+		int64_t indexedUntil = AV_NOPTS_VALUE; //every keyframe up to this pts is in the index
+		bool indexContiguous = true; //false after a seek past indexedUntil, until a seek comes back into it
+
+		AVIOReactor* ioReactor = nullptr;
+		AVProbeCache* probeCache = nullptr;
+		std::unique_ptr<AVSocketSource> socketSource;
+		AVIOContext* ioContext = nullptr;
+		AVPacket* reactorPacket = nullptr;
+		std::unique_ptr<AVFiber> demuxFiber; //runs demuxByReactor on a reactor thread
+		AVBaseDecoder* blockedDecoder = nullptr; //the fiber yielded until this decoder has space
+		bool readingByReactor = false;
 
 		AVFormatContext* avFormatContext = nullptr;
 		int videoStreamId = -1;
@@ -63,22 +142,54 @@ class AVfileContext {
 
 		VideoDecoder videoDecoder;
 		AudioDecoder audioDecoder;
+		AVRecorder recorder; //written by the thread that demuxes, before the packets go to the decoders
 
 		PlayingMode playingMode = NORMAL;
 		int streamType = VIDEO | AUDIO;
 
 		std::function<void(uint8_t* buffer, uint32_t len, int& writed)> audioCallback = nullptr;
 		int32_t audioSamplesNum =  1024;
-		std::thread audioPlayingThread;
-		bool audioPlayingThreadIsRunning = false;
-		bool audioPlayingThreadIsStopping = false;
+		std::shared_ptr<AVAudioScheduler> audioScheduler;
+		uint64_t audioPlayingId = 0;
+		std::atomic<bool> audioPlayingIsRunning = {false};
 		std::mutex safeAudioCallbackMutex;
+		struct AudioPlayingState {
+			uint32_t chunkSize = 0; //the most given to the callback at once, straight from the decoder's ring
+			uint32_t bytesPerFrame = 0;
+			double sampleRate = 0.0;
+			int64_t callPeriod = 0;
+			bool decoderSeen = false;
+		};
+		AudioPlayingState audioPlayingState;
+		static const int64_t audioWaitingPeriod = 5000;
 
-		void audioPlaying();
+		void startAudioPlaying();
+		void stopAudioPlaying();
+		int64_t audioPlayingStep(int64_t deadline, int64_t now);
 		void stopReading();
+		void indexPacket(const AVPacket* packet);
+		void resetKeyframeIndex();
 		void reading();
 		bool fallHandle();
 		bool repeat();
+		AVCodecContext* openCodecContext(AVStream* stream, AVCodec* codec, const DecoderThreading& threading);
+		void rememberParameters(AVCodecParameters** cache, const AVCodecParameters* parameters);
+		void forgetParameters();
+		static bool sameParameters(const AVCodecParameters* cached, const AVCodecParameters* parameters);
+		bool fillCachedParameters(AVFormatContext* formatContext); //stands in for avformat_find_stream_info after a reconnect
+		bool findStreamInfo(AVFormatContext* formatContext);
+		void setStreamOptions(AVDictionary** streamOptions);
+		void setCodecOptions(AVCodecContext* codecContext);
+		void applyThreading(AVCodecContext* codecContext, const DecoderThreading& threading);
+		void releaseThreadBudget();
+		bool openSocketSource();
+		void closeSocketSource();
+		bool hasPendingInput(int64_t now);
+		bool demuxStopping();
+		void demuxByReactor();
+		void readingFinished();
+
+		friend class AVIOReactor;
 };
 
 #endif // AVFILECONTEXT_H
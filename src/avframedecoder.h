@@ -0,0 +1,271 @@
+#ifndef AVFRAMEDECODER_H
+#define AVFRAMEDECODER_H
+
+#include "avbasedecoder.h"
+
+//Plain frame slots, the frames own nothing av_frame_unref doesn't release.
+struct AVFrameDeleter {
+	void operator () (AVFrame* frame) const {
+		av_frame_free(&frame);
+	}
+};
+struct AVFrameUnreferencer {
+	void operator () (AVFrame* frame) const {
+		av_frame_unref(frame);
+	}
+};
+using AVPlainFrameType = AVItemContainer<AVFrame, AVFrameDeleter, AVFrameUnreferencer>;
+
+//The decoding loop around the frames ring, FrameType is the slot with the deleter and the unreferencer
+//of what the decoder converts into its frames, so each decoder releases only what it allocated.
+template<class FrameType>
+class AVFrameDecoder: public AVBaseDecoder {
+	public:
+		virtual ~AVFrameDecoder() override {
+			stop();
+		}
+
+		bool start() {
+			if(running || !codecContext || !stream){return false;}
+			packet.reset();
+			resizePacketRing();
+			std::unique_lock<std::mutex> frameLocker(frameMutex); //the consumer can still take the frames left by a finished decoding
+			frame.reset();
+			resizeFrameRing();
+			frameLocker.unlock();
+			if(frameforDecoding == nullptr) {
+				frameforDecoding = av_frame_alloc();
+			}
+			if(frameforDecoding == nullptr) {
+				return false;
+			}
+			frameDecoded = false;
+			codecDrained = false;
+			running = true;
+			stopping = false;
+			endOfFile = false;
+			if(decodingPool) {
+				taskQueued = false;
+			}else {
+				decodingThread = std::thread(&AVFrameDecoder::decoding, this);
+			}
+			return true;
+		}
+
+		void stop() {
+			haltDecoding();
+			dropBeforePts = AV_NOPTS_VALUE;
+			if(frameforDecoding) {
+				av_frame_free(&frameforDecoding);
+				frameforDecoding = nullptr;
+			}
+			frameDecoded = false;
+			for(auto& packetContainer : packet) {
+				if(packetContainer.isReferenced()) {
+					poppedPacketBytes.add(static_cast<uint64_t>(packetContainer.getPtr()->size));
+				}
+				packetContainer.unrefPtr();
+			}
+			packet.reset();
+			std::unique_lock<std::mutex> frameLocker(frameMutex); //the consumer can still take the frames left by a finished decoding
+			for(auto& frameContainer : frame) {
+				frameContainer.unrefPtr();
+			}
+			frame.reset();
+			releaseBudget();
+			frameLocker.unlock();
+			if(codecContext) {
+				avcodec_flush_buffers(codecContext);
+				avcodec_free_context(&codecContext);
+				codecContext = nullptr;
+			}
+			stream = nullptr;
+			stopping = false;
+		}
+
+		bool flush() { //drops the queued packets and frames and decodes on with the same codec context
+			if(!codecContext || !stream) return false;
+			haltDecoding();
+			if(frameforDecoding) {
+				av_frame_unref(frameforDecoding);
+			}
+			frameDecoded = false;
+			for(auto& packetContainer : packet) {
+				if(packetContainer.isReferenced()) {
+					poppedPacketBytes.add(static_cast<uint64_t>(packetContainer.getPtr()->size));
+				}
+				packetContainer.unrefPtr();
+			}
+			packet.reset();
+			std::unique_lock<std::mutex> codecLocker(codecMutex);
+			std::unique_lock<std::mutex> frameLocker(frameMutex); //the consumer could be reading the frames
+			dropQueuedFrames();
+			frame.reset();
+			avcodec_flush_buffers(codecContext);
+			frameLocker.unlock();
+			codecLocker.unlock();
+			running = false;
+			stopping = false;
+			return start();
+		}
+
+		void haltDecoding() { //stops decoding and wakes a blocked pushPacket, stop() or flush() follows
+			stopping = true;
+			frame.wakeAll();
+			packet.wakeAll();
+			if(decodingThread.joinable()) {
+				decodingThread.join();
+			}
+			if(decodingPool) {
+				std::unique_lock<std::mutex> scheduleLocker(scheduleMutex); //no submit can slip in after this point
+				scheduleLocker.unlock();
+				decodingPool->cancel(this);
+				taskQueued = false;
+				running = false;
+			}
+		}
+
+		virtual Stats getStats() override {
+			Stats stats = AVBaseDecoder::getStats();
+			stats.framesInRing = frame.count();
+			stats.framesCapacity = frame.size() - 1;
+			return stats;
+		}
+
+	protected:
+		AVSpscRing<FrameType> frame{defaultFramesSlots}; //the slots get their frame when first written
+
+		void decoding() {
+			int temp = 0;
+			auto deleter = [&](int*) {
+				decodingFinished();
+			};
+			std::unique_ptr<int, decltype(deleter)> threadFinishIndicator(&temp, deleter);
+
+			while(!stopping) {
+				DecodingStep step = decodeStep();
+				if(step == STEP_NEED_PACKET) {
+					packet.waitForData([&](){return stopping || endOfFile;});
+				}else if(step == STEP_NEED_SPACE) {
+					frame.waitAsProducer([&](){return hasFrameSpace() || stopping;});
+				}else if(step == STEP_FINISHED) {
+					break;
+				}
+			}
+		}
+
+		virtual DecodingStep decodeStep() override {
+			if(stopping) return STEP_FINISHED;
+			if(frameDecoded) { //the last decoded frame still waits for a free slot
+				if(!hasFrameSpace()) {
+					return STEP_NEED_SPACE;
+				}
+				std::unique_lock<std::mutex> codecLocker(codecMutex, std::defer_lock);
+				lockCounted(codecLocker, decoderLockWaiting);
+				if(!hasFrameSpace()) { //the ring was resized meanwhile
+					return STEP_NEED_SPACE;
+				}
+				publishDecodedFrame(codecLocker);
+				return STEP_DONE;
+			}
+
+			bool fileEnded = endOfFile;
+			AVPacket* srcPacket = nullptr;
+			if(!packet.isEmpty()) {
+				srcPacket = packet.front().getPtr();
+			}else if(!fileEnded) {
+				return STEP_NEED_PACKET;
+			}
+
+			std::unique_lock<std::mutex> codecLocker(codecMutex, std::defer_lock);
+			lockCounted(codecLocker, decoderLockWaiting);
+			int result = 0;
+			int64_t decodingStart = AVCounter::now();
+			if(srcPacket) {
+				//in low latency mode under backpressure decode only what later frames depend on
+				codecContext->skip_frame = lowLatency && frame.count() >= frame.size() / 2 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+				result = avcodec_send_packet(codecContext, srcPacket);
+				poppedPacketBytes.add(static_cast<uint64_t>(srcPacket->size));
+				packet.front().unrefPtr();
+				packet.pop();
+				decodedPackets.add(1);
+				if(result != 0) {
+					decodingTime.add(static_cast<uint64_t>(AVCounter::now() - decodingStart));
+					return STEP_DONE;
+				}
+			}else if(!codecDrained) { //then one frame per step until the codec reports its end
+				avcodec_send_packet(codecContext, nullptr);
+				codecDrained = true;
+			}
+			result = avcodec_receive_frame(codecContext, frameforDecoding);
+			decodingTime.add(static_cast<uint64_t>(AVCounter::now() - decodingStart));
+			if(result == 0) {
+				decodedFrames.add(1);
+				int64_t dropBefore = dropBeforePts;
+				if(dropBefore != AV_NOPTS_VALUE) {
+					int64_t pts = frameforDecoding->pts != AV_NOPTS_VALUE ? frameforDecoding->pts : frameforDecoding->pkt_dts;
+					if(pts != AV_NOPTS_VALUE && pts < dropBefore) { //only decoded to reach the seek target
+						av_frame_unref(frameforDecoding);
+						skippedFrames.add(1);
+						return STEP_DONE;
+					}
+					dropBeforePts = AV_NOPTS_VALUE;
+				}
+				frameDecoded = true;
+				if(hasFrameSpace()) { //don't keep codecContext locked while the consumer is behind
+					publishDecodedFrame(codecLocker);
+				}
+			}else if(result != AVERROR(EAGAIN) || codecDrained) {
+				return handleEndOfFile(codecLocker);
+			}
+			return STEP_DONE;
+		}
+
+		void publishDecodedFrame(std::unique_lock<std::mutex>& codecLocker) {
+			int64_t convertingStart = AVCounter::now();
+			AVFrame* dest = backFrame();
+			bool converted = dest != nullptr && convertFrame(dest, frameforDecoding);
+			convertingTime.add(static_cast<uint64_t>(AVCounter::now() - convertingStart));
+			if(converted) {
+				frame.back().published();
+				frame.back().markPtrHowReferenced();
+				frame.push();
+			}
+			codecLocker.unlock();
+			av_frame_unref(frameforDecoding);
+			frameDecoded = false;
+		}
+
+		AVFrame* backFrame() {
+			if(frame.back().getPtr() == nullptr) {
+				frame.back().setUnreferencedPtr(av_frame_alloc());
+			}
+			return frame.back().getPtr();
+		}
+
+		virtual bool hasFrameSpace() override { //by the decoding thread or task only
+			return !frame.isFull();
+		}
+
+		virtual void resizeFrameRing() { //with codecMutex and frameMutex held or the decoder stopped
+			unsigned int slots = slotsForDepth(framesDepthMs, defaultFramesSlots, minFramesSlots, maxFramesSlots);
+			size_t bytes = frameBytes();
+			if(memoryBudget && bytes > 0) {
+				budgetReservation = memoryBudget->reserve(budgetReservation, slots * bytes, minFramesSlots * bytes);
+				slots = static_cast<unsigned int>(budgetReservation / bytes);
+			}
+			if(slots <= frame.count()) { //the queued frames stay
+				slots = frame.count() + 1;
+			}
+			frame.resize(slots);
+			framesRingBytes = static_cast<uint64_t>(frame.size()) * bytes;
+		}
+
+		virtual void dropQueuedFrames() { //by flush, with codecMutex and frameMutex held
+			for(auto& frameContainer : frame) {
+				frameContainer.unrefPtr();
+			}
+		}
+};
+
+#endif // AVFRAMEDECODER_H
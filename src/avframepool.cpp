@@ -0,0 +1,112 @@
+#include "avframepool.h"
+
+AVFramePool::~AVFramePool() {
+	trim();
+}
+
+int AVFramePool::allocImage(uint8_t* pointers[4], int linesizes[4], int width, int height, AVPixelFormat format) {
+	int size = av_image_get_buffer_size(format, width, height, 32);
+	if(size < 0) {
+		return size;
+	}
+	unsigned int sizeClass = findClass(static_cast<size_t>(size) + headerSize);
+	if(sizeClass >= classesCount) {
+		return AVERROR(ENOMEM);
+	}
+
+	BufferHeader* header = nullptr;
+	std::unique_lock<std::mutex> poolLocker(poolMutex);
+	for(unsigned int i = sizeClass; i < sizeClass + reuseClasses && i < classesCount; ++ i) {
+		if(freeBuffers[i] != nullptr) {
+			header = freeBuffers[i];
+			freeBuffers[i] = header->next;
+			++ stats.reuses;
+			-- stats.cachedBuffers;
+			stats.cachedBytes -= classSize(i);
+			break;
+		}
+	}
+	if(header == nullptr) {
+		poolLocker.unlock();
+		header = static_cast<BufferHeader*>(av_malloc(classSize(sizeClass)));
+		if(header == nullptr) {
+			return AVERROR(ENOMEM);
+		}
+		header->sizeClass = sizeClass;
+		poolLocker.lock();
+		++ stats.allocations;
+	}
+	++ stats.usedBuffers;
+	poolLocker.unlock();
+
+	header->next = nullptr;
+	header->owner = this;
+	uint8_t* buffer = reinterpret_cast<uint8_t*>(header) + headerSize;
+	int result = av_image_fill_arrays(pointers, linesizes, buffer, format, width, height, 32);
+	if(result < 0) {
+		uint8_t* taken[4] = {buffer, nullptr, nullptr, nullptr};
+		freeImage(taken);
+	}
+	return result;
+}
+
+void AVFramePool::freeImage(uint8_t* pointers[4]) {
+	if(pointers[0] == nullptr) {
+		return;
+	}
+	BufferHeader* header = reinterpret_cast<BufferHeader*>(pointers[0] - headerSize);
+	for(unsigned int i = 0; i < 4; ++ i) {
+		pointers[i] = nullptr;
+	}
+	std::lock_guard<std::mutex> poolLocker(poolMutex);
+	header->next = freeBuffers[header->sizeClass];
+	freeBuffers[header->sizeClass] = header;
+	-- stats.usedBuffers;
+	++ stats.cachedBuffers;
+	stats.cachedBytes += classSize(header->sizeClass);
+}
+
+void AVFramePool::releaseImage(uint8_t* pointers[4]) {
+	if(pointers[0] == nullptr) {
+		return;
+	}
+	reinterpret_cast<BufferHeader*>(pointers[0] - headerSize)->owner->freeImage(pointers);
+}
+
+void AVFramePool::trim() {
+	std::unique_lock<std::mutex> poolLocker(poolMutex);
+	BufferHeader* buffers[classesCount];
+	for(unsigned int i = 0; i < classesCount; ++ i) {
+		buffers[i] = freeBuffers[i];
+		freeBuffers[i] = nullptr;
+	}
+	stats.cachedBuffers = 0;
+	stats.cachedBytes = 0;
+	poolLocker.unlock();
+
+	for(unsigned int i = 0; i < classesCount; ++ i) {
+		while(buffers[i] != nullptr) {
+			BufferHeader* next = buffers[i]->next;
+			av_free(buffers[i]);
+			buffers[i] = next;
+		}
+	}
+}
+
+AVFramePool::Stats AVFramePool::getStats() {
+	std::lock_guard<std::mutex> poolLocker(poolMutex);
+	return stats;
+}
+
+size_t AVFramePool::classSize(unsigned int sizeClass) {
+	size_t base = minClassSize << (sizeClass / 4);
+	return base + base / 4 * (sizeClass % 4);
+}
+
+unsigned int AVFramePool::findClass(size_t size) {
+	unsigned int sizeClass = 0;
+	while(sizeClass < classesCount && classSize(sizeClass) < size) {
+		++ sizeClass;
+	}
+	return sizeClass;
+}
@@ -0,0 +1,54 @@
+#ifndef AVFRAMEPOOL_H
+#define AVFRAMEPOOL_H
+
+extern "C" {
+	#include <libavutil/imgutils.h>
+	#include <libavutil/mem.h>
+}
+
+#include <cstdint>
+#include <mutex>
+
+//Image buffers for converted frames, taken and returned like av_image_alloc/av_freep.
+//Freed buffers are kept in size classes a quarter of a power of two apart,
+//so decoding at a steady size and resizing back and forth don't touch the heap.
+class AVFramePool {
+	public:
+		struct Stats {
+			uint64_t allocations = 0; //buffers taken from the heap
+			uint64_t reuses = 0; //buffers taken from the pool
+			uint64_t usedBuffers = 0;
+			uint64_t cachedBuffers = 0;
+			uint64_t cachedBytes = 0;
+		};
+
+		AVFramePool() = default;
+		AVFramePool(const AVFramePool&) = delete;
+		AVFramePool& operator = (const AVFramePool&) = delete;
+		~AVFramePool();
+		int allocImage(uint8_t* pointers[4], int linesizes[4], int width, int height, AVPixelFormat format);
+		void freeImage(uint8_t* pointers[4]); //only for images from allocImage, null pointers are ignored
+		static void releaseImage(uint8_t* pointers[4]); //freeImage on the pool the image came from
+		void trim(); //frees the cached buffers
+		Stats getStats();
+
+	private:
+		struct BufferHeader {
+			BufferHeader* next;
+			AVFramePool* owner;
+			unsigned int sizeClass;
+		};
+		static const size_t headerSize = 64; //keeps the image aligned for SIMD
+		static const size_t minClassSize = 4096;
+		static const unsigned int classesCount = 4 * 36;
+		static const unsigned int reuseClasses = 4; //a buffer up to twice the size is used before allocating
+
+		std::mutex poolMutex;
+		BufferHeader* freeBuffers[classesCount] = {};
+		Stats stats;
+
+		static size_t classSize(unsigned int sizeClass);
+		static unsigned int findClass(size_t size);
+};
+
+#endif // AVFRAMEPOOL_H
@@ -0,0 +1,168 @@
+#include "avioreactor.h"
+#include "avfilecontext.h"
+#include "avfiber.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+	#include <sys/epoll.h>
+	#include <unistd.h>
+#endif
+
+AVIOReactor::AVIOReactor(unsigned int threadsCount) {
+	if(!isSupported()) return;
+	if(threadsCount == 0) {
+		threadsCount = 1;
+	}
+	for(unsigned int i = 0; i < threadsCount; ++ i) {
+		std::unique_ptr<DemuxThread> demuxThread(new DemuxThread);
+#ifdef __linux__
+		demuxThread->epollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+		if(demuxThread->epollFd < 0) {
+			continue;
+		}
+		threads.push_back(std::move(demuxThread));
+	}
+	for(auto& demuxThread : threads) {
+		demuxThread->thread = std::thread(&AVIOReactor::demuxing, this, demuxThread.get());
+	}
+}
+
+AVIOReactor::~AVIOReactor() {
+	stopping = true;
+	for(auto& demuxThread : threads) {
+		if(demuxThread->thread.joinable()) {
+			demuxThread->thread.join();
+		}
+#ifdef __linux__
+		close(demuxThread->epollFd);
+#endif
+	}
+}
+
+bool AVIOReactor::isSupported() {
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool AVIOReactor::addStream(AVfileContext* fileContext) {
+#ifdef __linux__
+	if(threads.empty() || !fileContext->socketSource) return false;
+	DemuxThread* leastLoaded = nullptr;
+	size_t leastStreams = 0;
+	for(auto& demuxThread : threads) {
+		std::lock_guard<std::mutex> streamsLocker(demuxThread->streamsMutex);
+		if(leastLoaded == nullptr || demuxThread->streams.size() < leastStreams) {
+			leastLoaded = demuxThread.get();
+			leastStreams = demuxThread->streams.size();
+		}
+	}
+	std::lock_guard<std::mutex> streamsLocker(leastLoaded->streamsMutex);
+	epoll_event event;
+	event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = fileContext;
+	if(epoll_ctl(leastLoaded->epollFd, EPOLL_CTL_ADD, fileContext->socketSource->getSocket(), &event) != 0) {
+		return false;
+	}
+	leastLoaded->streams.push_back(fileContext);
+	return true;
+#else
+	(void)fileContext;
+	return false;
+#endif
+}
+
+void AVIOReactor::removeStream(AVfileContext* fileContext) {
+	for(auto& demuxThread : threads) {
+		std::unique_lock<std::mutex> streamsLocker(demuxThread->streamsMutex);
+		demuxThread->streamsCond.wait(streamsLocker, [&]() {
+			return std::find(demuxThread->streams.begin(), demuxThread->streams.end(), fileContext) == demuxThread->streams.end();
+		});
+	}
+}
+
+std::vector<AVIOReactor::ThreadStats> AVIOReactor::getStats() {
+	std::vector<ThreadStats> stats;
+	for(auto& demuxThread : threads) {
+		ThreadStats threadStats;
+		std::unique_lock<std::mutex> streamsLocker(demuxThread->streamsMutex);
+		threadStats.streams = static_cast<unsigned int>(demuxThread->streams.size());
+		streamsLocker.unlock();
+		threadStats.loops = demuxThread->loops;
+		if(threadStats.loops > 0) {
+			threadStats.averageLoopLatency = demuxThread->loopLatencySum / static_cast<int64_t>(threadStats.loops);
+		}
+		threadStats.maxLoopLatency = demuxThread->maxLoopLatency;
+		stats.push_back(threadStats);
+	}
+	return stats;
+}
+
+void AVIOReactor::demuxing(DemuxThread* demuxThread) {
+#ifdef __linux__
+	static const int maxEvents = 64;
+	epoll_event events[maxEvents];
+	std::vector<AVfileContext*> serviced;
+	while(!stopping) {
+		int eventsCount = epoll_wait(demuxThread->epollFd, events, maxEvents, pollPeriod);
+		int64_t loopStart = av_gettime_relative();
+		std::unique_lock<std::mutex> streamsLocker(demuxThread->streamsMutex);
+		serviced.clear();
+		for(int i = 0; i < eventsCount; ++ i) {
+			AVfileContext* fileContext = static_cast<AVfileContext*>(events[i].data.ptr);
+			if(std::find(demuxThread->streams.begin(), demuxThread->streams.end(), fileContext) != demuxThread->streams.end()) {
+				serviced.push_back(fileContext);
+			}
+		}
+		for(AVfileContext* fileContext : demuxThread->streams) { //not waiting for its socket: started, stopping, its decoder has space or the wait expired
+			if(fileContext->hasPendingInput(loopStart)
+			 && std::find(serviced.begin(), serviced.end(), fileContext) == serviced.end()) {
+				serviced.push_back(fileContext);
+			}
+		}
+		streamsLocker.unlock(); //only this thread removes its streams, the pointers stay valid
+		if(serviced.empty()) {
+			continue;
+		}
+		for(AVfileContext* fileContext : serviced) {
+			if(!fileContext->demuxFiber->resume()) {
+				finishStream(demuxThread, fileContext);
+			}
+		}
+		int64_t latency = av_gettime_relative() - loopStart;
+		++ demuxThread->loops;
+		demuxThread->loopLatencySum += latency;
+		if(latency > demuxThread->maxLoopLatency) {
+			demuxThread->maxLoopLatency = latency;
+		}
+	}
+	std::unique_lock<std::mutex> streamsLocker(demuxThread->streamsMutex);
+	serviced = demuxThread->streams;
+	streamsLocker.unlock();
+	for(AVfileContext* fileContext : serviced) { //the fibers must not be dropped in the middle of av_read_frame
+		fileContext->socketSource->abort();
+		while(fileContext->demuxFiber->resume()) {
+		}
+		finishStream(demuxThread, fileContext);
+	}
+#else
+	(void)demuxThread;
+#endif
+}
+
+void AVIOReactor::finishStream(DemuxThread* demuxThread, AVfileContext* fileContext) {
+	fileContext->readingFinished();
+	std::lock_guard<std::mutex> streamsLocker(demuxThread->streamsMutex);
+#ifdef __linux__
+	epoll_ctl(demuxThread->epollFd, EPOLL_CTL_DEL, fileContext->socketSource->getSocket(), nullptr);
+#endif
+	auto it = std::find(demuxThread->streams.begin(), demuxThread->streams.end(), fileContext);
+	if(it != demuxThread->streams.end()) {
+		demuxThread->streams.erase(it);
+	}
+	demuxThread->streamsCond.notify_all();
+}
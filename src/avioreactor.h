@@ -0,0 +1,56 @@
+#ifndef AVIOREACTOR_H
+#define AVIOREACTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+class AVfileContext;
+
+//A few demux threads shared by many network streams opened through AVSocketSource.
+//Each stream demuxes on its own fiber, which yields whenever its socket or its decoder has to be waited for.
+//A thread waits on epoll for all of its sockets and resumes only the fibers that can go on,
+//so the thread count doesn't grow with the streams and a slow source doesn't hold up the others.
+class AVIOReactor {
+	public:
+		struct ThreadStats {
+			unsigned int streams = 0;
+			uint64_t loops = 0;
+			int64_t averageLoopLatency = 0; //microseconds spent servicing ready streams per wakeup
+			int64_t maxLoopLatency = 0;
+		};
+
+		explicit AVIOReactor(unsigned int threadsCount = 1);
+		AVIOReactor(const AVIOReactor&) = delete;
+		AVIOReactor& operator = (const AVIOReactor&) = delete;
+		~AVIOReactor();
+		static bool isSupported();
+		bool addStream(AVfileContext* fileContext);
+		void removeStream(AVfileContext* fileContext); //waits until the stream's fiber has finished, abort its socket source first
+		std::vector<ThreadStats> getStats();
+
+	private:
+		struct DemuxThread {
+			std::thread thread;
+			int epollFd = -1;
+			std::mutex streamsMutex; //not held while a fiber runs
+			std::condition_variable streamsCond;
+			std::vector<AVfileContext*> streams;
+			std::atomic<uint64_t> loops = {0};
+			std::atomic<int64_t> loopLatencySum = {0};
+			std::atomic<int64_t> maxLoopLatency = {0};
+		};
+		static const int pollPeriod = 10; //milliseconds, also how often streams waiting for a decoder are retried
+
+		std::vector<std::unique_ptr<DemuxThread>> threads;
+		std::atomic<bool> stopping = {false};
+
+		void demuxing(DemuxThread* demuxThread);
+		void finishStream(DemuxThread* demuxThread, AVfileContext* fileContext);
+};
+
+#endif // AVIOREACTOR_H
@@ -1,54 +1,43 @@
 #ifndef AVITEMCONTAINER_H
 #define AVITEMCONTAINER_H
 
-template<class ItemType, class DeleterType, class UnreferencerType, class DoSomethingType>
+//A slot owning one item and knowing if it holds a reference.
+//The deleter, the unreferencer and the publish hook are stateless policy types called on the item,
+//so they are inlined and a ring of slots is a compact array of a pointer and a flag each.
+struct AVNoPublishHook {
+	template<class ItemType>
+	void operator () (ItemType*) const {}
+};
+
+template<class ItemType, class Deleter, class Unreferencer, class PublishHook = AVNoPublishHook>
 class AVItemContainer {
 	public:
-		AVItemContainer() {
-			item = nullptr;
-			deleteItem = nullptr;
-			unreferenceItem = nullptr;
-			doSomethingWithItem = nullptr;
-		}
+		AVItemContainer() = default;
 		AVItemContainer(const AVItemContainer&) = delete;
 		AVItemContainer& operator = (const AVItemContainer&) = delete;
 		AVItemContainer(AVItemContainer&& other) {
 			item = other.item;
-			deleteItem = other.deleteItem;
-			unreferenceItem = other.unreferenceItem;
 			itemReferenced = other.itemReferenced;
-			doSomethingWithItem = other.doSomethingWithItem;
 			other.item = nullptr;
-			other.deleteItem = nullptr;
-			other.unreferenceItem = nullptr;
 			other.itemReferenced = false;
-			other.doSomethingWithItem = nullptr;
 		}
 		AVItemContainer& operator = (AVItemContainer&& other) {
 			if(this == &other) return *this;
 			resetPtr();
 			item = other.item;
-			deleteItem = other.deleteItem;
-			unreferenceItem = other.unreferenceItem;
 			itemReferenced = other.itemReferenced;
-			doSomethingWithItem = other.doSomethingWithItem;
 			other.item = nullptr;
-			other.deleteItem = nullptr;
-			other.unreferenceItem = nullptr;
 			other.itemReferenced = false;
-			other.doSomethingWithItem = nullptr;
+			return *this;
 		}
 
 		~AVItemContainer() {
-			if(item != nullptr) {
-				if(itemReferenced) unreferenceItem(item);
-				deleteItem(item);
-			}
+			resetPtr();
 		}
 		void unrefPtr() {
 			if(item != nullptr) {
 				if(itemReferenced) {
-					unreferenceItem(item);
+					Unreferencer()(item);
 					itemReferenced = false;
 				}
 			}
@@ -56,10 +45,10 @@ class AVItemContainer {
 		void resetPtr() {
 			if(item != nullptr) {
 				if(itemReferenced) {
-					unreferenceItem(item);
+					Unreferencer()(item);
 					itemReferenced = false;
 				}
-				deleteItem(item);
+				Deleter()(item);
 				item = nullptr;
 			}
 		}
@@ -73,29 +62,11 @@ class AVItemContainer {
 			itemReferenced = false;
 			return true;
 		}
-		void doSomething() {
-			if(item != nullptr && doSomethingWithItem != nullptr) {
-				doSomethingWithItem(item);
+		void published() { //the producer filled the item and is about to push it
+			if(item != nullptr) {
+				PublishHook()(item);
 			}
 		}
-		void setDeleter(DeleterType deleter) {
-			deleteItem = deleter;
-		}
-		void setUnreferencer(UnreferencerType unreferencer) {
-			unreferenceItem = unreferencer;
-		}
-		void setDoSomething(DoSomethingType doSomethingfnc) {
-			doSomethingWithItem = doSomethingfnc;
-		}
-		bool hasDeleter() {
-			return deleteItem != nullptr;
-		}
-		bool hasUnreferencer() {
-			return unreferenceItem != nullptr;
-		}
-		bool hasDoSomething() {
-			return doSomethingWithItem != nullptr;
-		}
 		ItemType* getPtr() {
 			return item;
 		}
@@ -104,25 +75,21 @@ class AVItemContainer {
 		}
 		void setUnreferencedPtr(ItemType* newItem) {
 			if(item == newItem) return;
-			if(item != nullptr) {
-				if(itemReferenced) {
-					unreferenceItem(item);
-					itemReferenced = false;
-				}
-				deleteItem(item);
-			}
+			resetPtr();
 			item = newItem;
 		}
 		void setReferencedPtr(ItemType* newItem) {
 			setUnreferencedPtr(newItem);
 			itemReferenced = true;
 		}
+		ItemType* takePtr() { //the caller becomes the owner of the item
+			ItemType* takenItem = item;
+			item = nullptr;
+			itemReferenced = false;
+			return takenItem;
+		}
 	private:
 		ItemType* item = nullptr;
-		DeleterType deleteItem = nullptr;
-		UnreferencerType unreferenceItem = nullptr;
-		DoSomethingType doSomethingWithItem = nullptr;
-
 		bool itemReferenced = false;
 };
 
@@ -0,0 +1,45 @@
+#include "avmemorybudget.h"
+
+AVMemoryBudget::AVMemoryBudget(size_t limit):
+	limit(limit)
+{
+
+}
+
+void AVMemoryBudget::setLimit(size_t limit) {
+	std::lock_guard<std::mutex> budgetLocker(budgetMutex);
+	this->limit = limit;
+}
+
+size_t AVMemoryBudget::reserve(size_t reservedBytes, size_t wantedBytes, size_t minimumBytes) {
+	std::lock_guard<std::mutex> budgetLocker(budgetMutex);
+	reserved -= reservedBytes;
+	size_t granted = wantedBytes;
+	if(limit > 0) {
+		size_t available = limit > reserved ? limit - reserved : 0;
+		if(granted > available) {
+			granted = available > minimumBytes ? available : minimumBytes;
+			if(granted < wantedBytes) {
+				++ cutReservations;
+			}else {
+				granted = wantedBytes;
+			}
+		}
+	}
+	reserved += granted;
+	return granted;
+}
+
+void AVMemoryBudget::release(size_t reservedBytes) {
+	std::lock_guard<std::mutex> budgetLocker(budgetMutex);
+	reserved -= reservedBytes;
+}
+
+AVMemoryBudget::Stats AVMemoryBudget::getStats() {
+	std::lock_guard<std::mutex> budgetLocker(budgetMutex);
+	Stats stats;
+	stats.limit = limit;
+	stats.reserved = reserved;
+	stats.cutReservations = cutReservations;
+	return stats;
+}
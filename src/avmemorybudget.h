@@ -0,0 +1,35 @@
+#ifndef AVMEMORYBUDGET_H
+#define AVMEMORYBUDGET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+//Bytes the frame rings of many decoders may reserve together.
+//Every decoder keeps one reservation and changes it when its ring or its frame size changes,
+//a decoder always gets its minimum so it can make progress, even past the limit.
+class AVMemoryBudget {
+	public:
+		struct Stats {
+			uint64_t limit = 0; //0 means unlimited
+			uint64_t reserved = 0;
+			uint64_t cutReservations = 0; //reservations granted less than wanted
+		};
+
+		explicit AVMemoryBudget(size_t limit = 0);
+		AVMemoryBudget(const AVMemoryBudget&) = delete;
+		AVMemoryBudget& operator = (const AVMemoryBudget&) = delete;
+		void setLimit(size_t limit); //the reservations already made are kept
+		//replaces the reservation of reservedBytes by up to wantedBytes, returns the new reservation
+		size_t reserve(size_t reservedBytes, size_t wantedBytes, size_t minimumBytes);
+		void release(size_t reservedBytes);
+		Stats getStats();
+
+	private:
+		std::mutex budgetMutex;
+		size_t limit = 0;
+		size_t reserved = 0;
+		uint64_t cutReservations = 0;
+};
+
+#endif // AVMEMORYBUDGET_H
@@ -0,0 +1,169 @@
+#include "avpcmring.h"
+
+#include <cstring>
+
+#if defined(__linux__)
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#if defined(SYS_memfd_create)
+		#define AVPCMRING_MIRROR
+	#endif
+#endif
+
+AVPcmRing::~AVPcmRing() {
+	unmap(buffer, bufferSize, mirrored);
+}
+
+bool AVPcmRing::resize(size_t minCapacity) {
+	size_t size = 4096;
+#ifdef AVPCMRING_MIRROR
+	long pageSize = sysconf(_SC_PAGESIZE);
+	if(pageSize > 0 && static_cast<size_t>(pageSize) > size) {
+		size = static_cast<size_t>(pageSize);
+	}
+#endif
+	size_t queued = readable();
+	while(size < minCapacity || size < queued) {
+		size *= 2;
+	}
+	if(size == bufferSize) {
+		return true;
+	}
+	bool newMirrored = false;
+	uint8_t* newBuffer = map(size, newMirrored);
+	if(newBuffer == nullptr) {
+		return false;
+	}
+	size_t taken = read(newBuffer, queued); //the queued bytes move to the start
+	unmap(buffer, bufferSize, mirrored);
+	buffer = newBuffer;
+	bufferSize = size;
+	mirrored = newMirrored;
+	readPos.store(0, std::memory_order_relaxed);
+	writePos.store(taken, std::memory_order_release);
+	return true;
+}
+
+size_t AVPcmRing::capacity() const {
+	return bufferSize;
+}
+
+bool AVPcmRing::isMirrored() const {
+	return mirrored;
+}
+
+size_t AVPcmRing::readable() const {
+	return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire);
+}
+
+size_t AVPcmRing::writable() const {
+	return bufferSize - readable();
+}
+
+void AVPcmRing::clear() {
+	readPos.store(0, std::memory_order_relaxed);
+	writePos.store(0, std::memory_order_release);
+}
+
+uint8_t* AVPcmRing::writePointer(size_t& contiguous) {
+	size_t position = writePos.load(std::memory_order_relaxed);
+	size_t offset = position & (bufferSize - 1);
+	contiguous = bufferSize - (position - readPos.load(std::memory_order_acquire));
+	if(!mirrored && contiguous > bufferSize - offset) {
+		contiguous = bufferSize - offset;
+	}
+	return buffer + offset;
+}
+
+void AVPcmRing::commit(size_t size) {
+	writePos.store(writePos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+size_t AVPcmRing::write(const uint8_t* data, size_t size) {
+	size_t written = 0;
+	while(written < size) {
+		size_t contiguous = 0;
+		uint8_t* destination = writePointer(contiguous);
+		if(contiguous == 0) {
+			break;
+		}
+		size_t part = size - written < contiguous ? size - written : contiguous;
+		memcpy(destination, data + written, part);
+		commit(part);
+		written += part;
+	}
+	return written;
+}
+
+const uint8_t* AVPcmRing::readPointer(size_t& contiguous) {
+	size_t position = readPos.load(std::memory_order_relaxed);
+	size_t offset = position & (bufferSize - 1);
+	contiguous = writePos.load(std::memory_order_acquire) - position;
+	if(!mirrored && contiguous > bufferSize - offset) {
+		contiguous = bufferSize - offset;
+	}
+	return buffer + offset;
+}
+
+void AVPcmRing::consume(size_t size) {
+	readPos.store(readPos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+size_t AVPcmRing::read(uint8_t* data, size_t size) {
+	size_t taken = 0;
+	while(taken < size) {
+		size_t contiguous = 0;
+		const uint8_t* source = readPointer(contiguous);
+		if(contiguous == 0) {
+			break;
+		}
+		size_t part = size - taken < contiguous ? size - taken : contiguous;
+		memcpy(data + taken, source, part);
+		consume(part);
+		taken += part;
+	}
+	return taken;
+}
+
+uint8_t* AVPcmRing::map(size_t size, bool& mirrored) {
+#ifdef AVPCMRING_MIRROR
+	//a memory file mapped twice into one reserved range, the second view continues the first
+	int memoryFile = static_cast<int>(syscall(SYS_memfd_create, "avpcmring", 1u)); //MFD_CLOEXEC
+	if(memoryFile >= 0) {
+		void* range = MAP_FAILED;
+		if(ftruncate(memoryFile, static_cast<off_t>(size)) == 0) {
+			range = mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		}
+		if(range != MAP_FAILED) {
+			uint8_t* first = static_cast<uint8_t*>(range);
+			if(mmap(first, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memoryFile, 0) != MAP_FAILED
+			 && mmap(first + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memoryFile, 0) != MAP_FAILED) {
+				close(memoryFile);
+				mirrored = true;
+				return first;
+			}
+			munmap(range, size * 2);
+		}
+		close(memoryFile);
+	}
+#endif
+	mirrored = false;
+	return static_cast<uint8_t*>(av_malloc(size));
+}
+
+void AVPcmRing::unmap(uint8_t* buffer, size_t size, bool mirrored) {
+	if(buffer == nullptr) {
+		return;
+	}
+#ifdef AVPCMRING_MIRROR
+	if(mirrored) {
+		munmap(buffer, size * 2);
+		return;
+	}
+#else
+	(void)size;
+	(void)mirrored;
+#endif
+	av_free(buffer);
+}
@@ -0,0 +1,55 @@
+#ifndef AVPCMRING_H
+#define AVPCMRING_H
+
+extern "C" {
+	#include <libavutil/mem.h>
+}
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//Single producer / single consumer byte ring for converted samples.
+//Where the system allows it the buffer is mapped twice back to back, so every read and write is contiguous,
+//elsewhere the pointers reach only to the end of the buffer and read()/write() copy in two parts.
+//The fill level is the difference of two atomic positions, each written by one side only.
+class AVPcmRing {
+	public:
+		AVPcmRing() = default;
+		AVPcmRing(const AVPcmRing&) = delete;
+		AVPcmRing& operator = (const AVPcmRing&) = delete;
+		~AVPcmRing();
+		//at least minCapacity bytes, keeps the queued ones, only while neither side runs or both are held off
+		bool resize(size_t minCapacity);
+		size_t capacity() const;
+		bool isMirrored() const;
+		size_t readable() const;
+		size_t writable() const;
+		void clear(); //only while neither side runs or both are held off
+
+		//producer side
+		uint8_t* writePointer(size_t& contiguous);
+		void commit(size_t size);
+		size_t write(const uint8_t* data, size_t size);
+
+		//consumer side
+		const uint8_t* readPointer(size_t& contiguous);
+		void consume(size_t size);
+		size_t read(uint8_t* data, size_t size);
+
+	private:
+		static const unsigned int cacheLineSize = 64;
+
+		uint8_t* buffer = nullptr;
+		size_t bufferSize = 0; //a power of two, the positions are taken modulo it
+		bool mirrored = false;
+		char readPadding[cacheLineSize];
+		std::atomic<size_t> readPos = {0};
+		char writePadding[cacheLineSize - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> writePos = {0};
+
+		static uint8_t* map(size_t size, bool& mirrored);
+		static void unmap(uint8_t* buffer, size_t size, bool mirrored);
+};
+
+#endif // AVPCMRING_H
@@ -0,0 +1,208 @@
+#include "avprobecache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+AVProbeCache::AVProbeCache(const std::string& cacheFile):
+	cacheFile(cacheFile)
+{
+	if(!cacheFile.empty()) {
+		load();
+	}
+}
+
+AVProbeCache::~AVProbeCache() {
+	save();
+}
+
+bool AVProbeCache::apply(const std::string& url, AVFormatContext* formatContext) {
+	std::string key = makeKey(url);
+	std::lock_guard<std::mutex> cacheLocker(cacheMutex);
+	auto it = entries.find(key);
+	bool valid = it != entries.end() && it->second.size() == formatContext->nb_streams;
+	for(unsigned int i = 0; valid && i < formatContext->nb_streams; ++ i) { //the input must still have the cached layout
+		const AVCodecParameters* cached = it->second[i].parameters.get();
+		const AVCodecParameters* opened = formatContext->streams[i]->codecpar;
+		valid = opened->codec_type == cached->codec_type
+				&& (opened->codec_id == AV_CODEC_ID_NONE || opened->codec_id == cached->codec_id);
+	}
+	if(!valid) {
+		++ stats.misses;
+		return false;
+	}
+	for(unsigned int i = 0; i < formatContext->nb_streams; ++ i) {
+		AVStream* stream = formatContext->streams[i];
+		const Stream& cached = it->second[i];
+		if(!isComplete(stream->codecpar) && avcodec_parameters_copy(stream->codecpar, cached.parameters.get()) < 0) {
+			++ stats.misses;
+			return false;
+		}
+		if(stream->avg_frame_rate.num <= 0 || stream->avg_frame_rate.den <= 0) { //else the decoders size their rings for 25 fps
+			stream->avg_frame_rate = cached.avgFrameRate;
+		}
+		if(stream->r_frame_rate.num <= 0 || stream->r_frame_rate.den <= 0) {
+			stream->r_frame_rate = cached.rFrameRate;
+		}
+	}
+	++ stats.hits;
+	return true;
+}
+
+void AVProbeCache::store(const std::string& url, const AVFormatContext* formatContext) {
+	Entry entry;
+	for(unsigned int i = 0; i < formatContext->nb_streams; ++ i) {
+		const AVStream* stream = formatContext->streams[i];
+		Parameters parameters = newParameters();
+		if(!parameters || avcodec_parameters_copy(parameters.get(), stream->codecpar) < 0) {
+			return;
+		}
+		entry.push_back(Stream{std::move(parameters), stream->avg_frame_rate, stream->r_frame_rate});
+	}
+	std::string key = makeKey(url);
+	std::lock_guard<std::mutex> cacheLocker(cacheMutex);
+	entries[key] = std::move(entry);
+	changed = true;
+}
+
+bool AVProbeCache::save() {
+	std::lock_guard<std::mutex> cacheLocker(cacheMutex);
+	if(cacheFile.empty() || !changed) {
+		return true;
+	}
+	std::string tempFile = cacheFile + ".tmp";
+	std::ofstream out(tempFile, std::ios::trunc);
+	if(!out) {
+		return false;
+	}
+	for(auto& entry : entries) {
+		out << "entry " << entry.second.size() << ' ' << entry.first << '\n';
+		for(auto& stream : entry.second) {
+			const AVCodecParameters* p = stream.parameters.get();
+			out << p->codec_type << ' ' << p->codec_id << ' ' << p->codec_tag << ' ' << p->format << ' ' << p->bit_rate << ' '
+				<< p->width << ' ' << p->height << ' ' << p->sample_aspect_ratio.num << ' ' << p->sample_aspect_ratio.den << ' '
+				<< p->channel_layout << ' ' << p->channels << ' ' << p->sample_rate << ' ' << p->frame_size << ' '
+				<< stream.avgFrameRate.num << ' ' << stream.avgFrameRate.den << ' ' << stream.rFrameRate.num << ' ' << stream.rFrameRate.den << ' ';
+			if(p->extradata_size > 0) {
+				static const char hex[] = "0123456789abcdef";
+				for(int i = 0; i < p->extradata_size; ++ i) {
+					out << hex[p->extradata[i] >> 4] << hex[p->extradata[i] & 0x0f];
+				}
+			}else {
+				out << '-';
+			}
+			out << '\n';
+		}
+	}
+	out.close();
+	if(!out) {
+		std::remove(tempFile.c_str());
+		return false;
+	}
+	std::remove(cacheFile.c_str()); //rename doesn't replace on windows
+	if(std::rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+		return false;
+	}
+	changed = false;
+	return true;
+}
+
+AVProbeCache::Stats AVProbeCache::getStats() {
+	std::lock_guard<std::mutex> cacheLocker(cacheMutex);
+	stats.entries = entries.size();
+	return stats;
+}
+
+bool AVProbeCache::isComplete(const AVCodecParameters* parameters) {
+	if(parameters->codec_id == AV_CODEC_ID_NONE || parameters->format < 0) {
+		return false;
+	}
+	if(parameters->codec_type == AVMEDIA_TYPE_VIDEO) {
+		return parameters->width > 0 && parameters->height > 0;
+	}else if(parameters->codec_type == AVMEDIA_TYPE_AUDIO) {
+		return parameters->sample_rate > 0 && parameters->channels > 0;
+	}
+	return true;
+}
+
+std::string AVProbeCache::makeKey(const std::string& url) {
+	std::string path = url;
+	size_t schemeEnd = path.find("://");
+	if(path.compare(0, 5, "file:") == 0) {
+		path = path.substr(5);
+	}else if(schemeEnd != std::string::npos) {
+		size_t authorityStart = schemeEnd + 3;
+		size_t authorityEnd = path.find_first_of("/?#", authorityStart);
+		size_t userEnd = path.rfind('@', authorityEnd == std::string::npos ? std::string::npos : authorityEnd - 1);
+		if(userEnd != std::string::npos && userEnd >= authorityStart) { //the password must not end up in the cache file
+			path.erase(authorityStart, userEnd + 1 - authorityStart);
+		}
+		return path;
+	}
+	struct stat fileStat;
+	if(stat(path.c_str(), &fileStat) != 0) {
+		return url;
+	}
+	std::ostringstream key;
+	key << url << '|' << static_cast<int64_t>(fileStat.st_size) << '|' << static_cast<int64_t>(fileStat.st_mtime); //a changed file is a new key
+	return key.str();
+}
+
+AVProbeCache::Parameters AVProbeCache::newParameters() {
+	return Parameters(avcodec_parameters_alloc(), [](AVCodecParameters* parameters) {avcodec_parameters_free(&parameters);});
+}
+
+void AVProbeCache::load() {
+	std::ifstream in(cacheFile);
+	std::string line;
+	while(std::getline(in, line)) {
+		std::istringstream header(line);
+		std::string word;
+		size_t streamsCount = 0;
+		header >> word >> streamsCount;
+		if(word != "entry" || header.get() != ' ') {
+			return;
+		}
+		std::string key;
+		std::getline(header, key);
+
+		Entry entry;
+		for(size_t i = 0; i < streamsCount; ++ i) {
+			Parameters parameters = newParameters();
+			if(!parameters || !std::getline(in, line)) {
+				return;
+			}
+			AVCodecParameters* p = parameters.get();
+			std::istringstream fields(line);
+			int codecType = 0;
+			int codecId = 0;
+			AVRational avgFrameRate = {0, 1};
+			AVRational rFrameRate = {0, 1};
+			std::string extradata;
+			fields >> codecType >> codecId >> p->codec_tag >> p->format >> p->bit_rate
+				   >> p->width >> p->height >> p->sample_aspect_ratio.num >> p->sample_aspect_ratio.den
+				   >> p->channel_layout >> p->channels >> p->sample_rate >> p->frame_size
+				   >> avgFrameRate.num >> avgFrameRate.den >> rFrameRate.num >> rFrameRate.den >> extradata;
+			if(!fields) {
+				return;
+			}
+			p->codec_type = static_cast<AVMediaType>(codecType);
+			p->codec_id = static_cast<AVCodecID>(codecId);
+			if(extradata != "-" && extradata.size() % 2 == 0) {
+				size_t size = extradata.size() / 2;
+				p->extradata = static_cast<uint8_t*>(av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE));
+				if(p->extradata == nullptr) {
+					return;
+				}
+				for(size_t byte = 0; byte < size; ++ byte) {
+					p->extradata[byte] = static_cast<uint8_t>(std::strtol(extradata.substr(byte * 2, 2).c_str(), nullptr, 16));
+				}
+				p->extradata_size = static_cast<int>(size);
+			}
+			entry.push_back(Stream{std::move(parameters), avgFrameRate, rFrameRate});
+		}
+		entries[key] = std::move(entry);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef AVPROBECACHE_H
+#define AVPROBECACHE_H
+
+extern "C" {
+	#include <libavcodec/avcodec.h>
+	#include <libavformat/avformat.h>
+}
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Stream parameters and frame rates found by avformat_find_stream_info, keyed by the url without its user and password
+//(plus size and mtime for local files).
+//When the opened input still has the cached stream layout, the cached parameters replace the probing.
+//Optionally kept in a file between runs.
+class AVProbeCache {
+	public:
+		struct Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t entries = 0;
+		};
+
+		explicit AVProbeCache(const std::string& cacheFile = ""); //loads the file if it exists
+		AVProbeCache(const AVProbeCache&) = delete;
+		AVProbeCache& operator = (const AVProbeCache&) = delete;
+		~AVProbeCache(); //saves the file
+		bool apply(const std::string& url, AVFormatContext* formatContext); //false when probing is still needed
+		void store(const std::string& url, const AVFormatContext* formatContext);
+		bool save();
+		Stats getStats();
+		static bool isComplete(const AVCodecParameters* parameters);
+
+	private:
+		using Parameters = std::unique_ptr<AVCodecParameters, void(*)(AVCodecParameters*)>;
+		struct Stream {
+			Parameters parameters;
+			AVRational avgFrameRate; //kept by the stream, not the codec parameters, and only found by probing
+			AVRational rFrameRate;
+		};
+		using Entry = std::vector<Stream>;
+
+		std::string cacheFile;
+		std::mutex cacheMutex;
+		std::map<std::string, Entry> entries;
+		bool changed = false;
+		Stats stats;
+
+		static std::string makeKey(const std::string& url);
+		static Parameters newParameters();
+		void load();
+};
+
+#endif // AVPROBECACHE_H
@@ -0,0 +1,255 @@
+#include "avrecorder.h"
+
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+const AVRational timeBaseQ = {1, AV_TIME_BASE}; //AV_TIME_BASE_Q is a C compound literal
+
+}
+
+AVRecorder::~AVRecorder() {
+	stop();
+	setStreams(nullptr, nullptr);
+	av_packet_free(&outputPacket);
+}
+
+bool AVRecorder::start(const Parameters& parameters) {
+	std::unique_lock<std::mutex> locker(recorderMutex);
+	std::function<void(const std::string&)> segmentFinished = this->parameters.segmentFinished;
+	std::string finishedPath = finishSegment();
+	if(parameters.pathPrefix != this->parameters.pathPrefix) {
+		segmentNumber = 0;
+	}
+	this->parameters = parameters;
+	if(outputPacket == nullptr) {
+		outputPacket = av_packet_alloc();
+	}
+	recording = outputPacket != nullptr && !parameters.pathPrefix.empty() && parameters.segmentSeconds > 0;
+	bool result = recording;
+	locker.unlock();
+	if(!finishedPath.empty() && segmentFinished) {
+		segmentFinished(finishedPath);
+	}
+	return result;
+}
+
+void AVRecorder::stop() {
+	std::unique_lock<std::mutex> locker(recorderMutex);
+	std::function<void(const std::string&)> segmentFinished = parameters.segmentFinished;
+	std::string finishedPath = finishSegment();
+	recording = false;
+	locker.unlock();
+	if(!finishedPath.empty() && segmentFinished) {
+		segmentFinished(finishedPath);
+	}
+}
+
+bool AVRecorder::isRecording() {
+	return recording;
+}
+
+AVRecorder::Stats AVRecorder::getStats() {
+	std::lock_guard<std::mutex> locker(recorderMutex);
+	return stats;
+}
+
+void AVRecorder::setStreams(const AVStream* videoStream, const AVStream* audioStream) {
+	std::unique_lock<std::mutex> locker(recorderMutex);
+	std::function<void(const std::string&)> segmentFinished = parameters.segmentFinished;
+	std::string finishedPath = finishSegment(); //the timestamps of a reopened stream start over
+	const AVStream* streams[INPUTS_COUNT] = {videoStream, audioStream};
+	for(int i = 0; i < INPUTS_COUNT; ++ i) {
+		Input& input = inputs[i];
+		input.streamIndex = -1;
+		if(streams[i] == nullptr) {
+			avcodec_parameters_free(&input.parameters);
+			continue;
+		}
+		if(input.parameters == nullptr) {
+			input.parameters = avcodec_parameters_alloc();
+		}
+		if(input.parameters == nullptr || avcodec_parameters_copy(input.parameters, streams[i]->codecpar) < 0) { //the stream may go away before the next segment opens
+			avcodec_parameters_free(&input.parameters);
+			continue;
+		}
+		input.streamIndex = streams[i]->index;
+		input.timeBase = streams[i]->time_base;
+	}
+	locker.unlock();
+	if(!finishedPath.empty() && segmentFinished) {
+		segmentFinished(finishedPath);
+	}
+}
+
+void AVRecorder::cut() {
+	std::unique_lock<std::mutex> locker(recorderMutex);
+	std::function<void(const std::string&)> segmentFinished = parameters.segmentFinished;
+	std::string finishedPath = finishSegment();
+	locker.unlock();
+	if(!finishedPath.empty() && segmentFinished) {
+		segmentFinished(finishedPath);
+	}
+}
+
+void AVRecorder::write(const AVPacket* packet) {
+	if(!recording) {
+		return;
+	}
+	std::unique_lock<std::mutex> locker(recorderMutex);
+	int inputId = 0;
+	while(inputId < INPUTS_COUNT && (inputs[inputId].parameters == nullptr || inputs[inputId].streamIndex != packet->stream_index)) {
+		++ inputId;
+	}
+	if(!recording || inputId == INPUTS_COUNT) {
+		return;
+	}
+	const Input& input = inputs[inputId];
+	int64_t timestamp = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+	if(timestamp == AV_NOPTS_VALUE) {
+		++ stats.droppedPackets;
+		return;
+	}
+	timestamp = av_rescale_q(timestamp, input.timeBase, timeBaseQ);
+
+	std::string finishedPath;
+	bool segmentKeyframe = (packet->flags & AV_PKT_FLAG_KEY) && (inputId == VIDEO_INPUT || inputs[VIDEO_INPUT].parameters == nullptr);
+	if(segmentKeyframe) { //a jump back is a restarted source, it starts a new segment as well
+		int64_t segmentDuration = static_cast<int64_t>(parameters.segmentSeconds) * AV_TIME_BASE;
+		if(output == nullptr || timestamp < segmentStart || timestamp - segmentStart >= segmentDuration) {
+			finishedPath = finishSegment();
+			openSegment(timestamp);
+		}
+	}
+
+	if(output == nullptr || timestamp < segmentStart || input.outputIndex < 0) {
+		++ stats.droppedPackets;
+	}else if(av_packet_ref(outputPacket, packet) < 0) { //only a reference, the payload is not copied
+		++ stats.writeErrors;
+	}else {
+		AVStream* stream = output->streams[input.outputIndex];
+		int64_t start = av_rescale_q(segmentStart, timeBaseQ, input.timeBase);
+		if(outputPacket->pts != AV_NOPTS_VALUE) {
+			outputPacket->pts -= start;
+		}
+		if(outputPacket->dts != AV_NOPTS_VALUE) {
+			outputPacket->dts -= start;
+		}
+		outputPacket->stream_index = input.outputIndex;
+		outputPacket->pos = -1;
+		av_packet_rescale_ts(outputPacket, input.timeBase, stream->time_base);
+		int size = outputPacket->size;
+		if(av_interleaved_write_frame(output, outputPacket) < 0) {
+			++ stats.writeErrors;
+			if(output->pb && output->pb->error < 0) { //the disk is full or gone, the next keyframe tries a new file
+				std::string failedPath = finishSegment();
+				if(finishedPath.empty()) {
+					finishedPath = failedPath;
+				}
+			}
+		}else {
+			++ stats.packets;
+			stats.bytes += static_cast<uint64_t>(size);
+		}
+		av_packet_unref(outputPacket); //the muxer has taken the reference, unless it failed before
+	}
+
+	std::function<void(const std::string&)> segmentFinished = finishedPath.empty() ? nullptr : parameters.segmentFinished;
+	locker.unlock();
+	if(segmentFinished) {
+		segmentFinished(finishedPath);
+	}
+}
+
+bool AVRecorder::openSegment(int64_t start) {
+	char number[16];
+	snprintf(number, sizeof(number), "%06u", segmentNumber);
+	std::string path = parameters.pathPrefix + number + (parameters.container == MP4 ? ".mp4" : ".mkv");
+	AVDictionary* options = nullptr;
+	bool allRight = false;
+	bool fileOpened = false;
+	int temp = 0;
+	auto deleter = [&](int*) {
+		if(!allRight) {
+			if(output) {
+				if(output->pb) {avio_closep(&output->pb);}
+				avformat_free_context(output);
+				output = nullptr;
+			}
+			if(fileOpened) {
+				std::remove(path.c_str()); //no header, no player opens it
+			}
+			for(Input& input : inputs) {
+				input.outputIndex = -1;
+			}
+			++ stats.writeErrors;
+		}
+		if(options) {av_dict_free(&options);}
+	};
+	std::unique_ptr<int, decltype(deleter)> allCloser(&temp, deleter);
+
+	output = nullptr;
+	if(avformat_alloc_output_context2(&output, nullptr, parameters.container == MP4 ? "mp4" : "matroska", path.c_str()) < 0 || output == nullptr) {
+		return false;
+	}
+	int streamsCount = 0;
+	for(Input& input : inputs) {
+		input.outputIndex = -1;
+		if(input.parameters == nullptr) {
+			continue;
+		}
+		if(avformat_query_codec(output->oformat, input.parameters->codec_id, FF_COMPLIANCE_NORMAL) == 0) {
+			continue; //like the pcm_mulaw audio of many cameras in mp4, the other stream is still recorded
+		}
+		AVStream* stream = avformat_new_stream(output, nullptr);
+		if(stream == nullptr || avcodec_parameters_copy(stream->codecpar, input.parameters) < 0) {
+			return false;
+		}
+		stream->codecpar->codec_tag = 0; //a tag of the source container can mean another codec in this one
+		stream->time_base = input.timeBase; //only a hint, avformat_write_header sets the one of the muxer
+		input.outputIndex = stream->index;
+		++ streamsCount;
+	}
+	if(streamsCount == 0) {
+		return false;
+	}
+	if(!(output->oformat->flags & AVFMT_NOFILE)) {
+		if(avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) {
+			return false;
+		}
+		fileOpened = true;
+	}
+	if(parameters.container == MP4) {
+		av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+	}
+	if(avformat_write_header(output, &options) < 0) {
+		return false;
+	}
+	segmentPath = path;
+	segmentStart = start;
+	++ segmentNumber;
+	++ stats.segments;
+	allRight = true;
+	return true;
+}
+
+std::string AVRecorder::finishSegment() {
+	if(output == nullptr) {
+		return std::string();
+	}
+	if(av_write_trailer(output) < 0) { //also writes what the interleaving still holds
+		++ stats.writeErrors;
+	}
+	if(!(output->oformat->flags & AVFMT_NOFILE)) {
+		avio_closep(&output->pb);
+	}
+	avformat_free_context(output);
+	output = nullptr;
+	for(Input& input : inputs) {
+		input.outputIndex = -1;
+	}
+	std::string path;
+	path.swap(segmentPath);
+	return path;
+}
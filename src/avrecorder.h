@@ -0,0 +1,74 @@
+#ifndef AVRECORDER_H
+#define AVRECORDER_H
+
+extern "C" {
+	#include <libavcodec/avcodec.h>
+	#include <libavformat/avformat.h>
+}
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+//Remuxes the demuxed packets of a file into time segmented MP4 or MKV files, without decoding.
+//The reading thread hands over every packet it reads, a segment starts at a video keyframe (any packet without video)
+//and the next one starts at the first keyframe after segmentSeconds. Timestamps of every segment start at zero.
+class AVRecorder {
+	public:
+		enum Container {
+			MP4, //fragmented at every keyframe, a segment cut short by a crash loses only its last fragment
+			MKV
+		};
+		struct Parameters {
+			std::string pathPrefix; //segments are pathPrefix, a six digit number and the extension
+			Container container = MP4;
+			unsigned int segmentSeconds = 60;
+			std::function<void(const std::string& path)> segmentFinished = nullptr; //from the thread that finished the segment, outside of the recorder's lock
+		};
+		struct Stats {
+			uint64_t segments = 0;
+			uint64_t packets = 0;
+			uint64_t bytes = 0; //of the packets written
+			uint64_t droppedPackets = 0; //before the first keyframe of a segment or without timestamps
+			uint64_t writeErrors = 0;
+		};
+
+		AVRecorder() = default;
+		AVRecorder(const AVRecorder&) = delete;
+		AVRecorder& operator = (const AVRecorder&) = delete;
+		~AVRecorder();
+		bool start(const Parameters& parameters); //the first segment starts at the next keyframe
+		void stop();
+		bool isRecording();
+		Stats getStats();
+		void setStreams(const AVStream* videoStream, const AVStream* audioStream); //on every (re)open, also cuts the segment
+		void cut(); //after a seek or at the end of the file, the next keyframe starts a new segment
+		void write(const AVPacket* packet);
+
+	private:
+		enum {VIDEO_INPUT, AUDIO_INPUT, INPUTS_COUNT};
+		struct Input {
+			int streamIndex = -1;
+			AVCodecParameters* parameters = nullptr;
+			AVRational timeBase = {0, 1};
+			int outputIndex = -1; //-1 when the container can't hold the codec
+		};
+
+		std::mutex recorderMutex;
+		std::atomic<bool> recording = {false};
+		Parameters parameters;
+		Input inputs[INPUTS_COUNT];
+		AVFormatContext* output = nullptr;
+		AVPacket* outputPacket = nullptr;
+		std::string segmentPath;
+		int64_t segmentStart = 0; //AV_TIME_BASE units of the input timestamps
+		unsigned int segmentNumber = 0;
+		Stats stats;
+
+		bool openSegment(int64_t start);
+		std::string finishSegment(); //returns the path of the finished segment, empty when none was open
+};
+
+#endif // AVRECORDER_H
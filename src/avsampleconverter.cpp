@@ -0,0 +1,540 @@
+#include "avsampleconverter.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define AVSAMPLE_SSE2
+	#if defined(__GNUC__)
+		#include <immintrin.h>
+		#define AVSAMPLE_AVX2
+	#endif
+#endif
+
+namespace {
+
+enum Shape {
+	MONO, //one plane to one channel
+	STEREO, //two planes interleaved
+	UP, //one plane to two channels
+	DOWN, //two planes to one channel
+	WIDE //more planes interleaved, scalar only
+};
+const int kernelShapes = WIDE;
+
+const float mixLevel = 0.70710678118654752f; //M_SQRT1_2
+const int16_t mixLevelS16 = 23170; //mixLevel in Q15
+const float s16Scale = 1.0f / 32768.0f;
+
+inline float downmixLevel(const float*) {
+	return mixLevel;
+}
+
+inline float downmixLevel(const int16_t*) { //swr normalizes a mix into S16 so the sum can't clip
+	return 0.5f;
+}
+
+inline float toFloat(float value) {
+	return value;
+}
+
+inline float toFloat(int16_t value) {
+	return static_cast<float>(value) * s16Scale;
+}
+
+inline void fromFloat(float* dst, float value) {
+	*dst = value;
+}
+
+inline void fromFloat(int16_t* dst, float value) {
+	long rounded = std::lrint(value * 32768.0f);
+	*dst = static_cast<int16_t>(rounded > 32767 ? 32767 : (rounded < -32768 ? -32768 : rounded));
+}
+
+//every kernel returns how many values it converted, the scalar loop finishes them
+using SampleKernel = int (*)(const uint8_t* const src[], uint8_t* dst, int count);
+using ScalarKernel = void (*)(Shape shape, int planes, const uint8_t* const src[], uint8_t* dst, int start, int count);
+
+template<class Src, class Dst>
+void convertScalar(Shape shape, int planes, const uint8_t* const src[], uint8_t* dst, int start, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	if(shape == MONO) {
+		for(int x = start; x < count; ++ x) {
+			fromFloat(out + x, toFloat(first[x]));
+		}
+	}else if(shape == UP) {
+		for(int x = start; x < count; ++ x) {
+			float value = mixLevel * toFloat(first[x]);
+			fromFloat(out + 2 * x, value);
+			fromFloat(out + 2 * x + 1, value);
+		}
+	}else if(shape == DOWN) {
+		const Src* second = reinterpret_cast<const Src*>(src[1]);
+		float level = downmixLevel(out);
+		for(int x = start; x < count; ++ x) {
+			fromFloat(out + x, level * toFloat(first[x]) + level * toFloat(second[x]));
+		}
+	}else {
+		for(int x = start; x < count; ++ x) {
+			for(int plane = 0; plane < planes; ++ plane) {
+				fromFloat(out + x * planes + plane, toFloat(reinterpret_cast<const Src*>(src[plane])[x]));
+			}
+		}
+	}
+}
+
+template<> //mixed in Q15 with rounding, like swr does when both sides are S16
+void convertScalar<int16_t, int16_t>(Shape shape, int planes, const uint8_t* const src[], uint8_t* dst, int start, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	if(shape == MONO) {
+		memcpy(out + start, first + start, static_cast<size_t>(count - start) * sizeof(int16_t));
+	}else if(shape == UP) {
+		for(int x = start; x < count; ++ x) {
+			int16_t value = static_cast<int16_t>((first[x] * mixLevelS16 + 16384) >> 15);
+			out[2 * x] = value;
+			out[2 * x + 1] = value;
+		}
+	}else if(shape == DOWN) {
+		const int16_t* second = reinterpret_cast<const int16_t*>(src[1]);
+		for(int x = start; x < count; ++ x) {
+			out[x] = static_cast<int16_t>((first[x] + second[x] + 1) >> 1); //both levels are 16384
+		}
+	}else {
+		for(int x = start; x < count; ++ x) {
+			for(int plane = 0; plane < planes; ++ plane) {
+				out[x * planes + plane] = reinterpret_cast<const int16_t*>(src[plane])[x];
+			}
+		}
+	}
+}
+
+int convertNone(const uint8_t* const[], uint8_t*, int) {
+	return 0;
+}
+
+#ifdef AVSAMPLE_SSE2
+inline __m128 loadSse2(const float* src) {
+	return _mm_loadu_ps(src);
+}
+
+inline __m128 loadSse2(const int16_t* src) {
+	__m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+	values = _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16);
+	return _mm_mul_ps(_mm_cvtepi32_ps(values), _mm_set1_ps(s16Scale));
+}
+
+inline __m128i toS16Sse2(__m128 values) { //rounds to nearest even like lrint, the clamp keeps big values from wrapping
+	values = _mm_mul_ps(values, _mm_set1_ps(32768.0f));
+	values = _mm_min_ps(_mm_max_ps(values, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+	return _mm_cvtps_epi32(values);
+}
+
+inline void storeSse2(float* dst, __m128 values) {
+	_mm_storeu_ps(dst, values);
+}
+
+inline void storeSse2(int16_t* dst, __m128 values) {
+	__m128i words = toS16Sse2(values);
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(words, words));
+}
+
+inline void storeSse2(float* dst, __m128 left, __m128 right) {
+	_mm_storeu_ps(dst, _mm_unpacklo_ps(left, right));
+	_mm_storeu_ps(dst + 4, _mm_unpackhi_ps(left, right));
+}
+
+inline void storeSse2(int16_t* dst, __m128 left, __m128 right) {
+	__m128i leftWords = toS16Sse2(left);
+	__m128i rightWords = toS16Sse2(right);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(_mm_unpacklo_epi32(leftWords, rightWords), _mm_unpackhi_epi32(leftWords, rightWords)));
+}
+
+template<class Src, class Dst>
+int monoSse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	int x = 0;
+	for(; x + 4 <= count; x += 4) {
+		storeSse2(out + x, loadSse2(first + x));
+	}
+	return x;
+}
+
+template<class Src, class Dst>
+int stereoSse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	const Src* second = reinterpret_cast<const Src*>(src[1]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	int x = 0;
+	for(; x + 4 <= count; x += 4) {
+		storeSse2(out + 2 * x, loadSse2(first + x), loadSse2(second + x));
+	}
+	return x;
+}
+
+template<class Src, class Dst>
+int upSse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	const __m128 level = _mm_set1_ps(mixLevel);
+	int x = 0;
+	for(; x + 4 <= count; x += 4) {
+		__m128 values = _mm_mul_ps(level, loadSse2(first + x));
+		storeSse2(out + 2 * x, values, values);
+	}
+	return x;
+}
+
+template<class Src, class Dst>
+int downSse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	const Src* second = reinterpret_cast<const Src*>(src[1]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	const __m128 level = _mm_set1_ps(downmixLevel(out));
+	int x = 0;
+	for(; x + 4 <= count; x += 4) {
+		storeSse2(out + x, _mm_add_ps(_mm_mul_ps(level, loadSse2(first + x)), _mm_mul_ps(level, loadSse2(second + x))));
+	}
+	return x;
+}
+
+int stereoS16Sse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	const int16_t* second = reinterpret_cast<const int16_t*>(src[1]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + x));
+		__m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * x), _mm_unpacklo_epi16(left, right));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * x + 8), _mm_unpackhi_epi16(left, right));
+	}
+	return x;
+}
+
+int upS16Sse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	const __m128i level = _mm_set1_epi16(mixLevelS16);
+	const __m128i rounding = _mm_set1_epi32(16384);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + x));
+		__m128i low = _mm_mullo_epi16(values, level);
+		__m128i high = _mm_mulhi_epi16(values, level);
+		__m128i firstHalf = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low, high), rounding), 15);
+		__m128i secondHalf = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low, high), rounding), 15);
+		__m128i mixed = _mm_packs_epi32(firstHalf, secondHalf);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * x), _mm_unpacklo_epi16(mixed, mixed));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * x + 8), _mm_unpackhi_epi16(mixed, mixed));
+	}
+	return x;
+}
+
+int downS16Sse2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	const int16_t* second = reinterpret_cast<const int16_t*>(src[1]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	const __m128i sign = _mm_set1_epi16(static_cast<int16_t>(0x8000)); //the unsigned average with rounding up, moved to signed
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m128i left = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + x)), sign);
+		__m128i right = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + x)), sign);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_xor_si128(_mm_avg_epu16(left, right), sign));
+	}
+	return x;
+}
+#endif
+
+#ifdef AVSAMPLE_AVX2
+__attribute__((target("avx2")))
+inline __m256 loadAvx2(const float* src) {
+	return _mm256_loadu_ps(src);
+}
+
+__attribute__((target("avx2")))
+inline __m256 loadAvx2(const int16_t* src) {
+	__m256i values = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(values), _mm256_set1_ps(s16Scale));
+}
+
+__attribute__((target("avx2")))
+inline __m256i toS16Avx2(__m256 values) {
+	values = _mm256_mul_ps(values, _mm256_set1_ps(32768.0f));
+	values = _mm256_min_ps(_mm256_max_ps(values, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f));
+	return _mm256_cvtps_epi32(values);
+}
+
+__attribute__((target("avx2")))
+inline void storeAvx2(float* dst, __m256 values) {
+	_mm256_storeu_ps(dst, values);
+}
+
+__attribute__((target("avx2")))
+inline void storeAvx2(int16_t* dst, __m256 values) {
+	__m256i words = toS16Avx2(values);
+	__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(words, words), 0x08); //the packs work per lane
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(packed));
+}
+
+__attribute__((target("avx2")))
+inline void storeAvx2(float* dst, __m256 left, __m256 right) {
+	__m256 low = _mm256_unpacklo_ps(left, right);
+	__m256 high = _mm256_unpackhi_ps(left, right);
+	_mm256_storeu_ps(dst, _mm256_permute2f128_ps(low, high, 0x20));
+	_mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(low, high, 0x31));
+}
+
+__attribute__((target("avx2")))
+inline void storeAvx2(int16_t* dst, __m256 left, __m256 right) { //the per lane unpacks and packs cancel out
+	__m256i leftWords = toS16Avx2(left);
+	__m256i rightWords = toS16Avx2(right);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_packs_epi32(_mm256_unpacklo_epi32(leftWords, rightWords), _mm256_unpackhi_epi32(leftWords, rightWords)));
+}
+
+template<class Src, class Dst>
+__attribute__((target("avx2")))
+int monoAvx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		storeAvx2(out + x, loadAvx2(first + x));
+	}
+	return x;
+}
+
+template<class Src, class Dst>
+__attribute__((target("avx2")))
+int stereoAvx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	const Src* second = reinterpret_cast<const Src*>(src[1]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		storeAvx2(out + 2 * x, loadAvx2(first + x), loadAvx2(second + x));
+	}
+	return x;
+}
+
+template<class Src, class Dst>
+__attribute__((target("avx2")))
+int upAvx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	const __m256 level = _mm256_set1_ps(mixLevel);
+	int x = 0;
+	for(; x + 8 <= count; x += 8) {
+		__m256 values = _mm256_mul_ps(level, loadAvx2(first + x));
+		storeAvx2(out + 2 * x, values, values);
+	}
+	return x;
+}
+
+template<class Src, class Dst>
+__attribute__((target("avx2")))
+int downAvx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const Src* first = reinterpret_cast<const Src*>(src[0]);
+	const Src* second = reinterpret_cast<const Src*>(src[1]);
+	Dst* out = reinterpret_cast<Dst*>(dst);
+	const __m256 level = _mm256_set1_ps(downmixLevel(out));
+	int x = 0;
+	for(; x + 8 <= count; x += 8) { //no fma, swr multiplies and adds separately
+		storeAvx2(out + x, _mm256_add_ps(_mm256_mul_ps(level, loadAvx2(first + x)), _mm256_mul_ps(level, loadAvx2(second + x))));
+	}
+	return x;
+}
+
+__attribute__((target("avx2")))
+int stereoS16Avx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	const int16_t* second = reinterpret_cast<const int16_t*>(src[1]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	int x = 0;
+	for(; x + 16 <= count; x += 16) {
+		__m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + x));
+		__m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + x));
+		__m256i low = _mm256_unpacklo_epi16(left, right);
+		__m256i high = _mm256_unpackhi_epi16(left, right);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * x), _mm256_permute2x128_si256(low, high, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * x + 16), _mm256_permute2x128_si256(low, high, 0x31));
+	}
+	return x;
+}
+
+__attribute__((target("avx2")))
+int upS16Avx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	const __m256i level = _mm256_set1_epi16(mixLevelS16);
+	int x = 0;
+	for(; x + 16 <= count; x += 16) {
+		__m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + x));
+		__m256i mixed = _mm256_mulhrs_epi16(values, level); //(value * level + 16384) >> 15
+		__m256i low = _mm256_unpacklo_epi16(mixed, mixed);
+		__m256i high = _mm256_unpackhi_epi16(mixed, mixed);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * x), _mm256_permute2x128_si256(low, high, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * x + 16), _mm256_permute2x128_si256(low, high, 0x31));
+	}
+	return x;
+}
+
+__attribute__((target("avx2")))
+int downS16Avx2(const uint8_t* const src[], uint8_t* dst, int count) {
+	const int16_t* first = reinterpret_cast<const int16_t*>(src[0]);
+	const int16_t* second = reinterpret_cast<const int16_t*>(src[1]);
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	const __m256i sign = _mm256_set1_epi16(static_cast<int16_t>(0x8000));
+	int x = 0;
+	for(; x + 16 <= count; x += 16) {
+		__m256i left = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + x)), sign);
+		__m256i right = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + x)), sign);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_xor_si256(_mm256_avg_epu16(left, right), sign));
+	}
+	return x;
+}
+#endif
+
+struct Kernels {
+	SampleKernel convert[kernelShapes][2][2]; //by shape, S16 source and S16 destination
+	const char* name;
+};
+
+#ifdef AVSAMPLE_SSE2
+template<class Src, class Dst>
+void fillSse2(Kernels& kernels, int srcS16, int dstS16) {
+	kernels.convert[MONO][srcS16][dstS16] = &monoSse2<Src, Dst>;
+	kernels.convert[STEREO][srcS16][dstS16] = &stereoSse2<Src, Dst>;
+	kernels.convert[UP][srcS16][dstS16] = &upSse2<Src, Dst>;
+	kernels.convert[DOWN][srcS16][dstS16] = &downSse2<Src, Dst>;
+}
+#endif
+
+#ifdef AVSAMPLE_AVX2
+template<class Src, class Dst>
+void fillAvx2(Kernels& kernels, int srcS16, int dstS16) {
+	kernels.convert[MONO][srcS16][dstS16] = &monoAvx2<Src, Dst>;
+	kernels.convert[STEREO][srcS16][dstS16] = &stereoAvx2<Src, Dst>;
+	kernels.convert[UP][srcS16][dstS16] = &upAvx2<Src, Dst>;
+	kernels.convert[DOWN][srcS16][dstS16] = &downAvx2<Src, Dst>;
+}
+#endif
+
+Kernels selectKernels() {
+	Kernels kernels;
+	for(int shape = 0; shape < kernelShapes; ++ shape) {
+		for(int srcS16 = 0; srcS16 < 2; ++ srcS16) {
+			for(int dstS16 = 0; dstS16 < 2; ++ dstS16) {
+				kernels.convert[shape][srcS16][dstS16] = &convertNone;
+			}
+		}
+	}
+	kernels.name = "scalar";
+	int cpuFlags = av_get_cpu_flags();
+	(void)cpuFlags;
+#ifdef AVSAMPLE_AVX2
+	if(cpuFlags & AV_CPU_FLAG_AVX2) {
+		fillAvx2<float, float>(kernels, 0, 0);
+		fillAvx2<float, int16_t>(kernels, 0, 1);
+		fillAvx2<int16_t, float>(kernels, 1, 0);
+		fillAvx2<int16_t, int16_t>(kernels, 1, 1);
+		kernels.convert[STEREO][1][1] = &stereoS16Avx2;
+		kernels.convert[UP][1][1] = &upS16Avx2;
+		kernels.convert[DOWN][1][1] = &downS16Avx2;
+		kernels.name = "avx2";
+		return kernels;
+	}
+#endif
+#ifdef AVSAMPLE_SSE2
+	if(cpuFlags & AV_CPU_FLAG_SSE2) {
+		fillSse2<float, float>(kernels, 0, 0);
+		fillSse2<float, int16_t>(kernels, 0, 1);
+		fillSse2<int16_t, float>(kernels, 1, 0);
+		fillSse2<int16_t, int16_t>(kernels, 1, 1);
+		kernels.convert[STEREO][1][1] = &stereoS16Sse2;
+		kernels.convert[UP][1][1] = &upS16Sse2;
+		kernels.convert[DOWN][1][1] = &downS16Sse2;
+		kernels.name = "sse2";
+	}
+#endif
+	return kernels;
+}
+
+const Kernels& kernels() {
+	static const Kernels selected = selectKernels();
+	return selected;
+}
+
+}
+
+bool AVSampleConverter::findRoute(AVSampleFormat srcFormat, int64_t srcLayout, int srcRate, AVSampleFormat dstFormat, int64_t dstLayout, int dstRate, Route& route) {
+	if(srcRate <= 0 || srcRate != dstRate || srcLayout <= 0 || dstLayout <= 0 || av_get_bytes_per_sample(srcFormat) <= 0) {
+		return false;
+	}
+	int srcChannels = av_get_channel_layout_nb_channels(static_cast<uint64_t>(srcLayout));
+	int dstChannels = av_get_channel_layout_nb_channels(static_cast<uint64_t>(dstLayout));
+	bool srcPlanar = av_sample_fmt_is_planar(srcFormat) && srcChannels > 1;
+	route.srcFormat = srcFormat;
+	route.dstFormat = dstFormat;
+	route.channels = dstChannels;
+	route.planes = srcPlanar ? srcChannels : 1;
+	route.valuesPerSample = srcPlanar ? 1 : srcChannels;
+	if(srcFormat == dstFormat && srcLayout == dstLayout) {
+		route.mix = COPY;
+		return true;
+	}
+	AVSampleFormat srcPacked = av_get_packed_sample_fmt(srcFormat);
+	if((srcPacked != AV_SAMPLE_FMT_S16 && srcPacked != AV_SAMPLE_FMT_FLT) || (dstFormat != AV_SAMPLE_FMT_S16 && dstFormat != AV_SAMPLE_FMT_FLT)) {
+		return false;
+	}
+	if(srcLayout == dstLayout) {
+		route.mix = CONVERT;
+		return true;
+	}else if(srcLayout == static_cast<int64_t>(AV_CH_LAYOUT_MONO) && dstLayout == static_cast<int64_t>(AV_CH_LAYOUT_STEREO)) {
+		route.mix = UPMIX;
+		return true;
+	}else if(srcLayout == static_cast<int64_t>(AV_CH_LAYOUT_STEREO) && dstLayout == static_cast<int64_t>(AV_CH_LAYOUT_MONO) && srcPlanar) {
+		route.mix = DOWNMIX;
+		return true;
+	}
+	return false;
+}
+
+size_t AVSampleConverter::outputSize(const Route& route, int samples) {
+	int size = av_samples_get_buffer_size(nullptr, route.channels, samples, route.dstFormat, 1);
+	return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+void AVSampleConverter::convert(const Route& route, const uint8_t* const src[], uint8_t* dst, int samples) {
+	int count = samples * route.valuesPerSample;
+	if(route.mix == COPY) {
+		size_t planeSize = static_cast<size_t>(count) * static_cast<size_t>(av_get_bytes_per_sample(route.srcFormat));
+		for(int plane = 0; plane < route.planes; ++ plane) {
+			memcpy(dst + planeSize * static_cast<size_t>(plane), src[plane], planeSize);
+		}
+		return;
+	}
+	static const ScalarKernel scalar[2][2] = {
+		{&convertScalar<float, float>, &convertScalar<float, int16_t>},
+		{&convertScalar<int16_t, float>, &convertScalar<int16_t, int16_t>}
+	};
+	Shape shape = WIDE;
+	if(route.mix == UPMIX) {
+		shape = UP;
+	}else if(route.mix == DOWNMIX) {
+		shape = DOWN;
+	}else if(route.planes <= 2) {
+		shape = route.planes == 1 ? MONO : STEREO;
+	}
+	int srcS16 = av_get_packed_sample_fmt(route.srcFormat) == AV_SAMPLE_FMT_S16 ? 1 : 0;
+	int dstS16 = route.dstFormat == AV_SAMPLE_FMT_S16 ? 1 : 0;
+	int start = shape == WIDE ? 0 : kernels().convert[shape][srcS16][dstS16](src, dst, count);
+	scalar[srcS16][dstS16](shape, route.planes, src, dst, start, count);
+}
+
+const char* AVSampleConverter::kernelName() {
+	return kernels().name;
+}
@@ -0,0 +1,41 @@
+#ifndef AVSAMPLECONVERTER_H
+#define AVSAMPLECONVERTER_H
+
+extern "C" {
+	#include <libavutil/channel_layout.h>
+	#include <libavutil/cpu.h>
+	#include <libavutil/samplefmt.h>
+}
+
+#include <cstddef>
+#include <cstdint>
+
+//Sample conversions that need neither resampling nor a general channel matrix, done without swr.
+//Matching formats and layouts are copied as they are, S16/S16P/FLT/FLTP go to packed S16 or FLT through the AVX2 or SSE2 kernel.
+//Mono to stereo and stereo to mono use the levels of swr's default matrix: -3 dB, a mix into S16 normalized to 0.5 so it can't clip,
+//and S16 to S16 is mixed in fixed point like swr does, so the samples are the ones swr_convert gives.
+class AVSampleConverter {
+	public:
+		enum Mix {
+			COPY, //same format and layout
+			CONVERT, //same layout
+			UPMIX, //mono to stereo
+			DOWNMIX //planar stereo to mono
+		};
+		struct Route {
+			Mix mix = COPY;
+			AVSampleFormat srcFormat = AV_SAMPLE_FMT_NONE;
+			AVSampleFormat dstFormat = AV_SAMPLE_FMT_NONE;
+			int channels = 0; //of the destination
+			int planes = 0; //read from the source, a packed one is a single plane
+			int valuesPerSample = 1; //in a plane, the channels of a packed source
+		};
+
+		//false when the conversion has to go through swr
+		static bool findRoute(AVSampleFormat srcFormat, int64_t srcLayout, int srcRate, AVSampleFormat dstFormat, int64_t dstLayout, int dstRate, Route& route);
+		static size_t outputSize(const Route& route, int samples); //a planar copy is written plane after plane
+		static void convert(const Route& route, const uint8_t* const src[], uint8_t* dst, int samples);
+		static const char* kernelName(); //the kernels selected for this CPU
+};
+
+#endif // AVSAMPLECONVERTER_H
@@ -0,0 +1,140 @@
+#include "avslicedscaler.h"
+
+#include <algorithm>
+
+AVSlicedScaler::~AVSlicedScaler() {
+	free();
+}
+
+bool AVSlicedScaler::init(int srcW, int srcH, AVPixelFormat srcFormat, int dstW, int dstH, AVPixelFormat dstFormat, int flags, int slices) {
+	free();
+	srcDescriptor = av_pix_fmt_desc_get(srcFormat);
+	dstDescriptor = av_pix_fmt_desc_get(dstFormat);
+	if(srcDescriptor == nullptr || dstDescriptor == nullptr || srcH <= 0 || dstH <= 0) {
+		return false;
+	}
+	if((srcDescriptor->flags & AV_PIX_FMT_FLAG_PAL) || (dstDescriptor->flags & AV_PIX_FMT_FLAG_PAL)) {
+		slices = 1; //the palette plane can't be split
+	}
+	int srcAlignment = rowsAlignment(srcDescriptor);
+	int dstAlignment = rowsAlignment(dstDescriptor);
+	slices = std::max(1, std::min(slices, std::min(srcH / srcAlignment, dstH / dstAlignment)));
+
+	int srcY = 0;
+	int dstY = 0;
+	for(int i = 1; i <= slices; ++ i) {
+		int srcEnd = i == slices ? srcH : static_cast<int>(static_cast<int64_t>(srcH) * i / slices) / srcAlignment * srcAlignment;
+		int dstEnd = i == slices ? dstH : static_cast<int>(static_cast<int64_t>(dstH) * i / slices) / dstAlignment * dstAlignment;
+		Band band;
+		band.srcY = srcY;
+		band.srcHeight = srcEnd - srcY;
+		band.dstY = dstY;
+		band.context = sws_getContext(srcW, band.srcHeight, srcFormat,
+									  dstW, dstEnd - dstY, dstFormat, flags,
+									  nullptr, nullptr, nullptr);
+		if(band.context == nullptr) {
+			free();
+			return false;
+		}
+		bands.push_back(band);
+		srcY = srcEnd;
+		dstY = dstEnd;
+	}
+
+	for(unsigned int i = 1; i < bands.size(); ++ i) {
+		workers.push_back(std::thread(&AVSlicedScaler::working, this, i));
+	}
+	return true;
+}
+
+void AVSlicedScaler::free() {
+	std::unique_lock<std::mutex> jobLocker(jobMutex);
+	stopping = true;
+	jobLocker.unlock();
+	jobCond.notify_all();
+	for(auto& worker : workers) {
+		if(worker.joinable()) {
+			worker.join();
+		}
+	}
+	workers.clear();
+	stopping = false;
+	jobNumber = 0; //new workers start waiting for job 1
+	for(auto& band : bands) {
+		sws_freeContext(band.context);
+	}
+	bands.clear();
+}
+
+bool AVSlicedScaler::isReady() {
+	return !bands.empty();
+}
+
+bool AVSlicedScaler::scale(const uint8_t* const srcData[], const int srcLinesize[], uint8_t* const dstData[], const int dstLinesize[]) {
+	if(bands.empty()) {
+		return false;
+	}
+	std::unique_lock<std::mutex> jobLocker(jobMutex);
+	jobSrcData = srcData;
+	jobSrcLinesize = srcLinesize;
+	jobDstData = dstData;
+	jobDstLinesize = dstLinesize;
+	bandsLeft = static_cast<unsigned int>(bands.size()) - 1;
+	jobFailed = false;
+	++ jobNumber;
+	bool hasWorkers = bandsLeft > 0;
+	jobLocker.unlock();
+	if(hasWorkers) {
+		jobCond.notify_all();
+	}
+
+	bool result = scaleBand(0);
+	jobLocker.lock();
+	doneCond.wait(jobLocker, [&](){return bandsLeft == 0;});
+	return result && !jobFailed;
+}
+
+void AVSlicedScaler::working(unsigned int bandIndex) {
+	unsigned int doneJob = 0;
+	std::unique_lock<std::mutex> jobLocker(jobMutex);
+	while(true) {
+		jobCond.wait(jobLocker, [&](){return stopping || jobNumber != doneJob;});
+		if(stopping) return;
+		doneJob = jobNumber;
+		jobLocker.unlock();
+		bool result = scaleBand(bandIndex);
+		jobLocker.lock();
+		if(!result) {
+			jobFailed = true;
+		}
+		if(-- bandsLeft == 0) {
+			doneCond.notify_one();
+		}
+	}
+}
+
+bool AVSlicedScaler::scaleBand(unsigned int bandIndex) {
+	Band& band = bands[bandIndex];
+	const uint8_t* src[4] = {nullptr};
+	uint8_t* dst[4] = {nullptr};
+	for(int plane = 0; plane < 4; ++ plane) {
+		if(jobSrcData[plane]) {
+			src[plane] = jobSrcData[plane] + (band.srcY >> planeRowShift(srcDescriptor, plane)) * jobSrcLinesize[plane];
+		}
+		if(jobDstData[plane]) {
+			dst[plane] = jobDstData[plane] + (band.dstY >> planeRowShift(dstDescriptor, plane)) * jobDstLinesize[plane];
+		}
+	}
+	return sws_scale(band.context, src, jobSrcLinesize, 0, band.srcHeight, dst, jobDstLinesize) > 0;
+}
+
+int AVSlicedScaler::rowsAlignment(const AVPixFmtDescriptor* descriptor) {
+	return 1 << descriptor->log2_chroma_h;
+}
+
+int AVSlicedScaler::planeRowShift(const AVPixFmtDescriptor* descriptor, int plane) {
+	if((plane == 1 || plane == 2) && !(descriptor->flags & AV_PIX_FMT_FLAG_RGB)) {
+		return descriptor->log2_chroma_h;
+	}
+	return 0;
+}
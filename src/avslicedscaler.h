@@ -0,0 +1,59 @@
+#ifndef AVSLICEDSCALER_H
+#define AVSLICEDSCALER_H
+
+extern "C" {
+	#include <libswscale/swscale.h>
+	#include <libavutil/pixdesc.h>
+}
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Converts a picture in horizontal bands, one SwsContext per band.
+//The caller converts the first band, its own worker threads convert the others.
+//Bands are scaled independently, so with vertical scaling the rows at band edges
+//are filtered without their neighbours from the next band.
+class AVSlicedScaler {
+	public:
+		AVSlicedScaler() = default;
+		AVSlicedScaler(const AVSlicedScaler&) = delete;
+		AVSlicedScaler& operator = (const AVSlicedScaler&) = delete;
+		~AVSlicedScaler();
+		bool init(int srcW, int srcH, AVPixelFormat srcFormat, int dstW, int dstH, AVPixelFormat dstFormat, int flags, int slices);
+		void free();
+		bool isReady();
+		bool scale(const uint8_t* const srcData[], const int srcLinesize[], uint8_t* const dstData[], const int dstLinesize[]);
+
+	private:
+		struct Band {
+			SwsContext* context = nullptr;
+			int srcY = 0;
+			int srcHeight = 0;
+			int dstY = 0;
+		};
+		std::vector<Band> bands;
+		const AVPixFmtDescriptor* srcDescriptor = nullptr;
+		const AVPixFmtDescriptor* dstDescriptor = nullptr;
+
+		std::vector<std::thread> workers;
+		std::mutex jobMutex;
+		std::condition_variable jobCond;
+		std::condition_variable doneCond;
+		unsigned int jobNumber = 0;
+		unsigned int bandsLeft = 0;
+		bool jobFailed = false;
+		bool stopping = false;
+		const uint8_t* const* jobSrcData = nullptr;
+		const int* jobSrcLinesize = nullptr;
+		uint8_t* const* jobDstData = nullptr;
+		const int* jobDstLinesize = nullptr;
+
+		void working(unsigned int bandIndex);
+		bool scaleBand(unsigned int bandIndex);
+		static int rowsAlignment(const AVPixFmtDescriptor* descriptor);
+		static int planeRowShift(const AVPixFmtDescriptor* descriptor, int plane);
+};
+
+#endif // AVSLICEDSCALER_H
@@ -0,0 +1,301 @@
+#include "avsocketsource.h"
+#include "avfiber.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <netdb.h>
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <sys/types.h>
+	#include <unistd.h>
+#endif
+
+AVSocketSource::~AVSocketSource() {
+	close();
+}
+
+bool AVSocketSource::canOpen(const std::string& url) {
+#ifdef __linux__
+	return url.compare(0, 6, "tcp://") == 0 || url.compare(0, 7, "http://") == 0;
+#else
+	(void)url;
+	return false;
+#endif
+}
+
+AVSocketSource::OpenResult AVSocketSource::open(const std::string& url, int64_t timeout) {
+	close();
+	bool isHttp = url.compare(0, 7, "http://") == 0;
+	if(!isHttp && url.compare(0, 6, "tcp://") != 0) {
+		return FAILED;
+	}
+	std::string address = url.substr(isHttp ? 7 : 6);
+	std::string path = "/";
+	size_t pathPos = address.find('/');
+	if(pathPos != std::string::npos) {
+		path = address.substr(pathPos);
+		address.resize(pathPos);
+	}
+	size_t optionsPos = address.find('?'); //tcp://host:port?options
+	if(optionsPos != std::string::npos) {
+		address.resize(optionsPos);
+	}
+	std::string host = address;
+	std::string port = isHttp ? "80" : "";
+	size_t portPos = address.rfind(':');
+	if(portPos != std::string::npos) {
+		host = address.substr(0, portPos);
+		port = address.substr(portPos + 1);
+	}
+	if(host.empty() || port.empty()) {
+		return FAILED;
+	}
+
+	readTimeout = timeout;
+	closed = false;
+	aborted = false;
+	if(!connectTo(host, port, timeout)) {
+		close();
+		return FAILED;
+	}
+	if(isHttp) {
+		OpenResult result = sendHttpRequest(host, path, timeout);
+		if(result != OPENED) {
+			close();
+			return result;
+		}
+	}
+	return OPENED;
+}
+
+void AVSocketSource::close() {
+#ifdef __linux__
+	if(socketFd >= 0) {
+		::close(socketFd);
+	}
+#endif
+	socketFd = -1;
+	closed = true;
+	waitingSince = 0;
+	buffer.clear();
+	buffer.shrink_to_fit();
+	readPos = 0;
+}
+
+AVIOContext* AVSocketSource::createIOContext() {
+	unsigned char* ioBuffer = static_cast<unsigned char*>(av_malloc(ioBufferSize));
+	if(ioBuffer == nullptr) {
+		return nullptr;
+	}
+	AVIOContext* ioContext = avio_alloc_context(ioBuffer, ioBufferSize, 0, this, &AVSocketSource::readPacket, nullptr, nullptr);
+	if(ioContext == nullptr) {
+		av_free(ioBuffer);
+	}
+	return ioContext;
+}
+
+void AVSocketSource::freeIOContext(AVIOContext** ioContext) {
+	if(*ioContext) {
+		av_freep(&(*ioContext)->buffer);
+		avio_context_free(ioContext);
+		*ioContext = nullptr;
+	}
+}
+
+int AVSocketSource::getSocket() {
+	return socketFd;
+}
+
+void AVSocketSource::abort() {
+	aborted = true;
+}
+
+bool AVSocketSource::isAborted() {
+	return aborted;
+}
+
+bool AVSocketSource::isWaitingForData() {
+	return waitingSince != 0;
+}
+
+bool AVSocketSource::waitExpired(int64_t now) {
+	return waitingSince != 0 && now - waitingSince >= readTimeout;
+}
+
+bool AVSocketSource::connectTo(const std::string& host, const std::string& port, int64_t timeout) {
+#ifdef __linux__
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if(getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+		return false;
+	}
+	for(addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+		socketFd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+		if(socketFd < 0) {
+			continue;
+		}
+		if(connect(socketFd, address->ai_addr, address->ai_addrlen) == 0) {
+			break;
+		}
+		if(errno == EINPROGRESS && waitSocket(true, timeout)) {
+			int error = 0;
+			socklen_t errorSize = sizeof(error);
+			if(getsockopt(socketFd, SOL_SOCKET, SO_ERROR, &error, &errorSize) == 0 && error == 0) {
+				break;
+			}
+		}
+		::close(socketFd);
+		socketFd = -1;
+	}
+	freeaddrinfo(addresses);
+	return socketFd >= 0;
+#else
+	(void)host; (void)port; (void)timeout;
+	return false;
+#endif
+}
+
+AVSocketSource::OpenResult AVSocketSource::sendHttpRequest(const std::string& host, const std::string& path, int64_t timeout) {
+#ifdef __linux__
+	std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + host + "\r\nUser-Agent: ffmpegSw\r\nConnection: close\r\n\r\n";
+	size_t sent = 0;
+	while(sent < request.size()) {
+		ssize_t result = send(socketFd, &request[sent], request.size() - sent, MSG_NOSIGNAL);
+		if(result > 0) {
+			sent += static_cast<size_t>(result);
+		}else if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if(!waitSocket(true, timeout)) return FAILED;
+		}else if(result < 0 && errno == EINTR) {
+			continue;
+		}else {
+			return FAILED;
+		}
+	}
+
+	const char headerEnd[] = "\r\n\r\n";
+	buffer.resize(maxHeaderSize);
+	size_t received = 0;
+	while(received < buffer.size()) { //the body that came together with the headers stays in the buffer
+		int result = receive(&buffer[received], buffer.size() - received);
+		if(result == 0) {
+			if(!waitSocket(false, timeout)) return FAILED;
+			continue;
+		}
+		if(result < 0) {
+			return FAILED;
+		}
+		received += static_cast<size_t>(result);
+		uint8_t* begin = &buffer[0];
+		uint8_t* end = begin + received;
+		uint8_t* found = std::search(begin, end, headerEnd, headerEnd + 4);
+		if(found != end) {
+			std::string statusLine(reinterpret_cast<char*>(begin), std::find(begin, found, '\r') - begin);
+			size_t codePos = statusLine.find(' ');
+			if(codePos == std::string::npos) {
+				return FAILED;
+			}
+			if(statusLine.compare(codePos + 1, 3, "200") != 0) {
+				return UNHANDLED;
+			}
+			buffer.resize(received);
+			readPos = static_cast<size_t>(found - begin) + 4;
+			return OPENED;
+		}
+	}
+	return FAILED;
+#else
+	(void)host; (void)path; (void)timeout;
+	return FAILED;
+#endif
+}
+
+int AVSocketSource::receive(uint8_t* buf, size_t size) {
+#ifdef __linux__
+	while(true) {
+		ssize_t received = recv(socketFd, buf, size, 0);
+		if(received > 0) {
+			return static_cast<int>(received);
+		}
+		if(received == 0) {
+			closed = true;
+			return AVERROR_EOF;
+		}
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 0;
+		}
+		if(errno != EINTR) {
+			closed = true;
+			return AVERROR(errno);
+		}
+	}
+#else
+	(void)buf; (void)size;
+	return AVERROR_EOF;
+#endif
+}
+
+bool AVSocketSource::waitSocket(bool forWriting, int64_t timeout) {
+#ifdef __linux__
+	pollfd pollDescriptor;
+	pollDescriptor.fd = socketFd;
+	pollDescriptor.events = forWriting ? POLLOUT : POLLIN;
+	pollDescriptor.revents = 0;
+	int result = 0;
+	do {
+		result = poll(&pollDescriptor, 1, static_cast<int>(timeout / 1000));
+	}while(result < 0 && errno == EINTR);
+	return result > 0;
+#else
+	(void)forWriting; (void)timeout;
+	return false;
+#endif
+}
+
+int AVSocketSource::readPacket(void* opaque, uint8_t* buf, int bufSize) {
+	AVSocketSource* source = static_cast<AVSocketSource*>(opaque);
+	if(source->readPos < source->buffer.size()) {
+		size_t copySize = std::min(source->buffer.size() - source->readPos, static_cast<size_t>(bufSize));
+		memcpy(buf, &source->buffer[source->readPos], copySize);
+		source->readPos += copySize;
+		if(source->readPos == source->buffer.size()) {
+			source->buffer.clear();
+			source->buffer.shrink_to_fit();
+			source->readPos = 0;
+		}
+		return static_cast<int>(copySize);
+	}
+	int64_t waitStart = 0;
+	while(true) {
+		if(source->aborted) {
+			return AVERROR_EXIT;
+		}
+		if(source->closed) {
+			return AVERROR_EOF;
+		}
+		int result = source->receive(buf, static_cast<size_t>(bufSize));
+		if(result != 0) {
+			return result;
+		}
+		int64_t now = av_gettime_relative();
+		if(waitStart == 0) {
+			waitStart = now;
+		}else if(now - waitStart >= source->readTimeout) {
+			return AVERROR(ETIMEDOUT);
+		}
+		AVFiber* fiber = AVFiber::current();
+		if(fiber) { //the reactor resumes the fiber when the socket is readable, aborted or the wait expired
+			source->waitingSince = waitStart;
+			fiber->yield();
+			source->waitingSince = 0;
+		}else if(!source->waitSocket(false, source->readTimeout - (now - waitStart))) {
+			return source->aborted ? AVERROR_EXIT : AVERROR(ETIMEDOUT);
+		}
+	}
+}
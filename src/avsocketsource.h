@@ -0,0 +1,59 @@
+#ifndef AVSOCKETSOURCE_H
+#define AVSOCKETSOURCE_H
+
+extern "C" {
+	#include <libavformat/avformat.h>
+	#include <libavutil/time.h>
+}
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+//Own socket for tcp:// and http:// inputs, read by avformat through a custom AVIOContext.
+//The read callback never blocks the I/O reactor: when the socket has nothing it yields the demuxing fiber,
+//the reactor resumes it when the socket becomes readable. Outside of a fiber (opening, a reading thread) it waits on the socket.
+class AVSocketSource {
+	public:
+		enum OpenResult {
+			OPENED,
+			FAILED,
+			UNHANDLED //an http status other than 200, like a redirect, left to avformat's own protocol
+		};
+
+		AVSocketSource() = default;
+		AVSocketSource(const AVSocketSource&) = delete;
+		AVSocketSource& operator = (const AVSocketSource&) = delete;
+		~AVSocketSource();
+
+		static bool canOpen(const std::string& url);
+		OpenResult open(const std::string& url, int64_t timeout); //timeout in microseconds
+		void close();
+		AVIOContext* createIOContext();
+		static void freeIOContext(AVIOContext** ioContext);
+		int getSocket();
+		void abort(); //the read callback returns AVERROR_EXIT from now on, any thread
+		bool isAborted();
+		bool isWaitingForData(); //the demuxing fiber yielded on an empty socket
+		bool waitExpired(int64_t now); //waiting for data longer than the read timeout
+
+	private:
+		static const int ioBufferSize = 32768;
+		static const size_t maxHeaderSize = 16384;
+
+		int socketFd = -1;
+		bool closed = false;
+		std::atomic<bool> aborted = {false};
+		int64_t readTimeout = 10000000;
+		int64_t waitingSince = 0; //av_gettime_relative() when the fiber yielded, 0 when it isn't waiting
+		std::vector<uint8_t> buffer; //the http headers, then the part of the body received together with them
+		size_t readPos = 0;
+
+		bool connectTo(const std::string& host, const std::string& port, int64_t timeout);
+		OpenResult sendHttpRequest(const std::string& host, const std::string& path, int64_t timeout);
+		int receive(uint8_t* buf, size_t size); //bytes, 0 when nothing is there yet, an AVERROR when closed or broken
+		bool waitSocket(bool forWriting, int64_t timeout);
+		static int readPacket(void* opaque, uint8_t* buf, int bufSize);
+};
+
+#endif // AVSOCKETSOURCE_H
@@ -0,0 +1,164 @@
+#ifndef AVSPSCRING_H
+#define AVSPSCRING_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+//Single producer / single consumer ring of reusable items, one slot always stays free.
+//The producer fills back() and publishes it with push(), the consumer uses front() and releases it with pop().
+//Indices are atomics on separate cache lines, the mutex and the condition are touched only when one side has to sleep.
+//The slot count is set at runtime by resize(), while both sides are held off.
+template<class ItemType>
+class AVSpscRing {
+	public:
+		using iterator = ItemType*;
+
+		explicit AVSpscRing(unsigned int slotsCount) {
+			resize(slotsCount);
+		}
+		AVSpscRing(const AVSpscRing&) = delete;
+		AVSpscRing& operator = (const AVSpscRing&) = delete;
+
+		ItemType& operator [] (unsigned int index) {
+			return items[index];
+		}
+		iterator begin() {
+			return items.get();
+		}
+		iterator end() {
+			return items.get() + size();
+		}
+		unsigned int size() const {
+			return slots.load(std::memory_order_acquire);
+		}
+		unsigned int nextIndex(unsigned int index) const {
+			return index + 1 >= size() ? 0 : index + 1;
+		}
+		unsigned int readIndex() const {
+			return head.load(std::memory_order_acquire);
+		}
+		unsigned int writeIndex() const {
+			return tail.load(std::memory_order_acquire);
+		}
+		bool isEmpty() const {
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+		bool isFull() const {
+			return nextIndex(tail.load(std::memory_order_acquire)) == head.load(std::memory_order_acquire);
+		}
+		unsigned int count() const {
+			unsigned int readPos = head.load(std::memory_order_acquire);
+			unsigned int writePos = tail.load(std::memory_order_acquire);
+			return writePos >= readPos ? writePos - readPos : size() - readPos + writePos;
+		}
+		//keeps the queued items in order and as many free slots as fit, the new slots are default constructed,
+		//only while neither side runs or both are held off by their locks, slotsCount must exceed count()
+		void resize(unsigned int slotsCount) {
+			unsigned int oldSlots = size();
+			if(slotsCount < 2 || slotsCount == oldSlots) return;
+			unsigned int readPos = head.load(std::memory_order_relaxed);
+			unsigned int queued = count();
+			std::unique_ptr<ItemType[]> newItems(new ItemType[slotsCount]);
+			unsigned int kept = oldSlots < slotsCount ? oldSlots : slotsCount;
+			for(unsigned int i = 0; i < kept; ++ i) { //the queued items first, then the free slots after them
+				newItems[i] = std::move(items[(readPos + i) % oldSlots]);
+			}
+			items = std::move(newItems);
+			head.store(0, std::memory_order_relaxed);
+			tail.store(queued, std::memory_order_relaxed);
+			slots.store(slotsCount, std::memory_order_release);
+			wakeAll();
+		}
+
+		//consumer side
+		ItemType& front() {
+			return items[head.load(std::memory_order_relaxed)];
+		}
+		void pop() {
+			head.store(nextIndex(head.load(std::memory_order_relaxed)), std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(producerWaiting.load(std::memory_order_relaxed)) {
+				wakeAll();
+			}
+		}
+		void dropAll() { //forget all published items, the caller must own the consumer side
+			head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(producerWaiting.load(std::memory_order_relaxed)) {
+				wakeAll();
+			}
+		}
+		template<class StopPredicate>
+		bool waitForData(StopPredicate stopWaiting) { //false if the ring is still empty
+			if(!isEmpty()) return true;
+			std::unique_lock<std::mutex> locker(waitMutex);
+			consumerWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			waitCond.wait(locker, [&](){return !isEmpty() || stopWaiting();});
+			consumerWaiting.store(false, std::memory_order_relaxed);
+			return !isEmpty();
+		}
+
+		//producer side
+		ItemType& back() {
+			return items[tail.load(std::memory_order_relaxed)];
+		}
+		void push() {
+			tail.store(nextIndex(tail.load(std::memory_order_relaxed)), std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(consumerWaiting.load(std::memory_order_relaxed)) {
+				wakeAll();
+			}
+		}
+		template<class StopPredicate>
+		bool waitForSpace(StopPredicate stopWaiting) { //false if the ring is still full
+			if(!isFull()) return true;
+			std::unique_lock<std::mutex> locker(waitMutex);
+			producerWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			waitCond.wait(locker, [&](){return !isFull() || stopWaiting();});
+			producerWaiting.store(false, std::memory_order_relaxed);
+			return !isFull();
+		}
+
+		template<class ReadyPredicate>
+		void waitAsProducer(ReadyPredicate ready) { //for a producer that needs more than a free slot, pop() wakes it to check again
+			if(ready()) return;
+			std::unique_lock<std::mutex> locker(waitMutex);
+			producerWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			waitCond.wait(locker, ready);
+			producerWaiting.store(false, std::memory_order_relaxed);
+		}
+
+		//must be called after changing anything the stop predicates look at
+		void wakeAll() {
+			std::lock_guard<std::mutex> locker(waitMutex);
+			waitCond.notify_all();
+		}
+		//only when neither side is running
+		void reset() {
+			head.store(0, std::memory_order_relaxed);
+			tail.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		static const unsigned int cacheLineSize = 64;
+
+		std::unique_ptr<ItemType[]> items;
+		std::atomic<unsigned int> slots = {0};
+		char headPadding[cacheLineSize - sizeof(std::atomic<unsigned int>)];
+		std::atomic<unsigned int> head = {0};
+		char tailPadding[cacheLineSize - sizeof(std::atomic<unsigned int>)];
+		std::atomic<unsigned int> tail = {0};
+		char waitPadding[cacheLineSize - sizeof(std::atomic<unsigned int>)];
+		std::atomic<bool> consumerWaiting = {false};
+		std::atomic<bool> producerWaiting = {false};
+		std::mutex waitMutex;
+		std::condition_variable waitCond;
+};
+
+#endif // AVSPSCRING_H
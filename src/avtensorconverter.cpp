@@ -0,0 +1,186 @@
+#include "avtensorconverter.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define AVTENSOR_SSE2
+	#if defined(__GNUC__)
+		#include <immintrin.h>
+		#define AVTENSOR_AVX2
+	#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define AVTENSOR_NEON
+#endif
+
+namespace {
+
+//every kernel returns how many values it converted, the scalar loop finishes the row
+using RowKernel = int (*)(const uint8_t* src, float* dst, int width, float scale, float bias);
+
+void convertRowScalar(const uint8_t* src, float* dst, int width, float scale, float bias, int start) {
+	for(int x = start; x < width; ++ x) {
+		dst[x] = static_cast<float>(src[x]) * scale + bias;
+	}
+}
+
+int convertRowNone(const uint8_t*, float*, int, float, float) {
+	return 0;
+}
+
+#ifdef AVTENSOR_SSE2
+int convertRowSse2(const uint8_t* src, float* dst, int width, float scale, float bias) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scales = _mm_set1_ps(scale);
+	const __m128 biases = _mm_set1_ps(bias);
+	int x = 0;
+	for(; x + 16 <= width; x += 16) {
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		__m128i words[2] = {_mm_unpacklo_epi8(values, zero), _mm_unpackhi_epi8(values, zero)};
+		for(int half = 0; half < 2; ++ half) {
+			__m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words[half], zero));
+			__m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words[half], zero));
+			_mm_storeu_ps(dst + x + half * 8, _mm_add_ps(_mm_mul_ps(low, scales), biases));
+			_mm_storeu_ps(dst + x + half * 8 + 4, _mm_add_ps(_mm_mul_ps(high, scales), biases));
+		}
+	}
+	return x;
+}
+#endif
+
+#ifdef AVTENSOR_AVX2
+__attribute__((target("avx2")))
+int convertRowAvx2(const uint8_t* src, float* dst, int width, float scale, float bias) {
+	const __m256 scales = _mm256_set1_ps(scale);
+	const __m256 biases = _mm256_set1_ps(bias);
+	int x = 0;
+	for(; x + 16 <= width; x += 16) {
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		__m256 low = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(values));
+		__m256 high = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(values, 8)));
+		_mm256_storeu_ps(dst + x, _mm256_add_ps(_mm256_mul_ps(low, scales), biases)); //no fma, the scalar loop rounds twice too
+		_mm256_storeu_ps(dst + x + 8, _mm256_add_ps(_mm256_mul_ps(high, scales), biases));
+	}
+	return x;
+}
+#endif
+
+#ifdef AVTENSOR_NEON
+int convertRowNeon(const uint8_t* src, float* dst, int width, float scale, float bias) {
+	const float32x4_t scales = vdupq_n_f32(scale);
+	const float32x4_t biases = vdupq_n_f32(bias);
+	int x = 0;
+	for(; x + 16 <= width; x += 16) {
+		uint8x16_t values = vld1q_u8(src + x);
+		uint16x8_t words[2] = {vmovl_u8(vget_low_u8(values)), vmovl_u8(vget_high_u8(values))};
+		for(int half = 0; half < 2; ++ half) {
+			float32x4_t low = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words[half])));
+			float32x4_t high = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words[half])));
+			vst1q_f32(dst + x + half * 8, vaddq_f32(vmulq_f32(low, scales), biases));
+			vst1q_f32(dst + x + half * 8 + 4, vaddq_f32(vmulq_f32(high, scales), biases));
+		}
+	}
+	return x;
+}
+#endif
+
+struct Kernel {
+	RowKernel convertRow;
+	const char* name;
+};
+
+Kernel selectKernel() {
+	int cpuFlags = av_get_cpu_flags();
+	(void)cpuFlags;
+#ifdef AVTENSOR_AVX2
+	if(cpuFlags & AV_CPU_FLAG_AVX2) {
+		return Kernel{&convertRowAvx2, "avx2"};
+	}
+#endif
+#ifdef AVTENSOR_SSE2
+	if(cpuFlags & AV_CPU_FLAG_SSE2) {
+		return Kernel{&convertRowSse2, "sse2"};
+	}
+#endif
+#ifdef AVTENSOR_NEON
+	if(cpuFlags & AV_CPU_FLAG_NEON) {
+		return Kernel{&convertRowNeon, "neon"};
+	}
+#endif
+	return Kernel{&convertRowNone, "scalar"};
+}
+
+//round to nearest even, overflow to infinity
+uint16_t toHalf(float value) {
+	uint32_t bits = 0;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+	uint16_t half = 0;
+	if(bits >= 0x47800000u) {
+		half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+	}else if(bits < 0x38800000u) { //subnormal, adding 0.5 lines the mantissa up with the half one
+		float aligned = 0.0f;
+		std::memcpy(&aligned, &bits, sizeof(aligned));
+		aligned += 0.5f;
+		std::memcpy(&bits, &aligned, sizeof(bits));
+		half = static_cast<uint16_t>(bits - 0x3f000000u);
+	}else {
+		uint32_t mantissaOdd = (bits >> 13) & 1;
+		bits += 0xc8000fffu + mantissaOdd; //rebias the exponent from 127 to 15 and round
+		half = static_cast<uint16_t>(bits >> 13);
+	}
+	return static_cast<uint16_t>((sign >> 16) | half);
+}
+
+}
+
+AVPixelFormat AVTensorConverter::storageFormat(Type type) {
+	return type == FLOAT16 ? AV_PIX_FMT_GBRP16 : AV_PIX_FMT_GBRPF32;
+}
+
+bool AVTensorConverter::isStorageFormat(AVPixelFormat format, Type& type) {
+	if(format == AV_PIX_FMT_GBRPF32) {
+		type = FLOAT32;
+		return true;
+	}else if(format == AV_PIX_FMT_GBRP16) {
+		type = FLOAT16;
+		return true;
+	}
+	return false;
+}
+
+void AVTensorConverter::convert(const uint8_t* const srcData[], const int srcLinesize[], uint8_t* const dstData[], const int dstLinesize[],
+								int width, int height, Type type, const Normalization& normalization) {
+	const int gbrPlanes[3] = {2, 0, 1}; //the source plane of R, G and B
+	const Kernel selected = selectKernel(); //per call, av_force_cpu_flags switches the kernel
+	for(int channel = 0; channel < 3; ++ channel) {
+		int srcPlane = gbrPlanes[normalization.bgr ? 2 - channel : channel];
+		float scale = 1.0f / (255.0f * normalization.std[channel]);
+		float bias = -normalization.mean[channel] / normalization.std[channel];
+		if(type == FLOAT32) {
+			for(int y = 0; y < height; ++ y) {
+				const uint8_t* src = srcData[srcPlane] + y * srcLinesize[srcPlane];
+				float* dst = reinterpret_cast<float*>(dstData[channel] + y * dstLinesize[channel]);
+				convertRowScalar(src, dst, width, scale, bias, selected.convertRow(src, dst, width, scale, bias));
+			}
+		}else {
+			uint16_t table[256];
+			for(int value = 0; value < 256; ++ value) {
+				table[value] = toHalf(static_cast<float>(value) * scale + bias);
+			}
+			for(int y = 0; y < height; ++ y) {
+				const uint8_t* src = srcData[srcPlane] + y * srcLinesize[srcPlane];
+				uint16_t* dst = reinterpret_cast<uint16_t*>(dstData[channel] + y * dstLinesize[channel]);
+				for(int x = 0; x < width; ++ x) {
+					dst[x] = table[src[x]];
+				}
+			}
+		}
+	}
+}
+
+const char* AVTensorConverter::kernelName() {
+	return selectKernel().name;
+}
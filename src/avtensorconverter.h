@@ -0,0 +1,33 @@
+#ifndef AVTENSORCONVERTER_H
+#define AVTENSORCONVERTER_H
+
+extern "C" {
+	#include <libavutil/cpu.h>
+	#include <libavutil/pixfmt.h>
+}
+
+#include <cstdint>
+
+//Scaled GBRP (swscale's planar RGB output) to normalized float channel planes, (value / 255 - mean) / std.
+//The planes are written in RGB or BGR order, so a picture packed plane after plane is a CHW tensor.
+//Float32 goes through the AVX2, SSE2 or NEON kernel, float16 through a per channel table of the 256 possible results.
+class AVTensorConverter {
+	public:
+		enum Type {
+			FLOAT32,
+			FLOAT16
+		};
+		struct Normalization {
+			float mean[3] = {0.0f, 0.0f, 0.0f}; //per tensor channel, on values scaled to 0..1
+			float std[3] = {1.0f, 1.0f, 1.0f};
+			bool bgr = false; //channel order of the tensor
+		};
+
+		static AVPixelFormat storageFormat(Type type); //planar format with the plane sizes of the tensor channels
+		static bool isStorageFormat(AVPixelFormat format, Type& type);
+		static void convert(const uint8_t* const srcData[], const int srcLinesize[], uint8_t* const dstData[], const int dstLinesize[],
+							int width, int height, Type type, const Normalization& normalization);
+		static const char* kernelName(); //the float32 kernel selected for this CPU
+};
+
+#endif // AVTENSORCONVERTER_H
@@ -0,0 +1,197 @@
+#include "avthumbnailer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+AVThumbnailer::AVThumbnailer(unsigned int threadsCount):
+	threadsCount(threadsCount)
+{
+	if(this->threadsCount == 0) {
+		this->threadsCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+void AVThumbnailer::setProbeCache(AVProbeCache* probeCache) {
+	this->probeCache = probeCache;
+}
+
+bool AVThumbnailer::sheetSize(const SheetLayout& layout, int& width, int& height, int& linesize) {
+	if(layout.tileWidth <= 0 || layout.tileHeight <= 0 || layout.columns <= 0 || layout.tilesCount <= 0) {
+		return false;
+	}
+	int rows = (layout.tilesCount + layout.columns - 1) / layout.columns;
+	width = layout.tileWidth * std::min(layout.columns, layout.tilesCount);
+	height = layout.tileHeight * rows;
+	int linesizes[4] = {0, 0, 0, 0};
+	if(av_image_fill_linesizes(linesizes, layout.format, width) < 0 || linesizes[0] <= 0 || linesizes[1] != 0 || linesizes[0] % width != 0) {
+		return false; //the tiles are addressed by whole pixels of one plane
+	}
+	linesize = linesizes[0];
+	return true;
+}
+
+int AVThumbnailer::extract(const std::string& path, const SheetLayout& layout, uint8_t* sheet, int sheetLinesize) {
+	int width = 0;
+	int height = 0;
+	int linesize = 0;
+	if(sheet == nullptr || !sheetSize(layout, width, height, linesize) || sheetLinesize < linesize) {
+		return -1;
+	}
+	int pixelSize = linesize / width;
+
+	AVFormatContext* formatContext = nullptr;
+	AVCodecContext* codecContext = nullptr;
+	SwsContext* convertContext = nullptr;
+	AVPacket* packet = av_packet_alloc();
+	AVFrame* frame = av_frame_alloc();
+	int temp = 0;
+	auto deleter = [&](int*) {
+		if(convertContext) {sws_freeContext(convertContext);}
+		if(codecContext) {avcodec_free_context(&codecContext);}
+		if(formatContext) {avformat_close_input(&formatContext);}
+		av_packet_free(&packet);
+		av_frame_free(&frame);
+	};
+	std::unique_ptr<int, decltype(deleter)> allCloser(&temp, deleter);
+
+	if(packet == nullptr || frame == nullptr) {
+		return -1;
+	}
+	if(avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) != 0) {
+		return -1;
+	}
+	if(!findStreamInfo(path, formatContext)) {
+		return -1;
+	}
+	AVCodec* codec = nullptr;
+	int streamId = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+	if(streamId < 0) {
+		return -1;
+	}
+	AVStream* stream = formatContext->streams[streamId];
+	codecContext = openKeyframeDecoder(stream, codec);
+	if(codecContext == nullptr) {
+		return -1;
+	}
+
+	int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+	int64_t duration = stream->duration;
+	if((duration == AV_NOPTS_VALUE || duration <= 0) && formatContext->duration != AV_NOPTS_VALUE) {
+		duration = static_cast<int64_t>(formatContext->duration / static_cast<double>(AV_TIME_BASE) / av_q2d(stream->time_base));
+	}
+	int tilesCount = duration > 0 ? layout.tilesCount : 1; //without a duration only the first frame is known
+
+	int tilesFilled = 0;
+	for(int tile = 0; tile < tilesCount; ++ tile) {
+		int64_t timestamp = start + duration / tilesCount * tile;
+		if(av_seek_frame(formatContext, streamId, timestamp, AVSEEK_FLAG_BACKWARD) < 0 && tile > 0) {
+			break;
+		}
+		avcodec_flush_buffers(codecContext);
+		if(!decodeKeyframe(formatContext, codecContext, streamId, packet, frame)) {
+			break;
+		}
+		convertContext = sws_getCachedContext(convertContext, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+											  layout.tileWidth, layout.tileHeight, layout.format, SWS_BILINEAR, nullptr, nullptr, nullptr);
+		if(convertContext == nullptr) {
+			break;
+		}
+		int row = tile / layout.columns;
+		int column = tile % layout.columns;
+		uint8_t* destData[4] = {sheet + row * layout.tileHeight * sheetLinesize + column * layout.tileWidth * pixelSize, nullptr, nullptr, nullptr};
+		int destLinesize[4] = {sheetLinesize, 0, 0, 0};
+		sws_scale(convertContext, frame->data, frame->linesize, 0, frame->height, destData, destLinesize);
+		av_frame_unref(frame);
+		++ tilesFilled;
+	}
+	return tilesFilled;
+}
+
+std::vector<AVThumbnailer::Sheet> AVThumbnailer::extract(const std::vector<std::string>& paths, const SheetLayout& layout) {
+	std::vector<Sheet> sheets(paths.size());
+	for(size_t i = 0; i < paths.size(); ++ i) {
+		sheets[i].path = paths[i];
+	}
+	int width = 0;
+	int height = 0;
+	int linesize = 0;
+	if(!sheetSize(layout, width, height, linesize)) {
+		return sheets;
+	}
+
+	std::atomic<size_t> nextFile = {0};
+	auto working = [&]() {
+		for(size_t i = nextFile ++; i < sheets.size(); i = nextFile ++) {
+			Sheet& sheet = sheets[i];
+			sheet.width = width;
+			sheet.height = height;
+			sheet.linesize = linesize;
+			sheet.data.assign(static_cast<size_t>(linesize) * height, 0);
+			sheet.tilesFilled = extract(sheet.path, layout, sheet.data.data(), linesize);
+		}
+	};
+	std::vector<std::thread> workers;
+	unsigned int workersCount = static_cast<unsigned int>(std::min<size_t>(threadsCount, paths.size()));
+	for(unsigned int i = 0; i < workersCount; ++ i) {
+		workers.emplace_back(working);
+	}
+	for(auto& worker : workers) {
+		worker.join();
+	}
+	return sheets;
+}
+
+bool AVThumbnailer::findStreamInfo(const std::string& path, AVFormatContext* formatContext) {
+	if(probeCache && probeCache->apply(path, formatContext)) {
+		return true;
+	}
+	if(avformat_find_stream_info(formatContext, nullptr) < 0) {
+		return false;
+	}
+	if(probeCache) {
+		probeCache->store(path, formatContext);
+	}
+	return true;
+}
+
+AVCodecContext* AVThumbnailer::openKeyframeDecoder(AVStream* stream, AVCodec* codec) {
+	AVCodecContext* codecContext = avcodec_alloc_context3(nullptr);
+	if(codecContext == nullptr) {
+		return nullptr;
+	}
+	if(avcodec_parameters_to_context(codecContext, stream->codecpar) < 0) {
+		avcodec_free_context(&codecContext);
+		return nullptr;
+	}
+	codecContext->thread_count = 1; //the files are spread over the threads instead
+	codecContext->skip_frame = AVDISCARD_NONKEY;
+	if(avcodec_open2(codecContext, codec, nullptr) < 0) {
+		avcodec_free_context(&codecContext);
+		return nullptr;
+	}
+	return codecContext;
+}
+
+bool AVThumbnailer::decodeKeyframe(AVFormatContext* formatContext, AVCodecContext* codecContext, int streamId, AVPacket* packet, AVFrame* frame) {
+	while(true) {
+		int result = avcodec_receive_frame(codecContext, frame);
+		if(result == 0) {
+			return true;
+		}
+		if(result != AVERROR(EAGAIN)) {
+			return false;
+		}
+		if(av_read_frame(formatContext, packet) < 0) {
+			if(avcodec_send_packet(codecContext, nullptr) < 0) { //drains the last keyframe, then receive gives EOF
+				return false;
+			}
+			continue;
+		}
+		if(packet->stream_index == streamId && (packet->flags & AV_PKT_FLAG_KEY)) { //the other packets would be skipped by the decoder anyway
+			avcodec_send_packet(codecContext, packet);
+		}
+		av_packet_unref(packet);
+	}
+}
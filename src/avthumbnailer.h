@@ -0,0 +1,56 @@
+#ifndef AVTHUMBNAILER_H
+#define AVTHUMBNAILER_H
+
+#include "avprobecache.h"
+
+extern "C" {
+	#include <libavcodec/avcodec.h>
+	#include <libavformat/avformat.h>
+	#include <libswscale/swscale.h>
+	#include <libavutil/imgutils.h>
+}
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Batch extraction of preview sprite sheets.
+//Seeks to evenly spaced timestamps, decodes only the keyframes there and scales them straight into the tiles of one sheet,
+//without the reading thread, the rings and the presentation pacing of AVfileContext.
+class AVThumbnailer {
+	public:
+		struct SheetLayout {
+			int tileWidth = 160;
+			int tileHeight = 90;
+			int columns = 10;
+			int tilesCount = 10; //tiles are evenly spaced over the duration
+			AVPixelFormat format = AV_PIX_FMT_BGRA; //packed formats only
+		};
+		struct Sheet {
+			std::string path;
+			int width = 0;
+			int height = 0;
+			int linesize = 0;
+			int tilesFilled = -1; //-1 when the file can't be opened
+			std::vector<uint8_t> data;
+		};
+
+		explicit AVThumbnailer(unsigned int threadsCount = 0); //0 means one thread per core
+		AVThumbnailer(const AVThumbnailer&) = delete;
+		AVThumbnailer& operator = (const AVThumbnailer&) = delete;
+		void setProbeCache(AVProbeCache* probeCache);
+		static bool sheetSize(const SheetLayout& layout, int& width, int& height, int& linesize);
+		//fills the tiles of a sheet the caller allocated with sheetSize, returns the tiles filled or -1
+		int extract(const std::string& path, const SheetLayout& layout, uint8_t* sheet, int sheetLinesize);
+		std::vector<Sheet> extract(const std::vector<std::string>& paths, const SheetLayout& layout); //files are spread over the threads
+
+	private:
+		unsigned int threadsCount = 0;
+		AVProbeCache* probeCache = nullptr;
+
+		bool findStreamInfo(const std::string& path, AVFormatContext* formatContext);
+		AVCodecContext* openKeyframeDecoder(AVStream* stream, AVCodec* codec);
+		bool decodeKeyframe(AVFormatContext* formatContext, AVCodecContext* codecContext, int streamId, AVPacket* packet, AVFrame* frame);
+};
+
+#endif // AVTHUMBNAILER_H
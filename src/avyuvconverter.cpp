@@ -0,0 +1,280 @@
+#include "avyuvconverter.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define AVYUV_SSE2
+	#if defined(__GNUC__)
+		#include <immintrin.h>
+		#define AVYUV_AVX2
+	#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define AVYUV_NEON
+#endif
+
+namespace {
+
+//Q13 BT.601 limited range coefficients, the inputs are scaled by 8 so (x * c) >> 16 is a 16 bit mulhi
+const int16_t coefY = 9539;
+const int16_t coefRV = 13075;
+const int16_t coefGU = 3209;
+const int16_t coefGV = 6660;
+const int16_t coefBU = 16525;
+
+struct RowParameters {
+	const uint8_t* y;
+	const uint8_t* u;
+	const uint8_t* v;
+	int chromaStep; //1 for planar chroma, 2 for NV12
+	uint8_t* dst;
+	int width;
+	bool rgba;
+};
+
+//every kernel returns how many pixels it converted, the scalar one finishes the row
+using RowKernel = int (*)(const RowParameters& row);
+
+inline uint8_t clampPixel(int value) {
+	return static_cast<uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+void convertRowScalar(const RowParameters& row, int start) {
+	for(int x = start; x < row.width; ++ x) {
+		int chroma = (x >> 1) * row.chromaStep;
+		int y = ((row.y[x] - 16) * 8 * coefY >> 16) + 1;
+		int u = (row.u[chroma] - 128) * 8;
+		int v = (row.v[chroma] - 128) * 8;
+		uint8_t r = clampPixel(y + ((v * coefRV) >> 16));
+		uint8_t g = clampPixel(y - ((u * coefGU) >> 16) - ((v * coefGV) >> 16));
+		uint8_t b = clampPixel(y + ((u * coefBU) >> 16));
+		uint8_t* pixel = row.dst + x * 4;
+		pixel[0] = row.rgba ? r : b;
+		pixel[1] = g;
+		pixel[2] = row.rgba ? b : r;
+		pixel[3] = 255;
+	}
+}
+
+int convertRowNone(const RowParameters&) {
+	return 0;
+}
+
+#ifdef AVYUV_SSE2
+//u and v hold 8 chroma samples for 16 pixels
+inline void storePixelsSse2(const RowParameters& row, int x, __m128i yLow, __m128i yHigh, __m128i u, __m128i v) {
+	const __m128i offsetY = _mm_set1_epi16(16);
+	const __m128i offsetC = _mm_set1_epi16(128);
+	u = _mm_slli_epi16(_mm_sub_epi16(u, offsetC), 3);
+	v = _mm_slli_epi16(_mm_sub_epi16(v, offsetC), 3);
+	__m128i uv[2][2] = {{_mm_unpacklo_epi16(u, u), _mm_unpackhi_epi16(u, u)},
+						{_mm_unpacklo_epi16(v, v), _mm_unpackhi_epi16(v, v)}};
+	__m128i luma[2] = {yLow, yHigh};
+	__m128i r[2], g[2], b[2];
+	for(int half = 0; half < 2; ++ half) {
+		__m128i y = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(luma[half], offsetY), 3), _mm_set1_epi16(coefY));
+		y = _mm_add_epi16(y, _mm_set1_epi16(1));
+		__m128i uh = uv[0][half];
+		__m128i vh = uv[1][half];
+		r[half] = _mm_add_epi16(y, _mm_mulhi_epi16(vh, _mm_set1_epi16(coefRV)));
+		g[half] = _mm_sub_epi16(_mm_sub_epi16(y, _mm_mulhi_epi16(uh, _mm_set1_epi16(coefGU))), _mm_mulhi_epi16(vh, _mm_set1_epi16(coefGV)));
+		b[half] = _mm_add_epi16(y, _mm_mulhi_epi16(uh, _mm_set1_epi16(coefBU)));
+	}
+	__m128i red = _mm_packus_epi16(r[0], r[1]);
+	__m128i green = _mm_packus_epi16(g[0], g[1]);
+	__m128i blue = _mm_packus_epi16(b[0], b[1]);
+	__m128i alpha = _mm_set1_epi8(static_cast<char>(255));
+	__m128i first = row.rgba ? red : blue;
+	__m128i third = row.rgba ? blue : red;
+	__m128i firstSecondLow = _mm_unpacklo_epi8(first, green);
+	__m128i firstSecondHigh = _mm_unpackhi_epi8(first, green);
+	__m128i thirdAlphaLow = _mm_unpacklo_epi8(third, alpha);
+	__m128i thirdAlphaHigh = _mm_unpackhi_epi8(third, alpha);
+	__m128i* dst = reinterpret_cast<__m128i*>(row.dst + x * 4);
+	_mm_storeu_si128(dst, _mm_unpacklo_epi16(firstSecondLow, thirdAlphaLow));
+	_mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(firstSecondLow, thirdAlphaLow));
+	_mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(firstSecondHigh, thirdAlphaHigh));
+	_mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(firstSecondHigh, thirdAlphaHigh));
+}
+
+inline void loadChromaSse2(const RowParameters& row, int x, __m128i& u, __m128i& v) {
+	const __m128i zero = _mm_setzero_si128();
+	if(row.chromaStep == 2) {
+		__m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row.u + x));
+		u = _mm_and_si128(uv, _mm_set1_epi16(0xff));
+		v = _mm_srli_epi16(uv, 8);
+	}else {
+		u = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row.u + x / 2)), zero);
+		v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row.v + x / 2)), zero);
+	}
+}
+
+int convertRowSse2(const RowParameters& row) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+	for(; x + 16 <= row.width; x += 16) {
+		__m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row.y + x));
+		__m128i u, v;
+		loadChromaSse2(row, x, u, v);
+		storePixelsSse2(row, x, _mm_unpacklo_epi8(luma, zero), _mm_unpackhi_epi8(luma, zero), u, v);
+	}
+	return x;
+}
+#endif
+
+#ifdef AVYUV_AVX2
+__attribute__((target("avx2")))
+int convertRowAvx2(const RowParameters& row) {
+	const __m256i offsetY = _mm256_set1_epi16(16);
+	const __m256i offsetC = _mm256_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi8(static_cast<char>(255));
+	int x = 0;
+	for(; x + 16 <= row.width; x += 16) {
+		__m256i y = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row.y + x)));
+		__m128i u8, v8;
+		if(row.chromaStep == 2) {
+			__m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row.u + x));
+			u8 = _mm_packus_epi16(_mm_and_si128(uv, _mm_set1_epi16(0xff)), _mm_setzero_si128());
+			v8 = _mm_packus_epi16(_mm_srli_epi16(uv, 8), _mm_setzero_si128());
+		}else {
+			u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row.u + x / 2));
+			v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row.v + x / 2));
+		}
+		__m256i u = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8));
+		__m256i v = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8));
+		u = _mm256_slli_epi16(_mm256_sub_epi16(u, offsetC), 3);
+		v = _mm256_slli_epi16(_mm256_sub_epi16(v, offsetC), 3);
+		y = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(y, offsetY), 3), _mm256_set1_epi16(coefY));
+		y = _mm256_add_epi16(y, _mm256_set1_epi16(1));
+		__m256i r = _mm256_add_epi16(y, _mm256_mulhi_epi16(v, _mm256_set1_epi16(coefRV)));
+		__m256i g = _mm256_sub_epi16(_mm256_sub_epi16(y, _mm256_mulhi_epi16(u, _mm256_set1_epi16(coefGU))),
+									 _mm256_mulhi_epi16(v, _mm256_set1_epi16(coefGV)));
+		__m256i b = _mm256_add_epi16(y, _mm256_mulhi_epi16(u, _mm256_set1_epi16(coefBU)));
+
+		__m128i red = _mm_packus_epi16(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+		__m128i green = _mm_packus_epi16(_mm256_castsi256_si128(g), _mm256_extracti128_si256(g, 1));
+		__m128i blue = _mm_packus_epi16(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+		__m128i first = row.rgba ? red : blue;
+		__m128i third = row.rgba ? blue : red;
+		__m256i firstSecond = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(first, green)), _mm_unpackhi_epi8(first, green), 1);
+		__m256i thirdAlpha = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(third, alpha)), _mm_unpackhi_epi8(third, alpha), 1);
+		__m256i pixelsLow = _mm256_unpacklo_epi16(firstSecond, thirdAlpha); //pixels 0-3 and 8-11
+		__m256i pixelsHigh = _mm256_unpackhi_epi16(firstSecond, thirdAlpha); //pixels 4-7 and 12-15
+		__m256i* dst = reinterpret_cast<__m256i*>(row.dst + x * 4);
+		_mm256_storeu_si256(dst, _mm256_permute2x128_si256(pixelsLow, pixelsHigh, 0x20));
+		_mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(pixelsLow, pixelsHigh, 0x31));
+	}
+	return x;
+}
+#endif
+
+#ifdef AVYUV_NEON
+inline int16x8_t mulhiNeon(int16x8_t a, int16_t b) {
+	return vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(a), b), 16),
+						vshrn_n_s32(vmull_n_s16(vget_high_s16(a), b), 16));
+}
+
+int convertRowNeon(const RowParameters& row) {
+	int x = 0;
+	for(; x + 16 <= row.width; x += 16) {
+		uint8x16_t luma = vld1q_u8(row.y + x);
+		uint8x8_t u8, v8;
+		if(row.chromaStep == 2) {
+			uint8x8x2_t uv = vld2_u8(row.u + x);
+			u8 = uv.val[0];
+			v8 = uv.val[1];
+		}else {
+			u8 = vld1_u8(row.u + x / 2);
+			v8 = vld1_u8(row.v + x / 2);
+		}
+		uint8x8x2_t uPairs = vzip_u8(u8, u8);
+		uint8x8x2_t vPairs = vzip_u8(v8, v8);
+		uint8x8_t lumaHalves[2] = {vget_low_u8(luma), vget_high_u8(luma)};
+		uint8x8x4_t pixels[2];
+		for(int half = 0; half < 2; ++ half) {
+			int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(lumaHalves[half]));
+			int16x8_t u = vreinterpretq_s16_u16(vmovl_u8(uPairs.val[half]));
+			int16x8_t v = vreinterpretq_s16_u16(vmovl_u8(vPairs.val[half]));
+			y = vaddq_s16(mulhiNeon(vshlq_n_s16(vsubq_s16(y, vdupq_n_s16(16)), 3), coefY), vdupq_n_s16(1));
+			u = vshlq_n_s16(vsubq_s16(u, vdupq_n_s16(128)), 3);
+			v = vshlq_n_s16(vsubq_s16(v, vdupq_n_s16(128)), 3);
+			uint8x8_t red = vqmovun_s16(vaddq_s16(y, mulhiNeon(v, coefRV)));
+			uint8x8_t green = vqmovun_s16(vsubq_s16(vsubq_s16(y, mulhiNeon(u, coefGU)), mulhiNeon(v, coefGV)));
+			uint8x8_t blue = vqmovun_s16(vaddq_s16(y, mulhiNeon(u, coefBU)));
+			pixels[half].val[0] = row.rgba ? red : blue;
+			pixels[half].val[1] = green;
+			pixels[half].val[2] = row.rgba ? blue : red;
+			pixels[half].val[3] = vdup_n_u8(255);
+		}
+		vst4_u8(row.dst + x * 4, pixels[0]);
+		vst4_u8(row.dst + x * 4 + 32, pixels[1]);
+	}
+	return x;
+}
+#endif
+
+struct Kernel {
+	RowKernel convertRow;
+	const char* name;
+};
+
+Kernel selectKernel() {
+	int cpuFlags = av_get_cpu_flags();
+	(void)cpuFlags;
+#ifdef AVYUV_AVX2
+	if(cpuFlags & AV_CPU_FLAG_AVX2) {
+		return Kernel{&convertRowAvx2, "avx2"};
+	}
+#endif
+#ifdef AVYUV_SSE2
+	if(cpuFlags & AV_CPU_FLAG_SSE2) {
+		return Kernel{&convertRowSse2, "sse2"};
+	}
+#endif
+#ifdef AVYUV_NEON
+	if(cpuFlags & AV_CPU_FLAG_NEON) {
+		return Kernel{&convertRowNeon, "neon"};
+	}
+#endif
+	return Kernel{&convertRowNone, "scalar"};
+}
+
+const Kernel& kernel() {
+	static const Kernel selected = selectKernel();
+	return selected;
+}
+
+}
+
+bool AVYuvConverter::canConvert(AVPixelFormat srcFormat, int srcW, int srcH, AVPixelFormat dstFormat, int dstW, int dstH, int flags) {
+	if(srcFormat != AV_PIX_FMT_YUV420P && srcFormat != AV_PIX_FMT_NV12) {
+		return false;
+	}
+	if(dstFormat != AV_PIX_FMT_BGRA && dstFormat != AV_PIX_FMT_RGBA) {
+		return false;
+	}
+	if(flags & (SWS_ACCURATE_RND | SWS_BITEXACT | SWS_FULL_CHR_H_INT)) { //the caller asked for swscale's exact path
+		return false;
+	}
+	return srcW == dstW && srcH == dstH && srcW > 0 && srcH > 0;
+}
+
+void AVYuvConverter::convert(const uint8_t* const srcData[], const int srcLinesize[], AVPixelFormat srcFormat,
+							 uint8_t* dst, int dstLinesize, AVPixelFormat dstFormat, int width, int height) {
+	const Kernel& selected = kernel();
+	bool nv12 = srcFormat == AV_PIX_FMT_NV12;
+	RowParameters row;
+	row.chromaStep = nv12 ? 2 : 1;
+	row.width = width;
+	row.rgba = dstFormat == AV_PIX_FMT_RGBA;
+	for(int y = 0; y < height; ++ y) {
+		row.y = srcData[0] + y * srcLinesize[0];
+		row.u = srcData[1] + (y >> 1) * srcLinesize[1];
+		row.v = nv12 ? row.u + 1 : srcData[2] + (y >> 1) * srcLinesize[2];
+		row.dst = dst + y * dstLinesize;
+		convertRowScalar(row, selected.convertRow(row));
+	}
+}
+
+const char* AVYuvConverter::kernelName() {
+	return kernel().name;
+}
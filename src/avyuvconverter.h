@@ -0,0 +1,26 @@
+#ifndef AVYUVCONVERTER_H
+#define AVYUVCONVERTER_H
+
+extern "C" {
+	#include <libavutil/cpu.h>
+	#include <libavutil/pixfmt.h>
+	#include <libswscale/swscale.h>
+}
+
+#include <cstdint>
+
+//Same size YUV420P/NV12 to BGRA/RGBA without swscale, BT.601 limited range like swscale's default.
+//Chroma is taken from the nearest sample, like swscale's unscaled yuv2rgb path.
+//The AVX2, SSE2 and NEON kernels produce the same output as the scalar one.
+//The output isn't bit-exact with swscale, VideoDecoder uses it only when fastConversionFlag is in the converting flags.
+class AVYuvConverter {
+	public:
+		static const int fastConversionFlag = 0x40000000; //outside of the SWS_* bits
+
+		static bool canConvert(AVPixelFormat srcFormat, int srcW, int srcH, AVPixelFormat dstFormat, int dstW, int dstH, int flags);
+		static void convert(const uint8_t* const srcData[], const int srcLinesize[], AVPixelFormat srcFormat,
+							uint8_t* dst, int dstLinesize, AVPixelFormat dstFormat, int width, int height);
+		static const char* kernelName(); //the kernel selected for this CPU
+};
+
+#endif // AVYUVCONVERTER_H
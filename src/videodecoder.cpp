@@ -1,10 +1,22 @@
 #include "videodecoder.h"
 
 VideoDecoder::~VideoDecoder() {
+	std::unique_lock<std::mutex> binLocker(lentFrames->mutex);
+	lentFrames->decoderAlive = false;
+	for(AVFrame* lentFrame : lentFrames->frames) {
+		framePool->freeImage(lentFrame->data);
+		av_frame_free(&lentFrame);
+	}
+	lentFrames->frames.clear();
+	binLocker.unlock();
+	for(auto& frameContainer : frame) { //the images go back before the pool goes, the ring is destroyed after it
+		frameContainer.resetPtr();
+	}
 	if(convertContext != nullptr) {
 		sws_freeContext(convertContext);
 		convertContext = nullptr;
 	}
+	freeScaled();
 }
 
 bool VideoDecoder::start() {
@@ -16,107 +28,40 @@ bool VideoDecoder::start() {
 	frameShowDelay = 0;
 	lastFrameReadIndex = -1;
 	videoRtspDiferencePts = 0.0;
-	return AVBaseDecoder::start();
+	return AVFrameDecoder::start();
 }
 
 void VideoDecoder::stop() {
-	AVBaseDecoder::stop();
+	AVFrameDecoder::stop();
 	if(convertContext != nullptr) {
 		sws_freeContext(convertContext);
+		slicedScaler.free();
 		convertContext = nullptr;
 	}
+	freeScaled();
 }
 
 bool VideoDecoder::hasData() {
-	return frameWriteIndex != frameReadIndex;
+	return !frame.isEmpty();
 }
 
 bool VideoDecoder::getData(uint8_t** data, int* linesize) {
 	bool result = false;
-	if(frameWriteIndex == frameReadIndex)
+	if(frame.isEmpty())
 		return result;
 
-	if(!timeInitialized) {
-		timeInitialized = true;
-		startTime = av_gettime();
-	}
-	int64_t now = av_gettime();
-	if(now - lastTime >= frameShowDelay) {
-		lastTime = now;
-		std::unique_lock<std::mutex> frameLocker(frameMutex, std::try_to_lock);
-		if(!frameLocker.owns_lock()) {
-			while(!frameLocker.try_lock());
-		}
-		if(stopping) return false;
-		AVFrame* decodedFrame = frame[static_cast<unsigned>(frameReadIndex)].getPtr();
+	int64_t now = 0;
+	if(isTimeToShow(now)) {
+		std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //only a reconfiguration can hold it, decoding doesn't
+		lockCounted(frameLocker, consumerLockWaiting);
+		if(frame.isEmpty()) return false; //a reconfiguration could drop the frames
+		dropStaleFrames();
+		AVFrame* decodedFrame = frame.front().getPtr();
 		av_image_copy(&data[0], &linesize[0],
 					  const_cast<const uint8_t**>(&decodedFrame->data[0]), &decodedFrame->linesize[0],
 					  destPixFormat, destWidth, destHeight);
-
-		++ frameReadIndex;
-		if(static_cast<unsigned>(frameReadIndex) >= frame.size()) {
-			frameReadIndex = 0;
-		}
-		double pts = getPts(decodedFrame);
-
-		int64_t diffPts = static_cast<int64_t>(pts - videoLastPts);
-		if(videoLastPts == 0.0 && diffPts > 0.5) {
-			videoRtspDiferencePts = pts;
-		}else if(diffPts < 0.0) {
-			videoRtspDiferencePts = 0.0;
-			startTime = now;
-		}
-
-		std::unique_lock<std::mutex> synchLocker(synchronizeMutex);
-		if(needSynchronizeToAudio) {
-			audioLastPts += static_cast<double>((now - audioLastPtsCheckTime)) / 1000000;
-			audioLastPtsCheckTime = now;
-			if(audioPtsIdUpdated) {
-				audioLastPts -= audioRtspDiferencePts;
-				audioPtsIdUpdated = false;
-			}
-			double diff = (audioLastPts - pts) * 1000000.0;
-			if((diff >= -2000) && (diff <= 2000)) {
-				stabilized = true;
-			}else if((diff < -100000) || (diff > 100000)) {
-				stabilized = false;
-			}else if(stabilized) {
-				diff = diff > 5000 ? 5000
-								   : diff < -5000 ? -5000
-												  : diff;
-			}
-			diffPts = static_cast<int64_t>(diff);
-		}else {
-			double lastTimePts = videoLastPts;
-			double nextTime = lastTimePts + diffPts - videoRtspDiferencePts;
-			double diff = (now - startTime) - (nextTime * 1000000);
-			diffPts = static_cast<int64_t>(diff);
-		}
-		synchLocker.unlock();
-
-		double frameDelay = av_q2d(codecContext->time_base);
-		frameDelay = static_cast<double>(decodedFrame->repeat_pict) * (frameDelay * 0.5); //@TODO delay = repeat_pict / 2 * fps
-		videoLastPts = pts;
-
-		if(frameReadIndex != frameWriteIndex) {
-			AVFrame* nextDecodedFrame = frame[static_cast<unsigned>(frameReadIndex)].getPtr();
-			double nextPts = getPts(nextDecodedFrame);
-			if(nextPts > videoLastPts) {
-				int64_t nextDelay = static_cast<int64_t>((nextPts - videoLastPts) * 1000000.0);
-				frameShowDelay = nextDelay - diffPts;
-			}
-		}else {
-			frameShowDelay -= diffPts;
-		}
-		frameShowDelay += frameDelay * 1000000;
-		if(frameShowDelay < 0) {
-			frameShowDelay = 0;
-		}else if(frameShowDelay > 3000000) {
-			frameShowDelay = 42000;
-		}
-
+		frameShown(decodedFrame, now);
 		frameLocker.unlock();
-		frameCond.notify_one();
 		result = true;
 	}
 	return result;
@@ -124,95 +69,130 @@ bool VideoDecoder::getData(uint8_t** data, int* linesize) {
 
 bool VideoDecoder::getData(uint8_t* data, int dataSize) {
 	bool result = false;
-	if(frameWriteIndex == frameReadIndex)
+	if(frame.isEmpty())
 		return result;
 
-	if(!timeInitialized) {
-		timeInitialized = true;
-		startTime = av_gettime();
-	}
-	int64_t now = av_gettime();
-	if(now - lastTime >= frameShowDelay) {
-		lastTime = now;
-		std::unique_lock<std::mutex> frameLocker(frameMutex, std::try_to_lock);
-		if(!frameLocker.owns_lock()) {
-			while(!frameLocker.try_lock());
-		}
-		if(stopping) return false;
-		AVFrame* decodedFrame = frame[static_cast<unsigned>(frameReadIndex)].getPtr();
+	int64_t now = 0;
+	if(isTimeToShow(now)) {
+		std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //only a reconfiguration can hold it, decoding doesn't
+		lockCounted(frameLocker, consumerLockWaiting);
+		if(frame.isEmpty()) return false;
+		dropStaleFrames();
+		AVFrame* decodedFrame = frame.front().getPtr();
 		av_image_copy_to_buffer(&data[0], dataSize, const_cast<const uint8_t**>(&decodedFrame->data[0]), &decodedFrame->linesize[0], destPixFormat, destWidth, destHeight, 32);
-		++ frameReadIndex;
-		if(static_cast<unsigned>(frameReadIndex) >= frame.size()) {
-			frameReadIndex = 0;
-		}
-		double pts = getPts(decodedFrame);
-
-		int64_t diffPts = static_cast<int64_t>(pts - videoLastPts);
-		if(videoLastPts == 0.0 && diffPts > 0.5) {
-			videoRtspDiferencePts = pts;
-		}else if(diffPts < 0.0) {
-			videoRtspDiferencePts = 0.0;
-			startTime = now;
+		frameShown(decodedFrame, now);
+		frameLocker.unlock();
+		result = true;
+	}
+	return result;
+}
+
+VideoFrameRef VideoDecoder::borrowData() {
+	VideoFrameRef result = nullptr;
+	if(frame.isEmpty())
+		return result;
+
+	int64_t now = 0;
+	if(isTimeToShow(now)) {
+		std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //only a reconfiguration can hold it, decoding doesn't
+		lockCounted(frameLocker, consumerLockWaiting);
+		if(frame.isEmpty()) return result;
+		dropStaleFrames();
+		AVFrame* spareFrame = getSpareFrame();
+		if(spareFrame == nullptr) {
+			return result;
 		}
+		AVFrame* decodedFrame = frame.front().takePtr();
+		frame.front().setReferencedPtr(spareFrame);
+		result = makeFrameRef(decodedFrame);
+		frameShown(decodedFrame, now);
+		frameLocker.unlock();
+	}
+	return result;
+}
 
-		std::unique_lock<std::mutex> synchLocker(synchronizeMutex);
-		if(needSynchronizeToAudio) {
-			audioLastPts += static_cast<double>((now - audioLastPtsCheckTime)) / 1000000;
-			audioLastPtsCheckTime = now;
-			if(audioPtsIdUpdated) {
-				audioLastPts -= audioRtspDiferencePts;
-				audioPtsIdUpdated = false;
-			}
-			double diff = (audioLastPts - pts) * 1000000.0;
-			if((diff >= -2000) && (diff <= 2000)) {
-				stabilized = true;
-			}else if((diff < -100000) || (diff > 100000)) {
-				stabilized = false;
-			}else if(stabilized) {
-				diff = diff > 5000 ? 5000
-								   : diff < -5000 ? -5000
-												  : diff;
-			}
-			diffPts = static_cast<int64_t>(diff);
-		}else {
-			double lastTimePts = videoLastPts;
-			double nextTime = lastTimePts + diffPts - videoRtspDiferencePts;
-			double diff = (now - startTime) - (nextTime * 1000000);
-			diffPts = static_cast<int64_t>(diff);
+int VideoDecoder::borrowBatch(VideoFrameRef* frames, int maxFrames, double* pts) {
+	if(frame.isEmpty() || maxFrames <= 0)
+		return 0;
+
+	int taken = 0;
+	std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //once for the whole batch
+	lockCounted(frameLocker, consumerLockWaiting);
+	while(taken < maxFrames && !frame.isEmpty()) {
+		AVFrame* spareFrame = getSpareFrame();
+		if(spareFrame == nullptr) {
+			break;
 		}
-		synchLocker.unlock();
-
-		double frameDelay = av_q2d(codecContext->time_base);
-		frameDelay = static_cast<double>(decodedFrame->repeat_pict) * (frameDelay * 0.5); //@TODO delay = repeat_pict / 2 * fps
-		videoLastPts = pts;
-
-		if(frameReadIndex != frameWriteIndex) {
-			AVFrame* nextDecodedFrame = frame[static_cast<unsigned>(frameReadIndex)].getPtr();
-			double nextPts = getPts(nextDecodedFrame);
-			if(nextPts > videoLastPts) {
-				int64_t nextDelay = static_cast<int64_t>((nextPts - videoLastPts) * 1000000.0);
-				frameShowDelay = nextDelay - diffPts;
-			}
-		}else {
-			frameShowDelay -= diffPts;
+		AVFrame* decodedFrame = frame.front().takePtr();
+		frame.front().setReferencedPtr(spareFrame);
+		frames[taken] = makeFrameRef(decodedFrame);
+		if(pts != nullptr) {
+			pts[taken] = frames[taken]->pts;
 		}
-		frameShowDelay += frameDelay * 1000000;
-		if(frameShowDelay < 0) {
-			frameShowDelay = 0;
-		}else if(frameShowDelay > 3000000) {
-			frameShowDelay = 42000;
+		frame.pop();
+		++ taken;
+	}
+	frameLocker.unlock();
+	batchTaken(taken);
+	return taken;
+}
+
+int VideoDecoder::getBatch(uint8_t* data, int dataSize, int maxFrames, double* pts) {
+	if(frame.isEmpty() || maxFrames <= 0)
+		return 0;
+
+	int taken = 0;
+	std::unique_lock<std::mutex> frameLocker(frameMutex, std::defer_lock); //once for the whole batch
+	lockCounted(frameLocker, consumerLockWaiting);
+	int frameSize = av_image_get_buffer_size(destPixFormat, destWidth, destHeight, 1);
+	if(frameSize <= 0) {
+		return 0;
+	}
+	int fittingFrames = dataSize / frameSize;
+	if(maxFrames > fittingFrames) {
+		maxFrames = fittingFrames;
+	}
+	while(taken < maxFrames && !frame.isEmpty()) {
+		AVFrame* decodedFrame = frame.front().getPtr();
+		av_image_copy_to_buffer(&data[static_cast<size_t>(taken) * frameSize], frameSize, const_cast<const uint8_t**>(&decodedFrame->data[0]), &decodedFrame->linesize[0],
+								destPixFormat, destWidth, destHeight, 1);
+		if(pts != nullptr) {
+			pts[taken] = getPts(decodedFrame);
 		}
+		frame.pop();
+		++ taken;
+	}
+	frameLocker.unlock();
+	batchTaken(taken);
+	return taken;
+}
 
-		frameLocker.unlock();
-		frameCond.notify_one();
-		result = true;
+bool VideoDecoder::setConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW, int dstH, int slices) {
+	return configureOutput(dstFormat, false, AVTensorConverter::Normalization(), flags, dstW, dstH, slices);
+}
+
+bool VideoDecoder::setTensorOutput(AVTensorConverter::Type type, const AVTensorConverter::Normalization& normalization, int flags, int dstW, int dstH, int slices) {
+	for(int channel = 0; channel < 3; ++ channel) {
+		if(normalization.std[channel] == 0.0f) {
+			return false;
+		}
 	}
-	return result;
+	return configureOutput(AVTensorConverter::storageFormat(type), true, normalization, flags, dstW, dstH, slices);
 }
 
-bool VideoDecoder::setConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW, int dstH) {
+bool VideoDecoder::configureOutput(AVPixelFormat dstFormat, bool tensor, const AVTensorConverter::Normalization& normalization, int flags, int dstW, int dstH, int slices) {
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	std::unique_lock<std::mutex> frameLocker(frameMutex);
 	if(stopping) return false;
+	bool wasTensor = tensorOutput;
+	tensorOutput = tensor;
+	tensorNormalization = normalization;
+	AVTensorConverter::isStorageFormat(dstFormat, tensorType);
+	AVPixelFormat scaledFormat = tensor ? AV_PIX_FMT_GBRP : dstFormat;
+	convertSlices = std::max(1, slices);
+	fastYuvConversion = (flags & AVYuvConverter::fastConversionFlag) != 0;
+	flags &= ~AVYuvConverter::fastConversionFlag; //swscale never sees it
+	slicedScaler.free();
 	SwsContext* newContext = nullptr;
 	if(codecContext) {
 		dstW = dstW == -1 ? codecContext->width : dstW;
@@ -233,7 +213,7 @@ bool VideoDecoder::setConvertingParameters(AVPixelFormat dstFormat, int flags, i
 										codecContext->width, codecContext->height,
 										codecContext->pix_fmt,
 										dstW, dstH,
-										dstFormat, flags,
+										scaledFormat, flags,
 										nullptr, nullptr, nullptr);
 		}
 	}
@@ -261,7 +241,7 @@ bool VideoDecoder::setConvertingParameters(AVPixelFormat dstFormat, int flags, i
 		destWidth = dstW;
 		destHeight = dstH;
 		convertFlags = flags;
-		reconvertAll(oldPixFormat, oldWidth, oldHeight);
+		reconvertAll(wasTensor || tensor ? AVPixelFormat::AV_PIX_FMT_NONE : oldPixFormat, oldWidth, oldHeight); //channel planes can't be rescaled as pixels
 	}
 	srcHeight = codecContext->height;
 	srcWidth = codecContext->width;
@@ -269,6 +249,10 @@ bool VideoDecoder::setConvertingParameters(AVPixelFormat dstFormat, int flags, i
 	return true;
 }
 
+void VideoDecoder::setPaced(bool enabled) {
+	paced = enabled;
+}
+
 void VideoDecoder::setAudioPts(double newAudioLastPts, int64_t checkTime, double newRtspDifferencePts) {
 	std::unique_lock<std::mutex> synchLocker(synchronizeMutex);
 	if(stopping) return;
@@ -280,7 +264,7 @@ void VideoDecoder::setAudioPts(double newAudioLastPts, int64_t checkTime, double
 }
 
 int VideoDecoder::getSourceWidth() {
-	std::unique_lock<std::mutex> frameLocker(frameMutex);
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	if(!codecContext) {
 		return -1;
 	}
@@ -288,7 +272,7 @@ int VideoDecoder::getSourceWidth() {
 }
 
 int VideoDecoder::getSourceHeigth() {
-	std::unique_lock<std::mutex> frameLocker(frameMutex);
+	std::unique_lock<std::mutex> codecLocker(codecMutex);
 	if(!codecContext) {
 		return -1;
 	}
@@ -303,15 +287,31 @@ int VideoDecoder::getDestinationHeigth() {
 	return destHeight;
 }
 
+uint64_t VideoDecoder::getDroppedFrames() {
+	return droppedFrames;
+}
+
+AVBaseDecoder::Stats VideoDecoder::getStats() {
+	Stats stats = AVFrameDecoder::getStats();
+	stats.framesDropped += droppedFrames;
+	return stats;
+}
+
+AVFramePool::Stats VideoDecoder::getFramePoolStats() {
+	return framePool->getStats();
+}
+
 bool VideoDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 	if(convertContext != nullptr) {
 		if(srcHeight != codecContext->height || srcWidth != codecContext->width || srcPixFormat != codecContext->pix_fmt) {
 			sws_freeContext(convertContext);
+			slicedScaler.free();
 			convertContext = nullptr;
 		}
 	}
 	if(convertContext == nullptr) {
 		if(codecContext->width > 0 && codecContext->height > 0 && codecContext->pix_fmt != AVPixelFormat::AV_PIX_FMT_NONE) {
+			std::lock_guard<std::mutex> frameLocker(frameMutex); //the destination size and the ring change under the consumer
 			if(destHeight <= 0) {
 				destHeight = codecContext->height;
 			}
@@ -323,7 +323,7 @@ bool VideoDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 										codecContext->width, codecContext->height,
 										codecContext->pix_fmt,
 										destWidth, destHeight,
-										destPixFormat, convertFlags,
+										scalerFormat(), convertFlags,
 										nullptr, nullptr, nullptr);
 			if(convertContext == nullptr) {
 				return false;
@@ -337,12 +337,33 @@ bool VideoDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 		}
 	}
 
+	if(dest->data[0] != nullptr && (dest->width != destWidth || dest->height != destHeight || dest->format != destPixFormat)) {
+		framePool->freeImage(dest->data); //the slot's image is from before the output changed
+	}
 	dest->format = destPixFormat;
 	dest->width = destWidth;
 	dest->height = destHeight;
 	dest->pkt_dts = source->pkt_dts;
 	dest->pts = source->pts;
 	dest->repeat_pict = source->repeat_pict;
+	if(dest->data[0] == nullptr && framePool->allocImage(dest->data, dest->linesize, destWidth, destHeight, destPixFormat) < 0) {
+		return false;
+	}
+	if(tensorOutput) {
+		return convertToTensor(dest, source);
+	}
+	if(fastYuvConversion && AVYuvConverter::canConvert(codecContext->pix_fmt, codecContext->width, codecContext->height, destPixFormat, destWidth, destHeight, convertFlags)) {
+		AVYuvConverter::convert(source->data, source->linesize, codecContext->pix_fmt,
+								dest->data[0], dest->linesize[0], destPixFormat, destWidth, destHeight);
+		return true;
+	}
+	if(convertSlices > 1 && !slicedScaler.isReady()) {
+		slicedScaler.init(codecContext->width, codecContext->height, codecContext->pix_fmt,
+						  destWidth, destHeight, destPixFormat, convertFlags, convertSlices);
+	}
+	if(slicedScaler.isReady()) {
+		return slicedScaler.scale(source->data, source->linesize, dest->data, dest->linesize);
+	}
 	if(sws_scale(convertContext, source->data, source->linesize, 0, codecContext->height, dest->data, dest->linesize) > 0) {
 		return true;
 	}else {
@@ -350,12 +371,49 @@ bool VideoDecoder::convertFrame(AVFrame* dest, AVFrame* source) {
 	}
 }
 
+AVPixelFormat VideoDecoder::scalerFormat() {
+	return tensorOutput ? AV_PIX_FMT_GBRP : destPixFormat;
+}
+
+bool VideoDecoder::convertToTensor(AVFrame* dest, AVFrame* source) {
+	if(scaledData[0] == nullptr || scaledWidth != destWidth || scaledHeight != destHeight) {
+		freeScaled();
+		if(av_image_alloc(scaledData, scaledLinesize, destWidth, destHeight, AV_PIX_FMT_GBRP, 32) < 0) {
+			return false;
+		}
+		scaledWidth = destWidth;
+		scaledHeight = destHeight;
+	}
+	//only the 8 bit picture goes through the scaler, the float planes are written once
+	if(convertSlices > 1 && !slicedScaler.isReady()) {
+		slicedScaler.init(codecContext->width, codecContext->height, codecContext->pix_fmt,
+						  destWidth, destHeight, AV_PIX_FMT_GBRP, convertFlags, convertSlices);
+	}
+	if(slicedScaler.isReady()) {
+		if(!slicedScaler.scale(source->data, source->linesize, scaledData, scaledLinesize)) {
+			return false;
+		}
+	}else if(sws_scale(convertContext, source->data, source->linesize, 0, codecContext->height, scaledData, scaledLinesize) <= 0) {
+		return false;
+	}
+	AVTensorConverter::convert(scaledData, scaledLinesize, dest->data, dest->linesize, destWidth, destHeight, tensorType, tensorNormalization);
+	return true;
+}
+
+void VideoDecoder::freeScaled() {
+	if(scaledData[0] != nullptr) {
+		av_freep(&scaledData[0]);
+	}
+	scaledWidth = 0;
+	scaledHeight = 0;
+}
+
 void VideoDecoder::reconvertAll(AVPixelFormat oldPixFormat, int oldWidth, int oldHeight) {
+	int frameReadIndex = static_cast<int>(frame.readIndex());
+	int frameWriteIndex = static_cast<int>(frame.writeIndex());
 	if(frameReadIndex == frameWriteIndex) {
-		for(unsigned int i = 0; i < frame.size(); ++ i) {
+		for(unsigned int i = 0; i < frame.size(); ++ i) { //the converter allocates the new images when it fills the slots
 			frame[i].unrefPtr();
-			av_image_alloc(frame[i].getPtr()->data, frame[i].getPtr()->linesize, destWidth, destHeight, destPixFormat, 32);
-			frame[i].markPtrHowReferenced();
 		}
 	}else {
 		bool good = false;
@@ -369,28 +427,24 @@ void VideoDecoder::reconvertAll(AVPixelFormat oldPixFormat, int oldWidth, int ol
 			if(tempContext != nullptr) {
 				good = true;
 				for(int isign = frameReadIndex; std::abs(isign - frameWriteIndex) > 0; ++ isign) { //rescale already decoded frames
-					AVFrame* dest = av_frame_alloc();
-					av_image_alloc(dest->data, dest->linesize, destWidth, destHeight, destPixFormat, 32);
-					int temp = 0;
-					auto deleter = [&](int*) {
-						if(dest) {
-							av_freep(&dest->data[0]);
-							av_frame_free(&dest);
-						}
-					};
-					std::unique_ptr<int, decltype(deleter)> frameDeleter(&temp, deleter);
+					uint8_t* destData[4] = {nullptr};
+					int destLinesize[4] = {0};
+					if(framePool->allocImage(destData, destLinesize, destWidth, destHeight, destPixFormat) < 0) {
+						good = false; //the frames are dropped below
+						break;
+					}
 
 					unsigned int i = static_cast<unsigned>(isign);
-					dest->format = destPixFormat;
-					dest->width = destWidth;
-					dest->height = destHeight;
-					dest->pkt_dts = frame[i].getPtr()->pkt_dts;
-					dest->pts = frame[i].getPtr()->pts;
-					dest->repeat_pict = frame[i].getPtr()->repeat_pict;
-					sws_scale(tempContext, frame[i].getPtr()->data, frame[i].getPtr()->linesize, 0, oldHeight, dest->data, dest->linesize);
-					frame[i].resetPtr();
-					frame[i].setReferencedPtr(dest);
-					dest = nullptr;
+					AVFrame* source = frame[i].getPtr();
+					sws_scale(tempContext, source->data, source->linesize, 0, oldHeight, destData, destLinesize);
+					framePool->freeImage(source->data);
+					for(unsigned int plane = 0; plane < 4; ++ plane) { //the frame keeps its timestamps
+						source->data[plane] = destData[plane];
+						source->linesize[plane] = destLinesize[plane];
+					}
+					source->format = destPixFormat;
+					source->width = destWidth;
+					source->height = destHeight;
 					if(static_cast<unsigned>(isign) >= frame.size() - 1) {
 						isign = -1;
 					}
@@ -399,38 +453,191 @@ void VideoDecoder::reconvertAll(AVPixelFormat oldPixFormat, int oldWidth, int ol
 			}
 		}
 		if(!good) {
-			for(int isign = frameReadIndex; std::abs(isign - frameWriteIndex) > 0; ++ isign) { //reset already decoded frames
+			for(unsigned int i = 0; i < frame.size(); ++ i) { //the decoded frames and the free slots, all of them have images of the old size
+				frame[i].unrefPtr();
+			}
+			frame.dropAll();
+			scheduleDecoding();
+		}else {
+			for(int isign = frameWriteIndex; std::abs(isign - frameReadIndex) > 0; ++ isign) { //free other frames
 				unsigned int i = static_cast<unsigned>(isign);
 				frame[i].unrefPtr();
 				if(static_cast<unsigned>(isign) >= frame.size() - 1) {
 					isign = -1;
 				}
 			}
-			frameReadIndex = frameWriteIndex;
 		}
+	}
+	resizeFrameRing(); //the budget is per byte, so the slots follow the frame size
+}
 
-		for(int isign = frameWriteIndex; std::abs(isign - frameReadIndex) > 0; ++ isign) { //reallock other frames
-			unsigned int i = static_cast<unsigned>(isign);
-			frame[i].unrefPtr();
-			av_image_alloc(frame[i].getPtr()->data, frame[i].getPtr()->linesize, destWidth, destHeight, destPixFormat, 32);
-			frame[i].markPtrHowReferenced();
-			if(static_cast<unsigned>(isign) >= frame.size() - 1) {
-				isign = -1;
-			}
+AVBaseDecoder::DecodingStep VideoDecoder::handleEndOfFile(std::unique_lock<std::mutex>&) {
+	return STEP_FINISHED;
+}
+
+void VideoDecoder::dropQueuedFrames() {
+	timingReset = true; //the slots keep their images, the converter writes over them
+}
+
+size_t VideoDecoder::frameBytes() {
+	if(convertContext == nullptr) {
+		return 0;
+	}
+	int size = av_image_get_buffer_size(destPixFormat, destWidth, destHeight, 32);
+	return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+bool VideoDecoder::isTimeToShow(int64_t& now) {
+	if(timingReset.exchange(false)) {
+		timeInitialized = false;
+		lastTime = 0;
+		frameShowDelay = 0;
+		videoLastPts = 0.0;
+		videoRtspDiferencePts = 0.0;
+	}
+	if(!timeInitialized) {
+		timeInitialized = true;
+		startTime = av_gettime();
+	}
+	now = av_gettime();
+	if(lowLatency || !paced || now - lastTime >= frameShowDelay) { //low latency shows a frame as soon as it is there
+		lastTime = now;
+		return true;
+	}
+	return false;
+}
+
+void VideoDecoder::frameShown(AVFrame* decodedFrame, int64_t now) {
+	double pts = getPts(decodedFrame);
+
+	int64_t diffPts = static_cast<int64_t>(pts - videoLastPts);
+	if(videoLastPts == 0.0 && diffPts > 0.5) {
+		videoRtspDiferencePts = pts;
+	}else if(diffPts < 0.0) {
+		videoRtspDiferencePts = 0.0;
+		startTime = now;
+	}
+
+	std::unique_lock<std::mutex> synchLocker(synchronizeMutex);
+	if(needSynchronizeToAudio) {
+		audioLastPts += static_cast<double>((now - audioLastPtsCheckTime)) / 1000000;
+		audioLastPtsCheckTime = now;
+		if(audioPtsIdUpdated) {
+			audioLastPts -= audioRtspDiferencePts;
+			audioPtsIdUpdated = false;
+		}
+		double diff = (audioLastPts - pts) * 1000000.0;
+		if((diff >= -2000) && (diff <= 2000)) {
+			stabilized = true;
+		}else if((diff < -100000) || (diff > 100000)) {
+			stabilized = false;
+		}else if(stabilized) {
+			diff = diff > 5000 ? 5000
+							   : diff < -5000 ? -5000
+											  : diff;
 		}
+		diffPts = static_cast<int64_t>(diff);
+	}else {
+		double lastTimePts = videoLastPts;
+		double nextTime = lastTimePts + diffPts - videoRtspDiferencePts;
+		double diff = (now - startTime) - (nextTime * 1000000);
+		diffPts = static_cast<int64_t>(diff);
+	}
+	synchLocker.unlock();
+
+	double frameDelay = av_q2d(codecContext->time_base);
+	frameDelay = static_cast<double>(decodedFrame->repeat_pict) * (frameDelay * 0.5); //@TODO delay = repeat_pict / 2 * fps
+	videoLastPts = pts;
+	frame.pop(); //the slot belongs to the decoder from here
+	scheduleDecoding();
+
+	if(!frame.isEmpty()) {
+		AVFrame* nextDecodedFrame = frame.front().getPtr();
+		double nextPts = getPts(nextDecodedFrame);
+		if(nextPts > videoLastPts) {
+			int64_t nextDelay = static_cast<int64_t>((nextPts - videoLastPts) * 1000000.0);
+			frameShowDelay = nextDelay - diffPts;
+		}
+	}else {
+		frameShowDelay -= diffPts;
+	}
+	frameShowDelay += frameDelay * 1000000;
+	if(frameShowDelay < 0) {
+		frameShowDelay = 0;
+	}else if(frameShowDelay > 3000000) {
+		frameShowDelay = 42000;
 	}
 }
 
-void VideoDecoder::handleEndOfFile(std::unique_lock<std::mutex>&) {
+void VideoDecoder::dropStaleFrames() {
+	if(!lowLatency) return;
+	while(frame.count() > 1) {
+		frame.pop();
+		++ droppedFrames;
+	}
+	scheduleDecoding();
+}
 
+VideoFrameRef VideoDecoder::makeFrameRef(AVFrame* decodedFrame) {
+	VideoFrameView* view = new VideoFrameView;
+	for(unsigned int i = 0; i < 4; ++ i) {
+		view->data[i] = decodedFrame->data[i];
+		view->linesize[i] = decodedFrame->linesize[i];
+	}
+	view->width = decodedFrame->width;
+	view->height = decodedFrame->height;
+	view->format = static_cast<AVPixelFormat>(decodedFrame->format);
+	view->pts = getPts(decodedFrame);
+	std::shared_ptr<LentFramesBin> bin = lentFrames;
+	std::shared_ptr<AVFramePool> pool = framePool;
+	return VideoFrameRef(view, [bin, pool, decodedFrame](const VideoFrameView* view) {
+		delete view;
+		AVFrame* lentFrame = decodedFrame;
+		std::unique_lock<std::mutex> binLocker(bin->mutex);
+		if(bin->decoderAlive) {
+			bin->frames.push_back(lentFrame);
+			return;
+		}
+		binLocker.unlock();
+		pool->freeImage(lentFrame->data);
+		av_frame_free(&lentFrame);
+	});
 }
 
-void VideoDecoder::initFrameBuffer() {
-	for(auto& frameContainer : frame) {
-		frameContainer.setDeleter([](AVFrame* frame) {av_frame_free(&frame);});
-		frameContainer.setUnreferencer([](AVFrame* frame) {av_freep(&frame->data[0]);});
-		frameContainer.setUnreferencedPtr(av_frame_alloc());
+void VideoDecoder::batchTaken(int framesCount) {
+	if(framesCount > 0) {
+		timingReset = true; //a paced consumer starts its clock again after a batch
+		scheduleDecoding();
+	}
+}
+
+AVFrame* VideoDecoder::getSpareFrame() {
+	AVFrame* spareFrame = nullptr;
+	std::unique_lock<std::mutex> binLocker(lentFrames->mutex);
+	if(!lentFrames->frames.empty()) {
+		spareFrame = lentFrames->frames.back();
+		lentFrames->frames.pop_back();
+	}
+	binLocker.unlock();
+
+	if(spareFrame == nullptr) {
+		spareFrame = av_frame_alloc();
+		if(spareFrame == nullptr) {
+			return nullptr;
+		}
+	}else if(spareFrame->width != destWidth || spareFrame->height != destHeight || spareFrame->format != destPixFormat) {
+		framePool->freeImage(spareFrame->data);
+	}
+	if(spareFrame->data[0] == nullptr) {
+		if(framePool->allocImage(spareFrame->data, spareFrame->linesize, destWidth, destHeight, destPixFormat) < 0) {
+			av_frame_free(&spareFrame);
+			return nullptr;
+		}
+		spareFrame->format = destPixFormat;
+		spareFrame->width = destWidth;
+		spareFrame->height = destHeight;
 	}
+	return spareFrame;
 }
 
 double VideoDecoder::getPts(AVFrame* decodedFrame) {
@@ -1,7 +1,11 @@
 #ifndef VIDEODECODER_H
 #define VIDEODECODER_H
 
-#include "avbasedecoder.h"
+#include "avframedecoder.h"
+#include "avframepool.h"
+#include "avslicedscaler.h"
+#include "avtensorconverter.h"
+#include "avyuvconverter.h"
 
 extern "C" {
 	#include <libswscale/swscale.h>
@@ -10,8 +14,35 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <vector>
 
-class VideoDecoder: public AVBaseDecoder {
+struct VideoFrameView {
+	uint8_t* data[4];
+	int linesize[4];
+	int width;
+	int height;
+	AVPixelFormat format;
+	double pts;
+};
+//the frame stays valid until the last copy of the reference is released
+using VideoFrameRef = std::shared_ptr<const VideoFrameView>;
+
+//the converted images come from the decoder's AVFramePool
+struct VideoFrameDeleter {
+	void operator () (AVFrame* frame) const {
+		AVFramePool::releaseImage(frame->data);
+		av_frame_free(&frame);
+	}
+};
+struct VideoFrameUnreferencer {
+	void operator () (AVFrame* frame) const {
+		AVFramePool::releaseImage(frame->data);
+		av_frame_unref(frame);
+	}
+};
+using VideoFrameType = AVItemContainer<AVFrame, VideoFrameDeleter, VideoFrameUnreferencer>;
+
+class VideoDecoder: public AVFrameDecoder<VideoFrameType> {
 	public:
 		virtual ~VideoDecoder() override;
 		bool start();
@@ -19,12 +50,23 @@ class VideoDecoder: public AVBaseDecoder {
 		bool hasData();
 		bool getData(uint8_t** data, int* linesize);
 		bool getData(uint8_t* data, int dataSize);
-		bool setConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW = -1, int dstH = -1);
+		VideoFrameRef borrowData();
+		//up to maxFrames queued frames in decoding order under one lock, not paced, for FREE_RUN consumers
+		int borrowBatch(VideoFrameRef* frames, int maxFrames, double* pts = nullptr);
+		int getBatch(uint8_t* data, int dataSize, int maxFrames, double* pts = nullptr); //frames packed back to back without padding
+		//slices > 1 converts bands in parallel, AVYuvConverter::fastConversionFlag in the flags lets AVYuvConverter do the conversions it can
+		bool setConvertingParameters(AVPixelFormat dstFormat, int flags, int dstW = -1, int dstH = -1, int slices = 1);
+		//normalized float channel planes instead of pixels, the frames report AVTensorConverter::storageFormat as their format
+		bool setTensorOutput(AVTensorConverter::Type type, const AVTensorConverter::Normalization& normalization, int flags, int dstW = -1, int dstH = -1, int slices = 1);
 		void setAudioPts(double newAudioLastPts, int64_t checkTime, double newRtspDifferencePts);
+		void setPaced(bool enabled); //false gives out every frame as soon as it is decoded
 		int getSourceWidth();
 		int getSourceHeigth();
 		int getDestinationWidth();
 		int getDestinationHeigth();
+		AVFramePool::Stats getFramePoolStats();
+		uint64_t getDroppedFrames();
+		virtual Stats getStats() override;
 
 	protected:
 		SwsContext* convertContext = nullptr;
@@ -35,6 +77,16 @@ class VideoDecoder: public AVBaseDecoder {
 		int destWidth = 0;
 		int destHeight = 0;
 		int convertFlags = 0;
+		int convertSlices = 1;
+		bool fastYuvConversion = false; //AVYuvConverter::fastConversionFlag was in the flags
+		AVSlicedScaler slicedScaler;
+		bool tensorOutput = false;
+		AVTensorConverter::Type tensorType = AVTensorConverter::FLOAT32;
+		AVTensorConverter::Normalization tensorNormalization;
+		uint8_t* scaledData[4] = {nullptr}; //the scaled GBRP picture before the tensor conversion
+		int scaledLinesize[4] = {0};
+		int scaledWidth = 0;
+		int scaledHeight = 0;
 
 		bool timeInitialized = false;
 		int64_t startTime = 0;
@@ -43,6 +95,9 @@ class VideoDecoder: public AVBaseDecoder {
 		double videoLastPts = 0.0;
 		double videoRtspDiferencePts = 0.0;
 		int lastFrameReadIndex = -1;
+		std::atomic<bool> timingReset = {false}; //the consumer restarts its pacing, set by a flush
+		std::atomic<bool> paced = {true};
+		std::atomic<uint64_t> droppedFrames = {0};
 
 		double audioLastPts = 0.0;
 		double audioRtspDiferencePts = 0.0;
@@ -52,11 +107,31 @@ class VideoDecoder: public AVBaseDecoder {
 		bool stabilized = false;
 		std::mutex synchronizeMutex;
 
+		std::shared_ptr<AVFramePool> framePool = std::make_shared<AVFramePool>(); //shared with the lent frames
+
+		struct LentFramesBin {
+			std::mutex mutex;
+			std::vector<AVFrame*> frames;
+			bool decoderAlive = true;
+		};
+		std::shared_ptr<LentFramesBin> lentFrames = std::make_shared<LentFramesBin>();
+
+		bool configureOutput(AVPixelFormat dstFormat, bool tensor, const AVTensorConverter::Normalization& normalization, int flags, int dstW, int dstH, int slices);
+		AVPixelFormat scalerFormat();
 		virtual bool convertFrame(AVFrame* dest, AVFrame* source) override;
+		bool convertToTensor(AVFrame* dest, AVFrame* source);
+		void freeScaled();
 		void reconvertAll(AVPixelFormat oldPixFormat, int oldWidth, int oldHeight);
-		virtual void handleEndOfFile(std::unique_lock<std::mutex>& frameLocker) override;
-		void initFrameBuffer() override;
+		virtual DecodingStep handleEndOfFile(std::unique_lock<std::mutex>& codecLocker) override;
+		virtual size_t frameBytes() override;
+		virtual void dropQueuedFrames() override;
 		double getPts(AVFrame* decodedFrame);
+		bool isTimeToShow(int64_t& now);
+		void dropStaleFrames();
+		void frameShown(AVFrame* decodedFrame, int64_t now);
+		AVFrame* getSpareFrame();
+		VideoFrameRef makeFrameRef(AVFrame* decodedFrame);
+		void batchTaken(int framesCount);
 };
 
 #endif // VIDEODECODER_H
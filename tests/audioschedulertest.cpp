@@ -0,0 +1,38 @@
+#include "testcase.h"
+#include "avaudioscheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//user-009: a tick removes its own client, as a callback setting a null audio callback does through stopAudioPlaying,
+//remove waited for the running tick to finish and never came back
+TEST_CASE(audioSchedulerRemoveFromTick) {
+	std::shared_ptr<AVAudioScheduler> scheduler = std::make_shared<AVAudioScheduler>();
+	std::atomic<uint64_t> clientId(0);
+	std::atomic<int> ticks(0);
+	std::atomic<bool> removed(false);
+	clientId = scheduler->add([&](int64_t, int64_t now) {
+		while(clientId == 0) { //add hasn't returned the id yet
+			std::this_thread::yield();
+		}
+		++ ticks;
+		scheduler->remove(clientId);
+		removed = true;
+		return now + 1000;
+	}, av_gettime_relative());
+	for(int i = 0; i < 1000 && !removed; ++ i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(removed);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20)); //the next deadline has passed
+	CHECK(ticks == 1);
+	CHECK(scheduler->getStats(clientId).wakeups == 0); //erased after the tick
+
+	std::atomic<int> otherTicks(0);
+	uint64_t otherId = scheduler->add([&](int64_t, int64_t now) {++ otherTicks; return now + 1000;}, av_gettime_relative());
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	scheduler->remove(otherId); //the scheduler keeps running the other clients
+	CHECK(otherTicks > 0);
+	return true;
+}
@@ -0,0 +1,94 @@
+TEMPLATE = app
+TARGET = ffmpegSwTests
+CONFIG += c++11
+CONFIG += console
+CONFIG -= c
+CONFIG -= qt
+
+#ffmpegSwTests [--list] [case ...] runs the tests and the benchmarks, all of them without names
+INCLUDEPATH += ../src
+
+win32 {
+    DEPENDPATH += D:\SourcesLibrerys\ffmpeg-4.1-win64-dev/include
+    INCLUDEPATH += D:\SourcesLibrerys\ffmpeg-4.1-win64-dev/include
+    LIBS += -LD:\SourcesLibrerys\ffmpeg-4.1-win64-dev/lib \
+             -llibavutil -llibavcodec -llibavformat -llibswresample -llibswscale
+}
+
+unix {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavformat libavcodec libswresample libswscale libavutil
+    LIBS += -pthread
+}
+
+SOURCES += \
+    main.cpp \
+    standinserver.cpp \
+    testmedia.cpp \
+    spscringbench.cpp \
+    ioreactortest.cpp \
+    reconnecttest.cpp \
+    slicedscalerbench.cpp \
+    yuvconvertertest.cpp \
+    seekbench.cpp \
+    thumbnailerbench.cpp \
+    freerunbench.cpp \
+    statsdumptest.cpp \
+    pcmringtest.cpp \
+    sampleconvertertest.cpp \
+    itemcontainerbench.cpp \
+    tensorconvertertest.cpp \
+    audioschedulertest.cpp \
+    recordertest.cpp \
+    memorybudgettest.cpp \
+    ../src/avffmpegwrapper.cpp \
+    ../src/avfilecontext.cpp \
+    ../src/avrecorder.cpp \
+    ../src/avsampleconverter.cpp \
+    ../src/avpcmring.cpp \
+    ../src/avmemorybudget.cpp \
+    ../src/avtensorconverter.cpp \
+    ../src/avthumbnailer.cpp \
+    ../src/avprobecache.cpp \
+    ../src/avaudioscheduler.cpp \
+    ../src/avyuvconverter.cpp \
+    ../src/avslicedscaler.cpp \
+    ../src/avframepool.cpp \
+    ../src/avdescriptortable.cpp \
+    ../src/avioreactor.cpp \
+    ../src/avsocketsource.cpp \
+    ../src/avfiber.cpp \
+    ../src/avdecodingpool.cpp \
+    ../src/avbasedecoder.cpp \
+    ../src/videodecoder.cpp \
+    ../src/audiodecoder.cpp
+
+HEADERS += \
+    testcase.h \
+    standinserver.h \
+    testmedia.h \
+    ../src/avffmpegwrapper.h \
+    ../src/avfilecontext.h \
+    ../src/avbasedecoder.h \
+    ../src/avframedecoder.h \
+    ../src/avitemcontainer.h \
+    ../src/avrecorder.h \
+    ../src/avsampleconverter.h \
+    ../src/avpcmring.h \
+    ../src/avmemorybudget.h \
+    ../src/avcounter.h \
+    ../src/avtensorconverter.h \
+    ../src/avthumbnailer.h \
+    ../src/avprobecache.h \
+    ../src/avaudioscheduler.h \
+    ../src/avyuvconverter.h \
+    ../src/avslicedscaler.h \
+    ../src/avframepool.h \
+    ../src/avdescriptortable.h \
+    ../src/avioreactor.h \
+    ../src/avsocketsource.h \
+    ../src/avfiber.h \
+    ../src/avdecodingpool.h \
+    ../src/avspscring.h \
+    ../src/videodecoder.h \
+    ../src/audiodecoder.h
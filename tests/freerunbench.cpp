@@ -0,0 +1,61 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+#include "avcounter.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+//frames per second taking every frame of the file as soon as the mode gives it out
+bool measureMode(const std::string& path, AVfileContext::PlayingMode mode, int& frames, double& framesPerSecond) {
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = wrapper.openFile(path, mode, AVfileContext::VIDEO);
+	if(fileDescriptor < 0) {
+		return false;
+	}
+	int64_t start = AVCounter::now();
+	if(!wrapper.startReading(fileDescriptor)) {
+		wrapper.closeFile(fileDescriptor);
+		return false;
+	}
+	frames = 0;
+	int64_t deadline = start + 60000000000LL;
+	while(!wrapper.endOfFile(fileDescriptor) && AVCounter::now() < deadline) {
+		if(VideoFrameRef frame = wrapper.borrowVideoData(fileDescriptor)) {
+			++ frames;
+		}else {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+	framesPerSecond = frames * 1e9 / static_cast<double>(AVCounter::now() - start);
+	bool ended = wrapper.endOfFile(fileDescriptor);
+	wrapper.closeFile(fileDescriptor);
+	return ended;
+}
+
+}
+
+//user-017: a four second file read to the end in NORMAL mode, paced to its 25 frames per second,
+//and in FREE_RUN, bounded only by decoding and converting
+TEST_CASE(freeRunThroughput) {
+	TestMedia::Parameters parameters;
+	parameters.width = 640;
+	parameters.height = 360;
+	parameters.framesCount = 4 * parameters.frameRate;
+	std::string path = TestMedia::temporaryPath("freerun.ts");
+	bool written = TestMedia::write(path, parameters);
+	int pacedFrames = 0;
+	int freeRunFrames = 0;
+	double pacedRate = 0.0;
+	double freeRunRate = 0.0;
+	bool measured = written && measureMode(path, AVfileContext::NORMAL, pacedFrames, pacedRate)
+				 && measureMode(path, AVfileContext::FREE_RUN, freeRunFrames, freeRunRate);
+	remove(path.c_str());
+	CHECK(measured);
+	printf("    paced: %d frames, %.1f frames/s\n", pacedFrames, pacedRate);
+	printf("    FREE_RUN: %d frames, %.1f frames/s, x%.1f\n", freeRunFrames, freeRunRate, freeRunRate / pacedRate);
+	CHECK(freeRunFrames == parameters.framesCount);
+	return true;
+}
@@ -0,0 +1,129 @@
+#include "testcase.h"
+#include "standinserver.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+#include "avcounter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifdef __linux__
+
+namespace {
+
+const int mediaFrames = 100;
+
+bool makeMedia(std::vector<uint8_t>& media) {
+	TestMedia::Parameters parameters;
+	parameters.framesCount = mediaFrames;
+	std::string path = TestMedia::temporaryPath("ioreactor.ts");
+	bool written = TestMedia::write(path, parameters) && TestMedia::read(path, media);
+	remove(path.c_str());
+	return written;
+}
+
+//takes the frames of every file as soon as they are decoded, until all of them have ended or the time is up
+void drainFiles(AVffmpegWrapper& wrapper, const std::vector<int>& fileDescriptors, std::vector<int>& frames, int timeoutMs) {
+	frames.assign(fileDescriptors.size(), 0);
+	int64_t deadline = AVCounter::now() + static_cast<int64_t>(timeoutMs) * 1000000;
+	while(AVCounter::now() < deadline) {
+		bool reading = false;
+		bool borrowed = false;
+		for(size_t i = 0; i < fileDescriptors.size(); ++ i) {
+			while(VideoFrameRef frame = wrapper.borrowVideoData(fileDescriptors[i])) {
+				++ frames[i];
+				borrowed = true;
+			}
+			if(!wrapper.endOfFile(fileDescriptors[i])) {
+				reading = true;
+			}
+		}
+		if(!reading) {
+			return;
+		}
+		if(!borrowed) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+}
+
+//user-004: a source that stops sending in the middle of the stream shares the reactor thread with tcp and http sources
+//that keep sending. Those reach their end well within the 10 s read timeout, and closing the stalled one doesn't wait for it.
+TEST_CASE(ioReactorStalledSource) {
+	std::vector<uint8_t> media;
+	CHECK(makeMedia(media));
+	StandInServer::Behaviour fast;
+	fast.chunkPeriod = 1000;
+	StandInServer::Behaviour fastHttp = fast;
+	fastHttp.http = true;
+	StandInServer::Behaviour stalled;
+	stalled.stallAfter = media.size() * 3 / 4; //enough for avformat_find_stream_info
+	StandInServer tcpServer(media, fast);
+	StandInServer httpServer(media, fastHttp);
+	StandInServer stalledServer(media, stalled);
+	CHECK(tcpServer.isListening() && httpServer.isListening() && stalledServer.isListening());
+
+	AVffmpegWrapper wrapper;
+	CHECK(wrapper.enableIOReactor(1));
+	int stalledFile = wrapper.openFile(stalledServer.url(), AVfileContext::FREE_RUN, AVfileContext::VIDEO);
+	CHECK(stalledFile >= 0);
+	CHECK(wrapper.startReading(stalledFile));
+	std::vector<int> fastFiles;
+	for(int i = 0; i < 4; ++ i) {
+		int fileDescriptor = wrapper.openFile((i % 2 == 0 ? tcpServer : httpServer).url(), AVfileContext::FREE_RUN, AVfileContext::VIDEO);
+		CHECK(fileDescriptor >= 0);
+		CHECK(wrapper.startReading(fileDescriptor));
+		fastFiles.push_back(fileDescriptor);
+	}
+	std::vector<AVIOReactor::ThreadStats> stats = wrapper.getIOReactorStats();
+	CHECK(stats.size() == 1 && stats[0].streams == 5);
+
+	int64_t start = AVCounter::now();
+	std::vector<int> frames;
+	drainFiles(wrapper, fastFiles, frames, 8000);
+	double drainSeconds = (AVCounter::now() - start) / 1e9;
+	for(size_t i = 0; i < fastFiles.size(); ++ i) {
+		CHECK(wrapper.endOfFile(fastFiles[i]));
+		CHECK(frames[i] == mediaFrames);
+	}
+	CHECK(wrapper.isReading(stalledFile));
+
+	start = AVCounter::now();
+	wrapper.closeFile(stalledFile);
+	double closeMs = (AVCounter::now() - start) / 1e6;
+	stats = wrapper.getIOReactorStats();
+	printf("    4 sources drained in %.2f s next to a stalled one, closing that took %.2f ms\n", drainSeconds, closeMs);
+	printf("    reactor: %llu loops, %lld us average, %lld us max\n", static_cast<unsigned long long>(stats[0].loops),
+		   static_cast<long long>(stats[0].averageLoopLatency), static_cast<long long>(stats[0].maxLoopLatency));
+	CHECK(closeMs < 500.0);
+	CHECK(stats[0].maxLoopLatency < 100000);
+	CHECK(stats[0].streams == 0);
+	return true;
+}
+
+//user-004: an http answer other than 200 is left to avformat's own http protocol, which follows the redirect
+TEST_CASE(ioReactorHttpRedirect) {
+	std::vector<uint8_t> media;
+	CHECK(makeMedia(media));
+	StandInServer::Behaviour http;
+	http.http = true;
+	StandInServer server(media, http);
+	CHECK(server.isListening());
+
+	AVffmpegWrapper wrapper;
+	CHECK(wrapper.enableIOReactor(1));
+	int fileDescriptor = wrapper.openFile(server.url("/redirect"), AVfileContext::FREE_RUN, AVfileContext::VIDEO);
+	CHECK(fileDescriptor >= 0);
+	CHECK(wrapper.startReading(fileDescriptor));
+	CHECK(wrapper.getIOReactorStats()[0].streams == 0); //read by the file's own thread
+	std::vector<int> frames;
+	drainFiles(wrapper, std::vector<int>(1, fileDescriptor), frames, 8000);
+	CHECK(wrapper.endOfFile(fileDescriptor));
+	CHECK(frames[0] > 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "testcase.h"
+#include "avitemcontainer.h"
+#include "avcounter.h"
+
+#include <functional>
+#include <vector>
+
+namespace {
+
+const unsigned int slotsCount = 40;
+const unsigned int cyclesCount = 20000000;
+
+//what a slot holds between a decode and its consumer, unreferencing only counts
+struct Item {
+	unsigned int references = 0;
+	unsigned int published = 0;
+};
+
+//the slot AVBaseDecoder had before the policies: the deleter, the unreferencer and the publish hook as std::function members set on every slot
+class FunctionSlot {
+	public:
+		FunctionSlot() = default;
+		FunctionSlot(const FunctionSlot&) = delete;
+		FunctionSlot& operator = (const FunctionSlot&) = delete;
+		~FunctionSlot() {
+			if(item != nullptr) {
+				if(itemReferenced) unreferenceItem(item);
+				deleteItem(item);
+			}
+		}
+		void init(std::function<void(Item*)> deleter, std::function<void(Item*)> unreferencer, std::function<void(Item*)> publishHook) {
+			deleteItem = deleter;
+			unreferenceItem = unreferencer;
+			publishItem = publishHook;
+		}
+		void setUnreferencedPtr(Item* newItem) {
+			item = newItem;
+		}
+		bool markPtrHowReferenced() {
+			if(item == nullptr) return false;
+			itemReferenced = true;
+			return true;
+		}
+		void published() {
+			if(item != nullptr && publishItem != nullptr) {
+				publishItem(item);
+			}
+		}
+		void unrefPtr() {
+			if(item != nullptr && itemReferenced) {
+				unreferenceItem(item);
+				itemReferenced = false;
+			}
+		}
+
+	private:
+		Item* item = nullptr;
+		std::function<void(Item*)> deleteItem;
+		std::function<void(Item*)> unreferenceItem;
+		std::function<void(Item*)> publishItem;
+		bool itemReferenced = false;
+};
+
+struct ItemDeleter {
+	void operator () (Item* item) const {
+		delete item;
+	}
+};
+struct ItemUnreferencer {
+	void operator () (Item* item) const {
+		++ item->references;
+	}
+};
+struct ItemPublishHook {
+	void operator () (Item* item) const {
+		++ item->published;
+	}
+};
+using PolicySlot = AVItemContainer<Item, ItemDeleter, ItemUnreferencer, ItemPublishHook>;
+
+//a ring's worth of slots, each cycle fills one, publishes it and the consumer unreferences it again
+template<class Slot>
+double measureSlots(std::vector<Slot>& slots, uint64_t& checksum) {
+	int64_t start = AVCounter::now();
+	for(unsigned int i = 0; i < cyclesCount; ++ i) {
+		Slot& slot = slots[i % slotsCount];
+		slot.markPtrHowReferenced();
+		slot.published();
+		slot.unrefPtr();
+	}
+	checksum += cyclesCount;
+	return static_cast<double>(AVCounter::now() - start) / cyclesCount;
+}
+
+}
+
+//user-024: nanoseconds per slot cycle of AVItemContainer with policy types against the std::function slot it replaced
+TEST_CASE(itemContainerSlotCycle) {
+	std::vector<FunctionSlot> functionSlots(slotsCount);
+	std::vector<Item*> functionItems;
+	for(FunctionSlot& slot : functionSlots) {
+		slot.init([](Item* item) {delete item;}, [](Item* item) {++ item->references;}, [](Item* item) {++ item->published;});
+		functionItems.push_back(new Item());
+		slot.setUnreferencedPtr(functionItems.back());
+	}
+	std::vector<PolicySlot> policySlots(slotsCount);
+	std::vector<Item*> policyItems;
+	for(PolicySlot& slot : policySlots) {
+		policyItems.push_back(new Item());
+		slot.setUnreferencedPtr(policyItems.back());
+	}
+	uint64_t expected = 0;
+	double functionTime = measureSlots(functionSlots, expected);
+	double policyTime = measureSlots(policySlots, expected);
+	uint64_t counted = 0;
+	for(unsigned int i = 0; i < slotsCount; ++ i) {
+		counted += functionItems[i]->references + policyItems[i]->references;
+		CHECK(functionItems[i]->published == functionItems[i]->references && policyItems[i]->published == policyItems[i]->references);
+	}
+	printf("    std::function slot: %zu bytes, %.2f ns per cycle\n", sizeof(FunctionSlot), functionTime);
+	printf("    policy slot: %zu bytes, %.2f ns per cycle, x%.2f\n", sizeof(PolicySlot), policyTime, functionTime / policyTime);
+	CHECK(counted == expected);
+	return true;
+}
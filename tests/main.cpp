@@ -0,0 +1,49 @@
+#include "testcase.h"
+
+#include <cstring>
+
+bool TestCase::add(const char* name, Function function) {
+	registry().push_back(TestCase(name, function));
+	return true;
+}
+
+const std::vector<TestCase>& TestCase::all() {
+	return registry();
+}
+
+std::vector<TestCase>& TestCase::registry() {
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+//ffmpegSwTests [--list] [case ...], without names every case runs
+int main(int argc, char* argv[]) {
+	if(argc > 1 && strcmp(argv[1], "--list") == 0) {
+		for(const TestCase& testCase : TestCase::all()) {
+			printf("%s\n", testCase.name);
+		}
+		return 0;
+	}
+	int failed = 0;
+	int run = 0;
+	for(const TestCase& testCase : TestCase::all()) {
+		bool selected = argc == 1;
+		for(int i = 1; i < argc && !selected; ++ i) {
+			selected = strcmp(argv[i], testCase.name) == 0;
+		}
+		if(!selected) {
+			continue;
+		}
+		printf("%s\n", testCase.name);
+		fflush(stdout);
+		bool passed = testCase.function();
+		printf("  %s\n", passed ? "PASS" : "FAIL");
+		fflush(stdout);
+		++ run;
+		if(!passed) {
+			++ failed;
+		}
+	}
+	printf("%d of %d passed\n", run - failed, run);
+	return failed == 0 && run > 0 ? 0 : 1;
+}
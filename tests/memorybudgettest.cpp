@@ -0,0 +1,158 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const unsigned int minFramesSlots = 3; //AVBaseDecoder::minFramesSlots, the ring keeps one of them free
+const unsigned int maxPacketsSlots = 1024;
+
+//slotsForDepth at the frame rate of the test media
+unsigned int slotsForDepth(const TestMedia::Parameters& parameters, unsigned int depthMs) {
+	return static_cast<unsigned int>(parameters.frameRate * depthMs / 1000.0 + 1.0);
+}
+
+//a FREE_RUN video file converted to BGRA, decoding until its rings are full
+struct BudgetedFile {
+	AVffmpegWrapper& wrapper;
+	int fileDescriptor = -1;
+
+	BudgetedFile(AVffmpegWrapper& wrapper, const std::string& path, unsigned int packetsMs, unsigned int framesMs) :
+		wrapper(wrapper) {
+		fileDescriptor = wrapper.openFile(path, AVfileContext::FREE_RUN, AVfileContext::VIDEO);
+		if(fileDescriptor >= 0 && !(wrapper.setVideoConvertingParameters(fileDescriptor, AV_PIX_FMT_BGRA, SWS_BILINEAR)
+								   && wrapper.setBufferDepth(fileDescriptor, packetsMs, framesMs) && wrapper.startReading(fileDescriptor))) {
+			close();
+		}
+	}
+	~BudgetedFile() {
+		close();
+	}
+	void close() {
+		if(fileDescriptor >= 0) {
+			wrapper.closeFile(fileDescriptor);
+			fileDescriptor = -1;
+		}
+	}
+	AVBaseDecoder::Stats stats() {
+		return wrapper.getStats(fileDescriptor).video;
+	}
+	bool waitForFrames() {
+		for(int i = 0; i < 2000; ++ i) {
+			if(stats().framesInRing > 0) {
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+};
+
+struct TestFile {
+	TestMedia::Parameters parameters;
+	std::string path;
+	bool written = false;
+
+	explicit TestFile(const std::string& name) {
+		parameters.framesCount = 20 * parameters.frameRate; //not decoded to the end while the test runs
+		path = TestMedia::temporaryPath(name);
+		written = TestMedia::write(path, parameters);
+	}
+	~TestFile() {
+		remove(path.c_str());
+	}
+};
+
+}
+
+//user-021: the ring sizes setBufferDepth asks for, in milliseconds of media at the stream frame rate,
+//clamped to the minimum and maximum slot counts
+TEST_CASE(ringSlotsFollowBufferDepth) {
+	TestFile file("ringslots.ts");
+	CHECK(file.written);
+	AVffmpegWrapper wrapper;
+	BudgetedFile deep(wrapper, file.path, 2000, 400);
+	BudgetedFile clamped(wrapper, file.path, 100000, 10);
+	BudgetedFile defaults(wrapper, file.path, 0, 0);
+	CHECK(deep.fileDescriptor >= 0 && clamped.fileDescriptor >= 0 && defaults.fileDescriptor >= 0);
+	CHECK(deep.waitForFrames() && clamped.waitForFrames() && defaults.waitForFrames());
+	AVBaseDecoder::Stats deepStats = deep.stats();
+	AVBaseDecoder::Stats clampedStats = clamped.stats();
+	AVBaseDecoder::Stats defaultStats = defaults.stats();
+	printf("    2000/400 ms: %u packets, %u frames, clamped: %u packets, %u frames, defaults: %u packets, %u frames\n",
+		   deepStats.packetsCapacity, deepStats.framesCapacity, clampedStats.packetsCapacity, clampedStats.framesCapacity,
+		   defaultStats.packetsCapacity, defaultStats.framesCapacity);
+	CHECK(deepStats.packetsCapacity == slotsForDepth(file.parameters, 2000) - 1);
+	CHECK(deepStats.framesCapacity == slotsForDepth(file.parameters, 400) - 1);
+	CHECK(clampedStats.packetsCapacity == maxPacketsSlots - 1);
+	CHECK(clampedStats.framesCapacity == minFramesSlots - 1);
+	CHECK(defaultStats.packetsCapacity == 40 - 1 && defaultStats.framesCapacity == 20 - 1); //the default slot counts
+	return true;
+}
+
+//user-021: every frame ring holds one reservation, a seek keeps it and a close gives it back
+TEST_CASE(memoryBudgetReleasedOnSeekAndClose) {
+	TestFile file("budgetrelease.ts");
+	CHECK(file.written);
+	AVffmpegWrapper wrapper;
+	CHECK(wrapper.enableMemoryBudget(256 * 1024 * 1024));
+	BudgetedFile first(wrapper, file.path, 0, 400);
+	BudgetedFile second(wrapper, file.path, 0, 400);
+	CHECK(first.fileDescriptor >= 0 && second.fileDescriptor >= 0);
+	CHECK(first.waitForFrames() && second.waitForFrames());
+	uint64_t firstBytes = first.stats().framesBytes;
+	uint64_t secondBytes = second.stats().framesBytes;
+	AVMemoryBudget::Stats opened = wrapper.getMemoryBudgetStats();
+	printf("    two files: %llu bytes reserved, %llu and %llu in the rings\n", static_cast<unsigned long long>(opened.reserved),
+		   static_cast<unsigned long long>(firstBytes), static_cast<unsigned long long>(secondBytes));
+	CHECK(firstBytes > 0 && secondBytes > 0);
+	CHECK(opened.reserved == firstBytes + secondBytes);
+
+	for(int i = 0; i < 5; ++ i) {
+		CHECK(wrapper.seek(first.fileDescriptor, 1.0 + i, AVfileContext::SEEK_KEYFRAME));
+		CHECK(first.waitForFrames());
+		CHECK(wrapper.getMemoryBudgetStats().reserved == first.stats().framesBytes + secondBytes); //not one more reservation per seek
+	}
+
+	first.close();
+	CHECK(wrapper.getMemoryBudgetStats().reserved == secondBytes);
+	second.close();
+	CHECK(wrapper.getMemoryBudgetStats().reserved == 0);
+	return true;
+}
+
+//user-021: with a budget smaller than one ring every stream still gets its minimum slots and keeps decoding
+TEST_CASE(memoryBudgetKeepsMinimumSlots) {
+	TestFile file("budgetminimum.ts");
+	CHECK(file.written);
+	AVffmpegWrapper wrapper;
+	CHECK(wrapper.enableMemoryBudget(1)); //less than any frame
+	BudgetedFile first(wrapper, file.path, 0, 1000);
+	BudgetedFile second(wrapper, file.path, 0, 1000);
+	CHECK(first.fileDescriptor >= 0 && second.fileDescriptor >= 0);
+	CHECK(first.waitForFrames() && second.waitForFrames());
+	AVBaseDecoder::Stats firstStats = first.stats();
+	AVBaseDecoder::Stats secondStats = second.stats();
+	AVMemoryBudget::Stats budget = wrapper.getMemoryBudgetStats();
+	printf("    %llu bytes reserved over a limit of %llu, %llu reservations cut\n", static_cast<unsigned long long>(budget.reserved),
+		   static_cast<unsigned long long>(budget.limit), static_cast<unsigned long long>(budget.cutReservations));
+	CHECK(firstStats.framesCapacity == minFramesSlots - 1 && secondStats.framesCapacity == minFramesSlots - 1);
+	CHECK(firstStats.framesBytes > 0 && firstStats.framesBytes % minFramesSlots == 0);
+	CHECK(budget.reserved == firstStats.framesBytes + secondStats.framesBytes);
+	CHECK(budget.cutReservations > 0);
+
+	int taken = 0;
+	for(int i = 0; i < 2000 && taken < 10; ++ i) { //more frames than the minimum ring holds go through it
+		VideoFrameRef frames[2];
+		int count = wrapper.borrowVideoBatch(first.fileDescriptor, frames, 2);
+		taken += count;
+		if(count == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	CHECK(taken >= 10);
+	return true;
+}
@@ -0,0 +1,55 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//user-022: the audio format changes again and again while the decoder fills the pcm ring and the consumer takes from it,
+//the decoder's space check and the consumer's peek run against the ring being moved. Meant for the thread sanitizer build.
+TEST_CASE(pcmRingReconfiguredWhileDecoding) {
+	TestMedia::Parameters parameters;
+	parameters.framesCount = 20 * parameters.frameRate;
+	parameters.audioSampleRate = 48000;
+	std::string path = TestMedia::temporaryPath("pcmring-audio.ts");
+	bool written = TestMedia::write(path, parameters);
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = written ? wrapper.openFile(path, AVfileContext::FREE_RUN, AVfileContext::AUDIO) : -1;
+	bool started = fileDescriptor >= 0 && wrapper.startReading(fileDescriptor);
+	if(!started) {
+		remove(path.c_str());
+	}
+	CHECK(written);
+	CHECK(started);
+	std::atomic<bool> consuming(true);
+	std::atomic<uint64_t> taken(0);
+	std::thread consumer([&]() {
+		std::vector<uint8_t> buffer(4096);
+		while(consuming) {
+			const uint8_t* data = nullptr;
+			uint32_t size = wrapper.peekAudioData(fileDescriptor, &data); //only looked at, the reconfiguring thread moves the ring
+			size = size != 0 ? wrapper.getAudioData(fileDescriptor, buffer.data(), static_cast<uint32_t>(buffer.size())) : 0;
+			taken += size;
+			if(size == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+	});
+	const AVSampleFormat formats[] = {AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S32};
+	int reconfigurations = 0;
+	for(int i = 0; i < 200 && !wrapper.endOfFile(fileDescriptor); ++ i) {
+		if(wrapper.setAudioConvertingParameters(fileDescriptor, formats[i % 4])) {
+			++ reconfigurations;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+	}
+	consuming = false;
+	consumer.join();
+	printf("    %d reconfigurations, %llu bytes taken\n", reconfigurations, static_cast<unsigned long long>(taken));
+	wrapper.closeFile(fileDescriptor);
+	remove(path.c_str());
+	CHECK(reconfigurations > 0);
+	CHECK(taken > 0);
+	return true;
+}
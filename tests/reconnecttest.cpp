@@ -0,0 +1,80 @@
+#include "testcase.h"
+#include "standinserver.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+#include "avcounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifdef __linux__
+
+//user-013: a camera that drops the connection halfway through every stream. The file reconnects warm,
+//the video decoder keeps running through every reconnect and decodes the new connection's first frame
+//without another avformat_find_stream_info. LOW_LATENCY shows every frame as soon as it is decoded,
+//the paced modes would wait when the restarted stream's timestamps go back to 0.
+TEST_CASE(reconnectAfterKilledConnection) {
+	TestMedia::Parameters parameters;
+	parameters.framesCount = 100;
+	std::string path = TestMedia::temporaryPath("reconnect.ts");
+	std::vector<uint8_t> media;
+	bool written = TestMedia::write(path, parameters) && TestMedia::read(path, media);
+	remove(path.c_str());
+	CHECK(written);
+	StandInServer::Behaviour killing;
+	killing.chunkPeriod = 2000;
+	killing.killAfter = media.size() / 2;
+	StandInServer server(media, killing);
+	CHECK(server.isListening());
+
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = wrapper.openFile(server.url(), AVfileContext::LOW_LATENCY, AVfileContext::VIDEO);
+	CHECK(fileDescriptor >= 0); //reconnecting files connect and read from openFile on
+
+	const unsigned int reconnectsCount = 3;
+	int64_t deadline = AVCounter::now() + 15000000000LL;
+	unsigned int connections = 0;
+	int64_t connectedAt = 0;
+	uint64_t framesAtConnect = 0;
+	unsigned int reconnects = 0;
+	int64_t reconnectDelaySum = 0;
+	int64_t maxReconnectDelay = 0;
+	bool decoding = false;
+	bool decoderStopped = false;
+	unsigned int frames = 0;
+	while(AVCounter::now() < deadline && reconnects < reconnectsCount) {
+		int64_t now = AVCounter::now();
+		uint64_t framesDecoded = wrapper.getStats(fileDescriptor).video.framesDecoded;
+		if(server.connectionsCount() > connections) {
+			connections = server.connectionsCount();
+			connectedAt = now;
+			framesAtConnect = framesDecoded;
+		}else if(connectedAt != 0 && framesDecoded > framesAtConnect) { //the first frame of this connection
+			if(connections > 1) {
+				reconnectDelaySum += now - connectedAt;
+				maxReconnectDelay = std::max(maxReconnectDelay, now - connectedAt);
+				++ reconnects;
+			}
+			connectedAt = 0;
+		}
+		if(decoding && !wrapper.isDecodingVideo(fileDescriptor)) {
+			decoderStopped = true;
+		}
+		while(VideoFrameRef frame = wrapper.borrowVideoData(fileDescriptor)) {
+			decoding = true; //the first connection has opened the decoder
+			++ frames;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	printf("    %u connections, %u frames, from a reconnect to its first frame %.1f ms on average, %.1f ms at most\n", connections, frames,
+		   reconnects != 0 ? reconnectDelaySum / 1e6 / reconnects : 0.0, maxReconnectDelay / 1e6);
+	CHECK(reconnects == reconnectsCount);
+	CHECK(!decoderStopped);
+	CHECK(maxReconnectDelay < 500000000LL);
+	wrapper.closeFile(fileDescriptor);
+	return true;
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct SegmentStart {
+	bool opened = false;
+	bool keyframeFirst = false;
+	double firstTimestamp = -1.0; //seconds, of the first video packet
+	int packets = 0;
+};
+
+SegmentStart inspectSegment(const std::string& path) {
+	SegmentStart segment;
+	AVFormatContext* formatContext = nullptr;
+	AVPacket* packet = av_packet_alloc();
+	int temp = 0;
+	auto deleter = [&](int*) {
+		avformat_close_input(&formatContext);
+		av_packet_free(&packet);
+	};
+	std::unique_ptr<int, decltype(deleter)> allCloser(&temp, deleter);
+
+	if(packet == nullptr || avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) != 0
+	 || avformat_find_stream_info(formatContext, nullptr) < 0) {
+		return segment;
+	}
+	int videoStreamId = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if(videoStreamId < 0) {
+		return segment;
+	}
+	segment.opened = true;
+	while(av_read_frame(formatContext, packet) == 0) {
+		if(packet->stream_index == videoStreamId) {
+			if(segment.packets == 0) {
+				int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+				segment.keyframeFirst = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+				segment.firstTimestamp = timestamp != AV_NOPTS_VALUE ? timestamp * av_q2d(formatContext->streams[videoStreamId]->time_base) : -1.0;
+			}
+			++ segment.packets;
+		}
+		av_packet_unref(packet);
+	}
+	return segment;
+}
+
+}
+
+//user-025: a file opened in RECORD mode is remuxed into segments, the first two must each open on their own,
+//start with a keyframe and have timestamps from zero
+TEST_CASE(recordSegmentsStartAtKeyframes) {
+	TestMedia::Parameters parameters;
+	parameters.framesCount = 4 * parameters.frameRate;
+	std::string path = TestMedia::temporaryPath("record-source.ts");
+	std::string prefix = TestMedia::temporaryPath("record-segment-");
+	bool written = TestMedia::write(path, parameters);
+	std::mutex segmentsMutex;
+	std::vector<std::string> segments;
+	AVRecorder::Parameters recording;
+	recording.pathPrefix = prefix;
+	recording.container = AVRecorder::MKV;
+	recording.segmentSeconds = 1; //a keyframe every 0.4 s, so a segment is about a second long
+	recording.segmentFinished = [&](const std::string& segmentPath) {
+		std::lock_guard<std::mutex> segmentsLocker(segmentsMutex);
+		segments.push_back(segmentPath);
+	};
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = written ? wrapper.openFile(path, AVfileContext::RECORD, AVfileContext::VIDEO) : -1;
+	bool started = fileDescriptor >= 0 && wrapper.startRecording(fileDescriptor, recording);
+	size_t finished = 0;
+	for(int i = 0; i < 2000 && started && finished < 2; ++ i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		std::lock_guard<std::mutex> segmentsLocker(segmentsMutex);
+		finished = segments.size();
+	}
+	wrapper.closeFile(fileDescriptor); //finishes the segment still open
+	remove(path.c_str());
+	CHECK(written);
+	CHECK(started);
+	std::vector<SegmentStart> starts;
+	for(const std::string& segmentPath : segments) {
+		starts.push_back(inspectSegment(segmentPath));
+		remove(segmentPath.c_str());
+	}
+	CHECK(starts.size() >= 2);
+	double frameDuration = 1.0 / parameters.frameRate;
+	for(size_t i = 0; i < 2; ++ i) {
+		printf("    segment %zu: %d packets, first at %.3f s%s\n", i, starts[i].packets, starts[i].firstTimestamp,
+			   starts[i].keyframeFirst ? ", a keyframe" : "");
+		CHECK(starts[i].opened);
+		CHECK(starts[i].packets > 0);
+		CHECK(starts[i].keyframeFirst);
+		CHECK(starts[i].firstTimestamp >= 0.0 && starts[i].firstTimestamp < frameDuration);
+	}
+	return true;
+}
@@ -0,0 +1,152 @@
+#include "testcase.h"
+#include "avsampleconverter.h"
+#include "avcounter.h"
+
+extern "C" {
+	#include <libswresample/swresample.h>
+}
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+//the most AVSampleConverter may differ from swr_convert: S16 output exactly, FLT output by float rounding
+const int maxS16Difference = 0;
+const double maxFltDifference = 1e-6;
+
+const int rate = 48000;
+
+const char* layoutName(int64_t layout) {
+	return layout == static_cast<int64_t>(AV_CH_LAYOUT_MONO) ? "mono" : "stereo";
+}
+
+//a sweep over the full range with clipped peaks for the float formats, planes filled one after another
+struct SourceSamples {
+	std::vector<std::vector<uint8_t>> planes;
+	const uint8_t* data[2] = {nullptr, nullptr};
+
+	SourceSamples(AVSampleFormat format, int channels, int samples) {
+		bool planar = av_sample_fmt_is_planar(format) && channels > 1;
+		int planesCount = planar ? channels : 1;
+		int valuesPerPlane = planar ? samples : samples * channels;
+		bool s16 = av_get_packed_sample_fmt(format) == AV_SAMPLE_FMT_S16;
+		planes.resize(static_cast<size_t>(planesCount));
+		for(int plane = 0; plane < planesCount; ++ plane) {
+			planes[plane].resize(static_cast<size_t>(valuesPerPlane) * (s16 ? sizeof(int16_t) : sizeof(float)));
+			for(int i = 0; i < valuesPerPlane; ++ i) {
+				double value = 1.1 * sin(i * 0.0137 + plane * 1.3) * cos(i * 0.0009); //up to 10% over full scale
+				if(s16) {
+					int16_t sample = static_cast<int16_t>(value > 1.0 ? 32767 : value < -1.0 ? -32768 : lrint(value * 32767.0));
+					memcpy(&planes[plane][static_cast<size_t>(i) * sizeof(sample)], &sample, sizeof(sample));
+				}else {
+					float sample = static_cast<float>(value);
+					memcpy(&planes[plane][static_cast<size_t>(i) * sizeof(sample)], &sample, sizeof(sample));
+				}
+			}
+			data[plane] = planes[plane].data();
+		}
+	}
+};
+
+bool convertWithSwr(const SourceSamples& source, AVSampleFormat srcFormat, int64_t srcLayout, AVSampleFormat dstFormat, int64_t dstLayout,
+					int samples, std::vector<uint8_t>& converted) {
+	SwrContext* context = swr_alloc_set_opts(nullptr, dstLayout, dstFormat, rate, srcLayout, srcFormat, rate, 0, nullptr);
+	if(context == nullptr || swr_init(context) < 0) {
+		swr_free(&context);
+		return false;
+	}
+	int channels = av_get_channel_layout_nb_channels(static_cast<uint64_t>(dstLayout));
+	converted.assign(static_cast<size_t>(av_samples_get_buffer_size(nullptr, channels, samples, dstFormat, 1)), 0);
+	uint8_t* out[1] = {converted.data()};
+	const uint8_t* in[2] = {source.data[0], source.data[1]};
+	int result = swr_convert(context, out, samples, in, samples);
+	swr_free(&context);
+	return result == samples;
+}
+
+}
+
+//user-023: every route AVSampleConverter takes over from swr, S16/S16P/FLT/FLTP mono or stereo into packed S16 or FLT,
+//against swr_convert on the same samples
+TEST_CASE(sampleConverterMatchesSwr) {
+	const AVSampleFormat srcFormats[] = {AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP};
+	const AVSampleFormat dstFormats[] = {AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLT};
+	const int64_t layouts[] = {static_cast<int64_t>(AV_CH_LAYOUT_MONO), static_cast<int64_t>(AV_CH_LAYOUT_STEREO)};
+	const int samples = 4099; //leaves a tail for the scalar code after the vector kernels
+	printf("    kernels %s\n", AVSampleConverter::kernelName());
+	int routes = 0;
+	for(AVSampleFormat srcFormat : srcFormats) {
+		for(int64_t srcLayout : layouts) {
+			for(AVSampleFormat dstFormat : dstFormats) {
+				for(int64_t dstLayout : layouts) {
+					AVSampleConverter::Route route;
+					if(!AVSampleConverter::findRoute(srcFormat, srcLayout, rate, dstFormat, dstLayout, rate, route)) {
+						continue;
+					}
+					++ routes;
+					SourceSamples source(srcFormat, av_get_channel_layout_nb_channels(static_cast<uint64_t>(srcLayout)), samples);
+					std::vector<uint8_t> expected;
+					CHECK(convertWithSwr(source, srcFormat, srcLayout, dstFormat, dstLayout, samples, expected));
+					std::vector<uint8_t> converted(AVSampleConverter::outputSize(route, samples), 0);
+					CHECK(converted.size() == expected.size());
+					AVSampleConverter::convert(route, source.data, converted.data(), samples);
+					double maxDifference = 0.0;
+					size_t values = converted.size() / static_cast<size_t>(av_get_bytes_per_sample(dstFormat));
+					for(size_t i = 0; i < values; ++ i) {
+						double difference = 0.0;
+						if(dstFormat == AV_SAMPLE_FMT_S16) {
+							int16_t got, want;
+							memcpy(&got, &converted[i * sizeof(got)], sizeof(got));
+							memcpy(&want, &expected[i * sizeof(want)], sizeof(want));
+							difference = std::abs(got - want);
+						}else {
+							float got, want;
+							memcpy(&got, &converted[i * sizeof(got)], sizeof(got));
+							memcpy(&want, &expected[i * sizeof(want)], sizeof(want));
+							difference = std::fabs(static_cast<double>(got) - want);
+						}
+						if(difference > maxDifference) {
+							maxDifference = difference;
+						}
+					}
+					printf("    %s %s to %s %s: max difference %g\n", av_get_sample_fmt_name(srcFormat), layoutName(srcLayout),
+						   av_get_sample_fmt_name(dstFormat), layoutName(dstLayout), maxDifference);
+					CHECK(dstFormat == AV_SAMPLE_FMT_S16 ? maxDifference <= maxS16Difference : maxDifference <= maxFltDifference);
+				}
+			}
+		}
+	}
+	CHECK(routes > 0);
+	return true;
+}
+
+//user-023: samples per second for the common decoder output, stereo FLTP into packed S16, AVSampleConverter against swr_convert
+TEST_CASE(sampleConverterThroughput) {
+	const int samples = 1024; //an AAC frame
+	const int framesCount = 20000;
+	const int64_t stereo = static_cast<int64_t>(AV_CH_LAYOUT_STEREO);
+	SourceSamples source(AV_SAMPLE_FMT_FLTP, 2, samples);
+	std::vector<uint8_t> output(static_cast<size_t>(samples) * 2 * sizeof(int16_t));
+	SwrContext* context = swr_alloc_set_opts(nullptr, stereo, AV_SAMPLE_FMT_S16, rate, stereo, AV_SAMPLE_FMT_FLTP, rate, 0, nullptr);
+	CHECK(context != nullptr && swr_init(context) >= 0);
+	uint8_t* out[1] = {output.data()};
+	const uint8_t* in[2] = {source.data[0], source.data[1]};
+	int64_t start = AVCounter::now();
+	for(int i = 0; i < framesCount; ++ i) {
+		swr_convert(context, out, samples, in, samples);
+	}
+	double swrRate = static_cast<double>(framesCount) * samples * 1e9 / static_cast<double>(AVCounter::now() - start);
+	swr_free(&context);
+	AVSampleConverter::Route route;
+	CHECK(AVSampleConverter::findRoute(AV_SAMPLE_FMT_FLTP, stereo, rate, AV_SAMPLE_FMT_S16, stereo, rate, route));
+	start = AVCounter::now();
+	for(int i = 0; i < framesCount; ++ i) {
+		AVSampleConverter::convert(route, source.data, output.data(), samples);
+	}
+	double converterRate = static_cast<double>(framesCount) * samples * 1e9 / static_cast<double>(AVCounter::now() - start);
+	printf("    swr_convert %.1f Msamples/s, AVSampleConverter (%s) %.1f Msamples/s, x%.2f\n", swrRate / 1e6, AVSampleConverter::kernelName(),
+		   converterRate / 1e6, converterRate / swrRate);
+	return true;
+}
@@ -0,0 +1,104 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avffmpegwrapper.h"
+#include "avcounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace {
+
+//milliseconds from seek to the first frame at the target, -1 when no frame came or it was before the target
+double seekLatency(AVffmpegWrapper& wrapper, int fileDescriptor, double timestamp, double frameDuration) {
+	int64_t start = AVCounter::now();
+	if(!wrapper.seek(fileDescriptor, timestamp, AVfileContext::SEEK_EXACT)) {
+		return -1.0;
+	}
+	int64_t deadline = start + 5000000000LL;
+	while(AVCounter::now() < deadline) {
+		VideoFrameRef frame;
+		double pts = 0.0;
+		if(wrapper.borrowVideoBatch(fileDescriptor, &frame, 1, &pts) == 1) {
+			double latency = (AVCounter::now() - start) / 1e6;
+			return pts > timestamp - frameDuration / 2 ? latency : -1.0;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	return -1.0;
+}
+
+void printLatencies(const char* pass, std::vector<double>& latencies) {
+	std::sort(latencies.begin(), latencies.end());
+	double sum = 0.0;
+	for(double latency : latencies) {
+		sum += latency;
+	}
+	printf("    %s: %zu seeks, %.2f ms average, %.2f ms median, %.2f ms p95, %.2f ms max\n", pass, latencies.size(), sum / latencies.size(),
+		   latencies[latencies.size() / 2], latencies[latencies.size() * 95 / 100], latencies.back());
+}
+
+}
+
+//user-015: exact seeks to random timestamps of a three minute file with a keyframe every 2 s. The first pass
+//seeks with av_seek_frame while the keyframe index is still being built, the second one after the file was read
+//to the end finds every keyframe in the index. H.264 when the build has an encoder for it, mpeg1 otherwise.
+TEST_CASE(seekLatency) {
+	TestMedia::Parameters parameters;
+	parameters.width = 640;
+	parameters.height = 360;
+	parameters.framesCount = 3 * 60 * parameters.frameRate;
+	parameters.gopSize = 2 * parameters.frameRate;
+	if(avcodec_find_encoder(AV_CODEC_ID_H264) != nullptr) {
+		parameters.codecId = AV_CODEC_ID_H264;
+	}
+	std::string path = TestMedia::temporaryPath("seek.ts");
+	bool written = TestMedia::write(path, parameters);
+	printf("    %s %dx%d, %d frames\n", avcodec_get_name(parameters.codecId), parameters.width, parameters.height, parameters.framesCount);
+
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = written ? wrapper.openFile(path, AVfileContext::FREE_RUN, AVfileContext::VIDEO) : -1;
+	bool started = fileDescriptor >= 0 && wrapper.startReading(fileDescriptor);
+	if(!started) {
+		remove(path.c_str());
+	}
+	CHECK(written);
+	CHECK(started);
+
+	const int seeksCount = 100;
+	const double frameDuration = 1.0 / parameters.frameRate;
+	std::mt19937 random(15);
+	std::uniform_int_distribution<int> frames(0, parameters.framesCount - 1);
+	std::vector<double> timestamps;
+	for(int i = 0; i < seeksCount; ++ i) {
+		timestamps.push_back(frames(random) * frameDuration);
+	}
+	std::vector<double> latencies;
+	for(double timestamp : timestamps) {
+		double latency = seekLatency(wrapper, fileDescriptor, timestamp, frameDuration);
+		CHECK(latency >= 0.0);
+		latencies.push_back(latency);
+	}
+	printLatencies("while indexing", latencies);
+
+	CHECK(wrapper.seek(fileDescriptor, 0.0, AVfileContext::SEEK_KEYFRAME)); //a contiguous read indexes the whole file
+	int64_t deadline = AVCounter::now() + 60000000000LL;
+	while(!wrapper.endOfFile(fileDescriptor) && AVCounter::now() < deadline) {
+		VideoFrameRef batch[16];
+		if(wrapper.borrowVideoBatch(fileDescriptor, batch, 16) == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	CHECK(wrapper.endOfFile(fileDescriptor));
+	latencies.clear();
+	for(double timestamp : timestamps) {
+		double latency = seekLatency(wrapper, fileDescriptor, timestamp, frameDuration);
+		CHECK(latency >= 0.0);
+		latencies.push_back(latency);
+	}
+	printLatencies("indexed", latencies);
+	wrapper.closeFile(fileDescriptor);
+	remove(path.c_str());
+	return true;
+}
@@ -0,0 +1,82 @@
+#include "testcase.h"
+#include "avslicedscaler.h"
+#include "avcounter.h"
+
+#include <thread>
+
+extern "C" {
+	#include <libavutil/imgutils.h>
+}
+
+namespace {
+
+struct Picture {
+	uint8_t* data[4] = {nullptr, nullptr, nullptr, nullptr};
+	int linesize[4] = {0, 0, 0, 0};
+
+	Picture(int width, int height, AVPixelFormat format) {
+		av_image_alloc(data, linesize, width, height, format, 32);
+	}
+	~Picture() {
+		av_freep(&data[0]);
+	}
+};
+
+//frames per second converting a decoded yuv420p picture to bgra of the same size, the decoder's usual display conversion
+bool measureSlices(int width, int height, int slices, int framesCount, double& framesPerSecond) {
+	Picture source(width, height, AV_PIX_FMT_YUV420P);
+	Picture destination(width, height, AV_PIX_FMT_BGRA);
+	if(source.data[0] == nullptr || destination.data[0] == nullptr) {
+		return false;
+	}
+	for(int plane = 0; plane < 3; ++ plane) {
+		int rows = plane == 0 ? height : height / 2;
+		for(int y = 0; y < rows; ++ y) {
+			for(int x = 0; x < source.linesize[plane]; ++ x) {
+				source.data[plane][y * source.linesize[plane] + x] = static_cast<uint8_t>(x * (plane + 1) + y);
+			}
+		}
+	}
+	AVSlicedScaler scaler;
+	if(!scaler.init(width, height, AV_PIX_FMT_YUV420P, width, height, AV_PIX_FMT_BGRA, SWS_BICUBIC, slices)) {
+		return false;
+	}
+	if(!scaler.scale(source.data, source.linesize, destination.data, destination.linesize)) { //the workers are up and the tables built
+		return false;
+	}
+	int64_t start = AVCounter::now();
+	for(int i = 0; i < framesCount; ++ i) {
+		if(!scaler.scale(source.data, source.linesize, destination.data, destination.linesize)) {
+			return false;
+		}
+	}
+	framesPerSecond = framesCount * 1e9 / static_cast<double>(AVCounter::now() - start);
+	return true;
+}
+
+}
+
+//user-007: conversion rate of AVSlicedScaler with 1, 2, 4 and 8 bands at 1080p and 4K,
+//more bands only pay off with as many free cores
+TEST_CASE(slicedScalerThroughput) {
+	const struct {
+		const char* name;
+		int width;
+		int height;
+		int framesCount;
+	} sizes[] = {{"1080p", 1920, 1080, 40}, {"4K", 3840, 2160, 10}};
+	const int slicesCounts[] = {1, 2, 4, 8};
+	printf("    %u hardware threads\n", std::thread::hardware_concurrency());
+	for(const auto& size : sizes) {
+		double singleRate = 0.0;
+		for(int slices : slicesCounts) {
+			double rate = 0.0;
+			CHECK(measureSlices(size.width, size.height, slices, size.framesCount, rate));
+			if(slices == 1) {
+				singleRate = rate;
+			}
+			printf("    %s, %d slice(s): %.1f frames/s, x%.2f\n", size.name, slices, rate, rate / singleRate);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,123 @@
+#include "testcase.h"
+#include "avspscring.h"
+#include "avcounter.h"
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const unsigned int ringSlots = 40;
+const unsigned int itemsCount = 2000000;
+
+//the packet ring AVBaseDecoder had before AVSpscRing: a mutex and a condition around both indices,
+//the producer waits while less than 6 slots are free and every side notifies after each item
+class MutexRing {
+	public:
+		void push(unsigned int value) {
+			std::unique_lock<std::mutex> locker(mutex);
+			cond.wait(locker, [&](){return freeSlots() > 6;});
+			items[writeIndex] = value;
+			writeIndex = (writeIndex + 1) % ringSlots;
+			locker.unlock();
+			cond.notify_one();
+		}
+		unsigned int pop() {
+			std::unique_lock<std::mutex> locker(mutex);
+			cond.wait(locker, [&](){return readIndex != writeIndex;});
+			unsigned int value = items[readIndex];
+			readIndex = (readIndex + 1) % ringSlots;
+			locker.unlock();
+			cond.notify_one();
+			return value;
+		}
+
+	private:
+		std::array<unsigned int, ringSlots> items;
+		unsigned int readIndex = 0;
+		unsigned int writeIndex = 0;
+		std::mutex mutex;
+		std::condition_variable cond;
+
+		unsigned int freeSlots() const {
+			return writeIndex >= readIndex ? ringSlots - (writeIndex - readIndex) : readIndex - writeIndex;
+		}
+};
+
+//both sides on one thread, a push and a pop per item: the cost of the ring itself, without any waiting
+template<class Ring, class Push, class Pop>
+double measureUncontended(Ring& ring, Push push, Pop pop, bool& ordered) {
+	int64_t start = AVCounter::now();
+	for(unsigned int i = 0; i < itemsCount; ++ i) {
+		push(ring, i);
+		if(pop(ring) != i) {
+			ordered = false;
+		}
+	}
+	return itemsCount * 1e9 / static_cast<double>(AVCounter::now() - start);
+}
+
+bool measureMutexRing(double& itemsPerSecond) {
+	MutexRing ring;
+	bool ordered = true;
+	int64_t start = AVCounter::now();
+	std::thread consumer([&]() {
+		for(unsigned int i = 0; i < itemsCount; ++ i) {
+			if(ring.pop() != i) {
+				ordered = false;
+			}
+		}
+	});
+	for(unsigned int i = 0; i < itemsCount; ++ i) {
+		ring.push(i);
+	}
+	consumer.join();
+	itemsPerSecond = itemsCount * 1e9 / static_cast<double>(AVCounter::now() - start);
+	return ordered;
+}
+
+bool measureSpscRing(double& itemsPerSecond) {
+	AVSpscRing<unsigned int> ring(ringSlots);
+	bool ordered = true;
+	int64_t start = AVCounter::now();
+	std::thread consumer([&]() {
+		for(unsigned int i = 0; i < itemsCount; ++ i) {
+			ring.waitForData([](){return false;});
+			if(ring.front() != i) {
+				ordered = false;
+			}
+			ring.pop();
+		}
+	});
+	for(unsigned int i = 0; i < itemsCount; ++ i) {
+		ring.waitForSpace([](){return false;});
+		ring.back() = i;
+		ring.push();
+	}
+	consumer.join();
+	itemsPerSecond = itemsCount * 1e9 / static_cast<double>(AVCounter::now() - start);
+	return ordered;
+}
+
+}
+
+//user-001: push/pop throughput of the decoder rings with 40 slots, on one thread and between a producer and a consumer thread,
+//the second one needs two free cores to mean anything
+TEST_CASE(spscRingThroughput) {
+	bool ordered = true;
+	MutexRing mutexRing;
+	double mutexRate = measureUncontended(mutexRing, [](MutexRing& ring, unsigned int value) {ring.push(value);},
+										  [](MutexRing& ring) {return ring.pop();}, ordered);
+	AVSpscRing<unsigned int> spscRing(ringSlots);
+	double spscRate = measureUncontended(spscRing, [](AVSpscRing<unsigned int>& ring, unsigned int value) {ring.back() = value; ring.push();},
+										 [](AVSpscRing<unsigned int>& ring) {unsigned int value = ring.front(); ring.pop(); return value;}, ordered);
+	CHECK(ordered);
+	printf("    one thread: mutex ring %.2f M items/s, AVSpscRing %.2f M items/s, x%.1f\n", mutexRate / 1e6, spscRate / 1e6, spscRate / mutexRate);
+
+	CHECK(measureMutexRing(mutexRate));
+	CHECK(measureSpscRing(spscRate));
+	printf("    two threads: mutex ring %.2f M items/s, AVSpscRing %.2f M items/s, x%.1f\n", mutexRate / 1e6, spscRate / 1e6, spscRate / mutexRate);
+	return true;
+}
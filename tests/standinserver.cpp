@@ -0,0 +1,208 @@
+#include "standinserver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+	#include <arpa/inet.h>
+	#include <netinet/in.h>
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <unistd.h>
+#endif
+
+StandInServer::StandInServer(const std::vector<uint8_t>& payload, const Behaviour& behaviour):
+	payload(payload),
+	behaviour(behaviour)
+{
+#ifdef __linux__
+	listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(listenFd < 0) {
+		return;
+	}
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0; //any free port
+	socklen_t addressSize = sizeof(address);
+	if(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 64) != 0
+	 || getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &addressSize) != 0) {
+		close(listenFd);
+		listenFd = -1;
+		return;
+	}
+	port = ntohs(address.sin_port);
+	acceptThread = std::thread(&StandInServer::accepting, this);
+#endif
+}
+
+StandInServer::~StandInServer() {
+	stopping = true;
+	killConnections();
+	if(acceptThread.joinable()) {
+		acceptThread.join();
+	}
+	for(std::thread& connectionThread : connectionThreads) {
+		connectionThread.join();
+	}
+#ifdef __linux__
+	if(listenFd >= 0) {
+		close(listenFd);
+	}
+#endif
+}
+
+bool StandInServer::isListening() {
+	return listenFd >= 0;
+}
+
+std::string StandInServer::url(const std::string& path) {
+	return (behaviour.http ? "http://127.0.0.1:" : "tcp://127.0.0.1:") + std::to_string(port) + (behaviour.http ? path : "");
+}
+
+unsigned int StandInServer::connectionsCount() {
+	return accepted;
+}
+
+void StandInServer::killConnections() {
+#ifdef __linux__
+	std::lock_guard<std::mutex> locker(connectionsMutex);
+	for(int connectionFd : openConnections) { //the serving thread closes it, the descriptor can't be reused meanwhile
+		shutdown(connectionFd, SHUT_RDWR);
+	}
+	openConnections.clear();
+#endif
+}
+
+void StandInServer::accepting() {
+#ifdef __linux__
+	while(!stopping) {
+		pollfd pollDescriptor;
+		pollDescriptor.fd = listenFd;
+		pollDescriptor.events = POLLIN;
+		pollDescriptor.revents = 0;
+		if(poll(&pollDescriptor, 1, 20) <= 0) {
+			continue;
+		}
+		int connectionFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+		if(connectionFd < 0) {
+			continue;
+		}
+		++ accepted;
+		std::unique_lock<std::mutex> locker(connectionsMutex);
+		openConnections.push_back(connectionFd);
+		locker.unlock();
+		connectionThreads.push_back(std::thread(&StandInServer::serve, this, connectionFd));
+	}
+#endif
+}
+
+void StandInServer::serve(int connectionFd) {
+#ifdef __linux__
+	bool sending = true;
+	if(behaviour.http) {
+		std::string path;
+		if(!readRequest(connectionFd, path)) {
+			sending = false;
+		}else if(path.compare(0, 9, "/redirect") == 0) {
+			std::string response = "HTTP/1.0 302 Found\r\nLocation: http://127.0.0.1:" + std::to_string(port)
+								 + "/media\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			sendAll(connectionFd, reinterpret_cast<const uint8_t*>(response.data()), response.size());
+			sending = false;
+		}else {
+			std::string response = "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: "
+								 + std::to_string(payload.size()) + "\r\nConnection: close\r\n\r\n";
+			sending = sendAll(connectionFd, reinterpret_cast<const uint8_t*>(response.data()), response.size());
+		}
+	}
+	size_t sendSize = payload.size();
+	if(behaviour.stallAfter != 0 || behaviour.killAfter != 0) {
+		sendSize = std::min(behaviour.stallAfter != 0 ? behaviour.stallAfter : behaviour.killAfter, sendSize);
+	}
+	for(size_t sent = 0; sending && sent < sendSize && !stopping && isOpen(connectionFd); ) {
+		size_t chunk = std::min(std::max(behaviour.chunkSize, static_cast<size_t>(1)), sendSize - sent);
+		sending = sendAll(connectionFd, &payload[sent], chunk);
+		sent += chunk;
+		if(behaviour.chunkPeriod > 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(behaviour.chunkPeriod));
+		}
+	}
+	if(sending && behaviour.stallAfter != 0) {
+		while(!stopping && isOpen(connectionFd)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+	if(behaviour.killAfter != 0) { //a reset instead of an orderly close, like a camera that went away
+		linger resetOnClose;
+		resetOnClose.l_onoff = 1;
+		resetOnClose.l_linger = 0;
+		setsockopt(connectionFd, SOL_SOCKET, SO_LINGER, &resetOnClose, sizeof(resetOnClose));
+	}
+	std::lock_guard<std::mutex> locker(connectionsMutex);
+	auto it = std::find(openConnections.begin(), openConnections.end(), connectionFd);
+	if(it != openConnections.end()) {
+		openConnections.erase(it);
+	}
+	close(connectionFd);
+#else
+	(void)connectionFd;
+#endif
+}
+
+bool StandInServer::readRequest(int connectionFd, std::string& path) {
+#ifdef __linux__
+	std::string request;
+	char chunk[1024];
+	while(request.find("\r\n\r\n") == std::string::npos) {
+		if(stopping || !isOpen(connectionFd) || request.size() > 8192) {
+			return false;
+		}
+		pollfd pollDescriptor;
+		pollDescriptor.fd = connectionFd;
+		pollDescriptor.events = POLLIN;
+		pollDescriptor.revents = 0;
+		if(poll(&pollDescriptor, 1, 20) <= 0) {
+			continue;
+		}
+		ssize_t received = recv(connectionFd, chunk, sizeof(chunk), 0);
+		if(received <= 0) {
+			return false;
+		}
+		request.append(chunk, static_cast<size_t>(received));
+	}
+	size_t pathStart = request.find(' ');
+	size_t pathEnd = pathStart == std::string::npos ? std::string::npos : request.find(' ', pathStart + 1);
+	if(pathEnd == std::string::npos) {
+		return false;
+	}
+	path = request.substr(pathStart + 1, pathEnd - pathStart - 1);
+	return true;
+#else
+	(void)connectionFd; (void)path;
+	return false;
+#endif
+}
+
+bool StandInServer::sendAll(int connectionFd, const uint8_t* data, size_t size) {
+#ifdef __linux__
+	while(size > 0) {
+		ssize_t sent = send(connectionFd, data, size, MSG_NOSIGNAL);
+		if(sent <= 0) {
+			return false;
+		}
+		data += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+#else
+	(void)connectionFd; (void)data; (void)size;
+	return false;
+#endif
+}
+
+bool StandInServer::isOpen(int connectionFd) {
+	std::lock_guard<std::mutex> locker(connectionsMutex);
+	return std::find(openConnections.begin(), openConnections.end(), connectionFd) != openConnections.end();
+}
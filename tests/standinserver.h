@@ -0,0 +1,52 @@
+#ifndef STANDINSERVER_H
+#define STANDINSERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Local TCP server on 127.0.0.1 standing in for a camera or an http server in the network tests.
+//Every connection gets the same payload, raw or behind an http response, as fast, as slow or as broken as the test needs.
+//Linux only, like the socket sources it is there for.
+class StandInServer {
+	public:
+		struct Behaviour {
+			bool http = false; //a request path starting with /redirect gets a 302 to /media, any other path the payload
+			size_t chunkSize = 188 * 7;
+			int chunkPeriod = 0; //microseconds between chunks, 0 sends as fast as the socket takes them
+			size_t stallAfter = 0; //bytes of the payload after which the connection goes quiet until it is killed, 0 never stalls
+			size_t killAfter = 0; //bytes of the payload after which every connection is cut, 0 sends all of it
+		};
+
+		StandInServer(const std::vector<uint8_t>& payload, const Behaviour& behaviour);
+		StandInServer(const StandInServer&) = delete;
+		StandInServer& operator = (const StandInServer&) = delete;
+		~StandInServer();
+		bool isListening();
+		std::string url(const std::string& path = "/media"); //tcp:// or http:// to this server
+		unsigned int connectionsCount(); //accepted so far
+		void killConnections(); //cuts the open connections, new ones are still accepted
+
+	private:
+		std::vector<uint8_t> payload;
+		Behaviour behaviour;
+		int listenFd = -1;
+		int port = 0;
+		std::thread acceptThread;
+		std::vector<std::thread> connectionThreads;
+		std::mutex connectionsMutex;
+		std::vector<int> openConnections;
+		std::atomic<unsigned int> accepted = {0};
+		std::atomic<bool> stopping = {false};
+
+		void accepting();
+		void serve(int connectionFd);
+		bool readRequest(int connectionFd, std::string& path);
+		bool sendAll(int connectionFd, const uint8_t* data, size_t size);
+		bool isOpen(int connectionFd);
+};
+
+#endif // STANDINSERVER_H
@@ -0,0 +1,35 @@
+#include "testcase.h"
+#include "avffmpegwrapper.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//user-020: stopStatsDump while the dump callback is inside a wrapper call that takes avFileMutex,
+//the join waited for the callback under that mutex and never came back
+TEST_CASE(statsDumpStopDuringCallback) {
+	AVffmpegWrapper wrapper;
+	std::atomic<bool> inCallback(false);
+	std::atomic<int> wrapperCalls(0);
+	CHECK(wrapper.startStatsDump(1, [&](int fileDescriptor, const AVfileContext::Stats&) {
+		if(fileDescriptor != -1) {
+			return;
+		}
+		inCallback = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20)); //stopStatsDump is called meanwhile
+		wrapper.getMemoryBudgetStats();
+		++ wrapperCalls;
+	}));
+	while(!inCallback) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	wrapper.stopStatsDump();
+	int callsAfterStop = wrapperCalls;
+	CHECK(callsAfterStop >= 1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK(wrapperCalls == callsAfterStop);
+
+	CHECK(wrapper.startStatsDump(1, [&](int, const AVfileContext::Stats&) {})); //restarts after a stop
+	wrapper.stopStatsDump();
+	return true;
+}
@@ -0,0 +1,191 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avtensorconverter.h"
+#include "avffmpegwrapper.h"
+
+extern "C" {
+	#include <libavutil/cpu.h>
+}
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+float halfToFloat(uint16_t half) {
+	int exponent = (half >> 10) & 0x1f;
+	int mantissa = half & 0x3ff;
+	double value = exponent == 0 ? mantissa * std::ldexp(1.0, -24)
+				 : exponent == 31 ? INFINITY
+				 : (1024 + mantissa) * std::ldexp(1.0, exponent - 25);
+	return static_cast<float>(half & 0x8000 ? -value : value);
+}
+
+//true when no other half of the same sign is closer to value, ties only to the even one
+bool isNearestHalf(uint16_t half, float value) {
+	double difference = std::fabs(static_cast<double>(halfToFloat(half)) - value);
+	for(int step = -1; step <= 1; step += 2) {
+		int neighbour = (half & 0x7fff) + step;
+		if(neighbour < 0 || neighbour >= 0x7c00) {
+			continue;
+		}
+		double neighbourDifference = std::fabs(static_cast<double>(halfToFloat(static_cast<uint16_t>((half & 0x8000) | neighbour))) - value);
+		if(neighbourDifference < difference || (neighbourDifference == difference && (half & 1) != 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//a GBRP picture covering every byte value on every row, shifted per plane
+struct GbrpPicture {
+	std::vector<uint8_t> planes[3];
+	const uint8_t* data[3];
+	int linesize[3];
+
+	GbrpPicture(int width, int height) {
+		for(int plane = 0; plane < 3; ++ plane) {
+			linesize[plane] = width + 7; //the rows don't start aligned
+			planes[plane].resize(static_cast<size_t>(linesize[plane]) * height);
+			for(size_t i = 0; i < planes[plane].size(); ++ i) {
+				planes[plane][i] = static_cast<uint8_t>(i * 37 + plane * 85);
+			}
+			data[plane] = planes[plane].data();
+		}
+	}
+};
+
+struct ForcedCpuFlags {
+	explicit ForcedCpuFlags(int flags) {
+		av_force_cpu_flags(flags);
+	}
+	~ForcedCpuFlags() {
+		av_force_cpu_flags(-1);
+	}
+};
+
+}
+
+//user-019: each float32 kernel this CPU has and the float16 table against (value / 255 - mean) / std, in RGB and BGR order,
+//with row widths around the 16 values a kernel step takes
+TEST_CASE(tensorConverterMatchesFormula) {
+	const int widths[] = {1, 15, 16, 17, 33, 1925};
+	const int height = 3;
+	AVTensorConverter::Normalization normalizations[2];
+	const float mean[3] = {0.485f, 0.456f, 0.406f};
+	const float stddev[3] = {0.229f, 0.224f, 0.225f};
+	for(int channel = 0; channel < 3; ++ channel) {
+		normalizations[0].mean[channel] = normalizations[1].mean[channel] = mean[channel];
+		normalizations[0].std[channel] = normalizations[1].std[channel] = stddev[channel];
+	}
+	normalizations[1].bgr = true;
+	const int gbrPlanes[3] = {2, 0, 1};
+	int cpuFlags = av_get_cpu_flags();
+	const int kernelFlags[] = {AV_CPU_FLAG_AVX2 | AV_CPU_FLAG_SSE2, AV_CPU_FLAG_SSE2, AV_CPU_FLAG_NEON, 0};
+	for(int flags : kernelFlags) {
+		if((flags & cpuFlags) != flags) {
+			continue;
+		}
+		ForcedCpuFlags forced(flags);
+		const char* kernel = AVTensorConverter::kernelName();
+		const AVTensorConverter::Type types[] = {AVTensorConverter::FLOAT32, AVTensorConverter::FLOAT16};
+		double maxError = 0.0;
+		for(AVTensorConverter::Type type : types) {
+			size_t valueSize = type == AVTensorConverter::FLOAT32 ? sizeof(float) : sizeof(uint16_t);
+			for(int width : widths) {
+				GbrpPicture source(width, height);
+				for(const AVTensorConverter::Normalization& normalization : normalizations) {
+					std::vector<uint8_t> planes[3];
+					uint8_t* dstData[3];
+					int dstLinesize[3];
+					for(int channel = 0; channel < 3; ++ channel) {
+						dstLinesize[channel] = static_cast<int>((width + 3) * valueSize);
+						planes[channel].assign(static_cast<size_t>(dstLinesize[channel]) * height, 0xcd);
+						dstData[channel] = planes[channel].data();
+					}
+					AVTensorConverter::convert(source.data, source.linesize, dstData, dstLinesize, width, height, type, normalization);
+					for(int channel = 0; channel < 3; ++ channel) {
+						int plane = gbrPlanes[normalization.bgr ? 2 - channel : channel];
+						float scale = 1.0f / (255.0f * normalization.std[channel]);
+						float bias = -normalization.mean[channel] / normalization.std[channel];
+						for(int y = 0; y < height; ++ y) {
+							const uint8_t* row = dstData[channel] + y * dstLinesize[channel];
+							for(int x = 0; x < width; ++ x) {
+								uint8_t value = source.data[plane][y * source.linesize[plane] + x];
+								float scalar = static_cast<float>(value) * scale + bias; //the scalar loop's own rounding
+								double exact = (value / 255.0 - normalization.mean[channel]) / normalization.std[channel];
+								if(type == AVTensorConverter::FLOAT32) {
+									float converted;
+									memcpy(&converted, row + x * sizeof(float), sizeof(converted));
+									CHECK(converted == scalar);
+									maxError = std::max(maxError, std::fabs(converted - exact));
+								}else {
+									uint16_t converted;
+									memcpy(&converted, row + x * sizeof(uint16_t), sizeof(converted));
+									CHECK(isNearestHalf(converted, scalar));
+								}
+							}
+							for(size_t padding = width * valueSize; padding < static_cast<size_t>(dstLinesize[channel]); ++ padding) {
+								CHECK(row[padding] == 0xcd); //nothing written past the row
+							}
+						}
+					}
+				}
+			}
+		}
+		printf("    %s: float32 within %.2g of the exact formula, float16 the nearest half\n", kernel, maxError);
+		CHECK(maxError < 1e-5);
+	}
+	return true;
+}
+
+//user-019: the output switches between pixels and tensors while decoded frames wait in the ring,
+//every frame taken afterwards has the size and format of the output it was taken under
+TEST_CASE(tensorOutputSwitchWithQueuedFrames) {
+	TestMedia::Parameters parameters;
+	parameters.framesCount = 60 * parameters.frameRate; //longer than the ring, decoding is never finished during the switches
+	std::string path = TestMedia::temporaryPath("tensorswitch.ts");
+	bool written = TestMedia::write(path, parameters);
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = written ? wrapper.openFile(path, AVfileContext::FREE_RUN, AVfileContext::VIDEO) : -1;
+	bool opened = fileDescriptor >= 0 && wrapper.setVideoConvertingParameters(fileDescriptor, AV_PIX_FMT_BGRA, SWS_BILINEAR)
+			   && wrapper.startReading(fileDescriptor);
+	remove(path.c_str()); //the file stays readable while it is open
+	CHECK(written);
+	CHECK(opened);
+	AVTensorConverter::Normalization normalization;
+	int frames = 0;
+	int switches = 0;
+	while(switches < 24 && !wrapper.endOfFile(fileDescriptor)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5)); //the decoder fills the ring meanwhile
+		bool tensor = switches % 2 == 0;
+		int size = switches % 3 == 0 ? 160 : 320; //the size changes too, every other time with the format
+		bool switched = tensor ? wrapper.setVideoTensorOutput(fileDescriptor, AVTensorConverter::FLOAT32, normalization, SWS_BILINEAR, size, size * 3 / 4)
+							   : wrapper.setVideoConvertingParameters(fileDescriptor, AV_PIX_FMT_BGRA, SWS_BILINEAR, size, size * 3 / 4);
+		CHECK(switched);
+		++ switches;
+		AVPixelFormat format = tensor ? AVTensorConverter::storageFormat(AVTensorConverter::FLOAT32) : AV_PIX_FMT_BGRA;
+		int width = wrapper.getDestinationWidth(fileDescriptor);
+		int height = wrapper.getDestinationHeigth(fileDescriptor);
+		int taken = 0;
+		for(int i = 0; i < 1000 && taken == 0; ++ i) { //the frames queued under a pixel output are decoded again for a tensor one
+			VideoFrameRef batch[4];
+			taken = wrapper.borrowVideoBatch(fileDescriptor, batch, 4);
+			for(int j = 0; j < taken; ++ j) {
+				CHECK(batch[j]->format == format && batch[j]->width == width && batch[j]->height == height);
+			}
+			if(taken == 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		CHECK(taken > 0);
+		frames += taken;
+	}
+	printf("    %d output switches, %d frames taken\n", switches, frames);
+	wrapper.closeFile(fileDescriptor);
+	CHECK(switches == 24);
+	return true;
+}
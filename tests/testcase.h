@@ -0,0 +1,40 @@
+#ifndef TESTCASE_H
+#define TESTCASE_H
+
+#include <cstdio>
+#include <vector>
+
+//Registry of the test and benchmark cases, main runs the ones named on the command line or all of them.
+//A test returns false when a check fails, a benchmark prints its measurements and fails only when it could not run.
+class TestCase {
+	public:
+		using Function = bool (*)();
+
+		static bool add(const char* name, Function function);
+		static const std::vector<TestCase>& all();
+
+		const char* name;
+		Function function;
+
+	private:
+		TestCase(const char* name, Function function):
+			name(name),
+			function(function)
+		{}
+		static std::vector<TestCase>& registry();
+};
+
+#define TEST_CASE(caseName) \
+	static bool caseName(); \
+	static const bool caseName##Registered = TestCase::add(#caseName, &caseName); \
+	static bool caseName()
+
+#define CHECK(condition) \
+	do { \
+		if(!(condition)) { \
+			printf("    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			return false; \
+		} \
+	} while(0)
+
+#endif // TESTCASE_H
@@ -0,0 +1,200 @@
+#include "testmedia.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+
+#ifdef _WIN32
+	#include <process.h>
+	#define getpid _getpid
+#else
+	#include <unistd.h>
+#endif
+
+bool TestMedia::write(const std::string& path, const Parameters& parameters) {
+	AVFormatContext* formatContext = nullptr;
+	AVCodecContext* codecContext = nullptr;
+	AVCodecContext* audioContext = nullptr;
+	AVFrame* frame = nullptr;
+	AVFrame* audioFrame = nullptr;
+	AVPacket* packet = nullptr;
+	int temp = 0;
+	auto deleter = [&](int*) {
+		if(formatContext) {
+			if(formatContext->pb && !(formatContext->oformat->flags & AVFMT_NOFILE)) {
+				avio_closep(&formatContext->pb);
+			}
+			avformat_free_context(formatContext);
+		}
+		avcodec_free_context(&codecContext);
+		avcodec_free_context(&audioContext);
+		av_frame_free(&frame);
+		av_frame_free(&audioFrame);
+		av_packet_free(&packet);
+	};
+	std::unique_ptr<int, decltype(deleter)> allCloser(&temp, deleter);
+
+	if(avformat_alloc_output_context2(&formatContext, nullptr, parameters.format.c_str(), path.c_str()) < 0) {
+		return false;
+	}
+	AVCodec* codec = avcodec_find_encoder(parameters.codecId);
+	AVStream* stream = avformat_new_stream(formatContext, nullptr);
+	if(codec == nullptr || stream == nullptr) {
+		return false;
+	}
+	codecContext = avcodec_alloc_context3(codec);
+	if(codecContext == nullptr) {
+		return false;
+	}
+	codecContext->width = parameters.width;
+	codecContext->height = parameters.height;
+	codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+	codecContext->time_base = {1, parameters.frameRate};
+	codecContext->framerate = {parameters.frameRate, 1};
+	codecContext->gop_size = parameters.gopSize;
+	codecContext->max_b_frames = 0;
+	codecContext->bit_rate = static_cast<int64_t>(parameters.width) * parameters.height * parameters.frameRate / 8;
+	if(formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+		codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	}
+	if(avcodec_open2(codecContext, codec, nullptr) < 0 || avcodec_parameters_from_context(stream->codecpar, codecContext) < 0) {
+		return false;
+	}
+	stream->time_base = codecContext->time_base;
+	AVStream* audioStream = nullptr;
+	int audioFrameSize = 0;
+	if(parameters.audioSampleRate > 0) {
+		AVCodec* audioCodec = avcodec_find_encoder(AV_CODEC_ID_MP2);
+		audioStream = avformat_new_stream(formatContext, nullptr);
+		audioContext = audioCodec != nullptr ? avcodec_alloc_context3(audioCodec) : nullptr;
+		if(audioStream == nullptr || audioContext == nullptr) {
+			return false;
+		}
+		audioContext->sample_fmt = AV_SAMPLE_FMT_S16;
+		audioContext->sample_rate = parameters.audioSampleRate;
+		audioContext->channel_layout = AV_CH_LAYOUT_STEREO;
+		audioContext->channels = 2;
+		audioContext->bit_rate = 128000;
+		audioContext->time_base = {1, parameters.audioSampleRate};
+		if(formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+			audioContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+		}
+		if(avcodec_open2(audioContext, audioCodec, nullptr) < 0 || avcodec_parameters_from_context(audioStream->codecpar, audioContext) < 0) {
+			return false;
+		}
+		audioStream->time_base = audioContext->time_base;
+		audioFrameSize = audioContext->frame_size > 0 ? audioContext->frame_size : 1152;
+	}
+	if(!(formatContext->oformat->flags & AVFMT_NOFILE) && avio_open(&formatContext->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) {
+		return false;
+	}
+	if(avformat_write_header(formatContext, nullptr) < 0) {
+		return false;
+	}
+
+	frame = av_frame_alloc();
+	packet = av_packet_alloc();
+	if(frame == nullptr || packet == nullptr) {
+		return false;
+	}
+	if(audioContext != nullptr) {
+		audioFrame = av_frame_alloc();
+		if(audioFrame == nullptr) {
+			return false;
+		}
+		audioFrame->format = AV_SAMPLE_FMT_S16;
+		audioFrame->channel_layout = AV_CH_LAYOUT_STEREO;
+		audioFrame->sample_rate = parameters.audioSampleRate;
+		audioFrame->nb_samples = audioFrameSize;
+		if(av_frame_get_buffer(audioFrame, 0) < 0) {
+			return false;
+		}
+	}
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = parameters.width;
+	frame->height = parameters.height;
+	if(av_frame_get_buffer(frame, 0) < 0) {
+		return false;
+	}
+	std::function<bool(AVCodecContext*, AVStream*, const AVFrame*)> encode = [&](AVCodecContext* context, AVStream* target, const AVFrame* input) {
+		if(avcodec_send_frame(context, input) < 0) {
+			return false;
+		}
+		while(avcodec_receive_packet(context, packet) == 0) {
+			av_packet_rescale_ts(packet, context->time_base, target->time_base);
+			packet->stream_index = target->index;
+			if(av_interleaved_write_frame(formatContext, packet) < 0) {
+				return false;
+			}
+		}
+		return true;
+	};
+	const double pi = 3.14159265358979323846;
+	int64_t audioPts = 0;
+	for(int i = 0; i < parameters.framesCount; ++ i) {
+		if(av_frame_make_writable(frame) < 0) {
+			return false;
+		}
+		for(int y = 0; y < parameters.height; ++ y) {
+			for(int x = 0; x < parameters.width; ++ x) {
+				frame->data[0][y * frame->linesize[0] + x] = static_cast<uint8_t>(x + y + i * 3);
+			}
+		}
+		for(int y = 0; y < parameters.height / 2; ++ y) {
+			for(int x = 0; x < parameters.width / 2; ++ x) {
+				frame->data[1][y * frame->linesize[1] + x] = static_cast<uint8_t>(128 + y + i * 2);
+				frame->data[2][y * frame->linesize[2] + x] = static_cast<uint8_t>(64 + x + i * 5);
+			}
+		}
+		frame->pts = i;
+		if(!encode(codecContext, stream, frame)) {
+			return false;
+		}
+		//the audio up to the end of this video frame, a 440 Hz tone on the left channel and 660 Hz on the right
+		int64_t audioEnd = static_cast<int64_t>(i + 1) * parameters.audioSampleRate / parameters.frameRate;
+		while(audioContext != nullptr && audioPts < audioEnd) {
+			if(av_frame_make_writable(audioFrame) < 0) {
+				return false;
+			}
+			int16_t* samples = reinterpret_cast<int16_t*>(audioFrame->data[0]);
+			for(int j = 0; j < audioFrameSize; ++ j) {
+				double time = static_cast<double>(audioPts + j) / parameters.audioSampleRate;
+				samples[j * 2] = static_cast<int16_t>(8000.0 * sin(2.0 * pi * 440.0 * time));
+				samples[j * 2 + 1] = static_cast<int16_t>(8000.0 * sin(2.0 * pi * 660.0 * time));
+			}
+			audioFrame->pts = audioPts;
+			audioPts += audioFrameSize;
+			if(!encode(audioContext, audioStream, audioFrame)) {
+				return false;
+			}
+		}
+	}
+	return encode(codecContext, stream, nullptr) && (audioContext == nullptr || encode(audioContext, audioStream, nullptr))
+		&& av_write_trailer(formatContext) >= 0;
+}
+
+bool TestMedia::read(const std::string& path, std::vector<uint8_t>& data) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if(file == nullptr) {
+		return false;
+	}
+	data.clear();
+	uint8_t chunk[65536];
+	size_t readSize = 0;
+	while((readSize = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		data.insert(data.end(), chunk, chunk + readSize);
+	}
+	fclose(file);
+	return !data.empty();
+}
+
+std::string TestMedia::temporaryPath(const std::string& name) {
+#ifdef _WIN32
+	const char* directory = getenv("TEMP");
+#else
+	const char* directory = getenv("TMPDIR");
+#endif
+	return std::string(directory ? directory : "/tmp") + "/ffmpegSwTests-" + std::to_string(getpid()) + "-" + name;
+}
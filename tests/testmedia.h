@@ -0,0 +1,34 @@
+#ifndef TESTMEDIA_H
+#define TESTMEDIA_H
+
+extern "C" {
+	#include <libavcodec/avcodec.h>
+	#include <libavformat/avformat.h>
+}
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Synthetic media for the tests and benchmarks, encoded with the encoders every ffmpeg build has,
+//so no sample files need to ship with the repo. The video is a moving gradient, every frame a packet,
+//the optional audio two sine tones.
+class TestMedia {
+	public:
+		struct Parameters {
+			int width = 320;
+			int height = 240;
+			int frameRate = 25;
+			int framesCount = 50;
+			int gopSize = 10;
+			AVCodecID codecId = AV_CODEC_ID_MPEG1VIDEO; //no B-frames, so one frame in, one packet out
+			std::string format = "mpegts";
+			int audioSampleRate = 0; //a stereo mp2 track next to the video when not 0
+		};
+
+		static bool write(const std::string& path, const Parameters& parameters);
+		static bool read(const std::string& path, std::vector<uint8_t>& data);
+		static std::string temporaryPath(const std::string& name); //unique to this process, the caller removes the file
+};
+
+#endif // TESTMEDIA_H
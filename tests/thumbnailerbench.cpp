@@ -0,0 +1,85 @@
+#include "testcase.h"
+#include "testmedia.h"
+#include "avthumbnailer.h"
+#include "avffmpegwrapper.h"
+#include "avcounter.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+//the way the sheets were made before, every frame decoded and taken from AVfileContext without pacing
+bool decodeWholeFile(const std::string& path) {
+	AVffmpegWrapper wrapper;
+	int fileDescriptor = wrapper.openFile(path, AVfileContext::FREE_RUN, AVfileContext::VIDEO);
+	if(fileDescriptor < 0 || !wrapper.startReading(fileDescriptor)) {
+		return false;
+	}
+	int64_t deadline = AVCounter::now() + 60000000000LL;
+	while(!wrapper.endOfFile(fileDescriptor) && AVCounter::now() < deadline) {
+		VideoFrameRef batch[16];
+		if(wrapper.borrowVideoBatch(fileDescriptor, batch, 16) == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	bool ended = wrapper.endOfFile(fileDescriptor);
+	wrapper.closeFile(fileDescriptor);
+	return ended;
+}
+
+}
+
+//user-016: one-minute files per second made into ten-tile sprite sheets, the files with a keyframe every 2 s,
+//with 1, 2 and 4 threads and one per core, next to decoding every frame through AVfileContext
+TEST_CASE(thumbnailerThroughput) {
+	const int distinctFiles = 4;
+	const int filesCount = 32; //the distinct files over and over, each one costs the same as a new one
+	TestMedia::Parameters parameters;
+	parameters.width = 640;
+	parameters.height = 360;
+	parameters.framesCount = 60 * parameters.frameRate;
+	parameters.gopSize = 2 * parameters.frameRate;
+	std::vector<std::string> distinctPaths;
+	bool written = true;
+	for(int i = 0; i < distinctFiles && written; ++ i) {
+		distinctPaths.push_back(TestMedia::temporaryPath("thumbnailer" + std::to_string(i) + ".ts"));
+		written = TestMedia::write(distinctPaths.back(), parameters);
+	}
+	std::vector<std::string> paths;
+	for(int i = 0; i < filesCount; ++ i) {
+		paths.push_back(distinctPaths[i % distinctPaths.size()]);
+	}
+
+	bool succeeded = written;
+	AVThumbnailer::SheetLayout layout;
+	const unsigned int threadsCounts[] = {1, 2, 4, 0};
+	for(unsigned int threads : threadsCounts) {
+		if(!succeeded) {
+			break;
+		}
+		AVThumbnailer thumbnailer(threads);
+		int64_t start = AVCounter::now();
+		std::vector<AVThumbnailer::Sheet> sheets = thumbnailer.extract(paths, layout);
+		double seconds = (AVCounter::now() - start) / 1e9;
+		for(const AVThumbnailer::Sheet& sheet : sheets) {
+			succeeded = succeeded && sheet.tilesFilled == layout.tilesCount;
+		}
+		succeeded = succeeded && sheets.size() == paths.size();
+		printf("    AVThumbnailer, %u thread(s): %.1f files/s\n", threads != 0 ? threads : std::thread::hardware_concurrency(), filesCount / seconds);
+	}
+	if(succeeded) {
+		const int decodedFiles = distinctFiles;
+		int64_t start = AVCounter::now();
+		for(int i = 0; i < decodedFiles && succeeded; ++ i) {
+			succeeded = decodeWholeFile(paths[i]);
+		}
+		printf("    every frame through AVfileContext, 1 file at a time: %.1f files/s\n", decodedFiles / ((AVCounter::now() - start) / 1e9));
+	}
+	for(const std::string& path : distinctPaths) {
+		remove(path.c_str());
+	}
+	CHECK(written);
+	CHECK(succeeded);
+	return true;
+}
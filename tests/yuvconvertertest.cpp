@@ -0,0 +1,124 @@
+#include "testcase.h"
+#include "avyuvconverter.h"
+#include "avcounter.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+//the most a color channel of AVYuvConverter may differ from swscale's unscaled yuv2rgb,
+//both round the BT.601 matrix differently, each is within 2 or 3 of the exact result
+const int maxAllowedDifference = 4;
+
+//a yuv picture with the luma and chroma covering the whole 0-255 range, out of the limited range too
+struct YuvPicture {
+	std::vector<uint8_t> luma;
+	std::vector<uint8_t> chroma[2];
+	const uint8_t* data[4] = {nullptr, nullptr, nullptr, nullptr};
+	int linesize[4] = {0, 0, 0, 0};
+
+	YuvPicture(int width, int height, AVPixelFormat format) {
+		int chromaWidth = (width + 1) / 2;
+		int chromaHeight = (height + 1) / 2;
+		luma.resize(static_cast<size_t>(width) * height);
+		for(size_t i = 0; i < luma.size(); ++ i) {
+			luma[i] = static_cast<uint8_t>(i * 7 + i / width * 3);
+		}
+		linesize[0] = width;
+		data[0] = luma.data();
+		if(format == AV_PIX_FMT_NV12) {
+			chroma[0].resize(static_cast<size_t>(chromaWidth) * 2 * chromaHeight);
+			for(size_t i = 0; i < chroma[0].size(); ++ i) {
+				chroma[0][i] = static_cast<uint8_t>(i % 2 == 0 ? i * 5 + i / (chromaWidth * 2) : i * 11 + 64);
+			}
+			linesize[1] = chromaWidth * 2;
+			data[1] = chroma[0].data();
+		}else {
+			for(int plane = 0; plane < 2; ++ plane) {
+				chroma[plane].resize(static_cast<size_t>(chromaWidth) * chromaHeight);
+				for(size_t i = 0; i < chroma[plane].size(); ++ i) {
+					chroma[plane][i] = static_cast<uint8_t>(plane == 0 ? i * 5 + i / chromaWidth : i * 11 + 64);
+				}
+				linesize[plane + 1] = chromaWidth;
+				data[plane + 1] = chroma[plane].data();
+			}
+		}
+	}
+};
+
+bool convertWithSws(const YuvPicture& source, AVPixelFormat srcFormat, AVPixelFormat dstFormat, int width, int height, std::vector<uint8_t>& rgb) {
+	SwsContext* context = sws_getContext(width, height, srcFormat, width, height, dstFormat, SWS_BILINEAR, nullptr, nullptr, nullptr);
+	if(context == nullptr) {
+		return false;
+	}
+	rgb.assign(static_cast<size_t>(width) * height * 4, 0);
+	uint8_t* dstData[4] = {rgb.data(), nullptr, nullptr, nullptr};
+	int dstLinesize[4] = {width * 4, 0, 0, 0};
+	bool converted = sws_scale(context, source.data, source.linesize, 0, height, dstData, dstLinesize) == height;
+	sws_freeContext(context);
+	return converted;
+}
+
+}
+
+//user-008: AVYuvConverter against sws_scale for every conversion it takes over, the largest channel difference is pinned
+TEST_CASE(yuvConverterMatchesSwscale) {
+	const AVPixelFormat srcFormats[] = {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12};
+	const AVPixelFormat dstFormats[] = {AV_PIX_FMT_BGRA, AV_PIX_FMT_RGBA};
+	const int sizes[][2] = {{1920, 1080}, {642, 362}}; //the second one leaves a tail for the scalar kernel
+	printf("    kernel %s\n", AVYuvConverter::kernelName());
+	for(AVPixelFormat srcFormat : srcFormats) {
+		for(AVPixelFormat dstFormat : dstFormats) {
+			for(const auto& size : sizes) {
+				int width = size[0];
+				int height = size[1];
+				CHECK(AVYuvConverter::canConvert(srcFormat, width, height, dstFormat, width, height, SWS_BILINEAR));
+				YuvPicture source(width, height, srcFormat);
+				std::vector<uint8_t> expected;
+				CHECK(convertWithSws(source, srcFormat, dstFormat, width, height, expected));
+				std::vector<uint8_t> converted(expected.size(), 0);
+				AVYuvConverter::convert(source.data, source.linesize, srcFormat, converted.data(), width * 4, dstFormat, width, height);
+				int maxDifference = 0;
+				uint64_t differenceSum = 0;
+				for(size_t i = 0; i < converted.size(); ++ i) {
+					int difference = std::abs(converted[i] - expected[i]);
+					differenceSum += static_cast<uint64_t>(difference);
+					if(difference > maxDifference) {
+						maxDifference = difference;
+					}
+				}
+				printf("    %s to %s %dx%d: max difference %d, mean %.3f\n", srcFormat == AV_PIX_FMT_NV12 ? "nv12" : "yuv420p",
+					   dstFormat == AV_PIX_FMT_RGBA ? "rgba" : "bgra", width, height, maxDifference, differenceSum / static_cast<double>(converted.size()));
+				CHECK(maxDifference <= maxAllowedDifference);
+			}
+		}
+	}
+	return true;
+}
+
+//user-008: 1080p yuv420p to bgra frames per second, AVYuvConverter against sws_scale
+TEST_CASE(yuvConverterThroughput) {
+	const int width = 1920;
+	const int height = 1080;
+	const int framesCount = 60;
+	YuvPicture source(width, height, AV_PIX_FMT_YUV420P);
+	std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 4);
+	uint8_t* dstData[4] = {rgb.data(), nullptr, nullptr, nullptr};
+	int dstLinesize[4] = {width * 4, 0, 0, 0};
+	SwsContext* context = sws_getContext(width, height, AV_PIX_FMT_YUV420P, width, height, AV_PIX_FMT_BGRA, SWS_BILINEAR, nullptr, nullptr, nullptr);
+	CHECK(context != nullptr);
+	int64_t start = AVCounter::now();
+	for(int i = 0; i < framesCount; ++ i) {
+		sws_scale(context, source.data, source.linesize, 0, height, dstData, dstLinesize);
+	}
+	double swsRate = framesCount * 1e9 / static_cast<double>(AVCounter::now() - start);
+	sws_freeContext(context);
+	start = AVCounter::now();
+	for(int i = 0; i < framesCount; ++ i) {
+		AVYuvConverter::convert(source.data, source.linesize, AV_PIX_FMT_YUV420P, rgb.data(), dstLinesize[0], AV_PIX_FMT_BGRA, width, height);
+	}
+	double converterRate = framesCount * 1e9 / static_cast<double>(AVCounter::now() - start);
+	printf("    sws_scale %.1f frames/s, AVYuvConverter (%s) %.1f frames/s, x%.2f\n", swsRate, AVYuvConverter::kernelName(), converterRate, converterRate / swsRate);
+	return true;
+}